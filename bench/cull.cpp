@@ -0,0 +1,64 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+#include <chrono>
+
+#include "cull.h"
+
+// Frustum culling benchmark
+// Tests randomly placed bounding spheres against a frustum with an 
+// increasing number of worker threads
+int main(int argc, char **argv) {
+    const int iterations = 20;
+    const std::vector<uint32_t> counts = {10000, 100000, 1000000};
+
+    // A frustum covering the center of the scattered spheres
+    glm::mat4 view_projection(1.0f);
+    view_projection[2][2] = 0.5f;
+    view_projection[3][2] = 0.5f;
+    Frustum frustum = extract_frustum(view_projection);
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> position(-4.0f, 4.0f);
+    std::uniform_real_distribution<float> radius(0.01f, 0.5f);
+
+    unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::cout << std::setw(10) << "spheres"
+              << std::setw(10) << "threads"
+              << std::setw(12) << "cull ms"
+              << std::setw(12) << "visible" << "\n";
+    for(uint32_t count : counts) {
+        for(unsigned threads = 1; threads <= max_threads; threads *= 2) {
+            ThreadPool workers(threads);
+            FrustumCuller culler(workers);
+            culler.resize(count);
+            for(uint32_t i = 0; i < count; i++) {
+                culler.set_sphere(
+                    i, 
+                    glm::vec3(position(random), position(random), position(random)), 
+                    radius(random)
+                );
+            }
+
+            double total = 0;
+            for(int i = 0; i < iterations; i++) {
+                auto start = std::chrono::high_resolution_clock::now();
+                culler.cull(frustum, count);
+                total += std::chrono::duration<double, std::milli>(
+                    std::chrono::high_resolution_clock::now() - start
+                ).count();
+            }
+
+            uint32_t visible = 0;
+            for(uint32_t i = 0; i < count; i++) {
+                visible += culler.is_visible(i);
+            }
+            std::cout << std::setw(10) << count
+                      << std::setw(10) << threads
+                      << std::setw(12) << std::fixed << std::setprecision(3) << total / iterations
+                      << std::setw(12) << visible << "\n";
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,92 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <map>
+
+#include "loader.h"
+
+// Decode throughput benchmark
+// Compares decoding straight to RGBA and copying into a staging area
+// against decoding to native channels and expanding into it
+int main(int argc, char **argv) {
+    std::vector<std::string> filenames;
+    for(int i = 1; i < argc; i++) {
+        filenames.push_back(argv[i]);
+    }
+    if(filenames.empty()) {
+        filenames = {
+            "../assets/texture.jpg",
+            "../assets/hazard.png",
+            "../assets/viking_room.png"
+        };
+    }
+    const int iterations = 10;
+
+    struct Result {
+        double megapixels = 0;
+        double baseline_ms = 0;
+        double expanded_ms = 0;
+    };
+    std::map<std::string, Result> results;
+
+    for(auto &filename : filenames) {
+        std::ifstream file(filename, std::ios::ate | std::ios::binary);
+        if(!file.is_open()) {
+            std::cerr << "Could not open " << filename << "\n";
+            return 1;
+        }
+        std::vector<unsigned char> bytes(file.tellg());
+        file.seekg(0);
+        file.read(reinterpret_cast<char *>(bytes.data()), bytes.size());
+
+        std::string format = filename.substr(filename.find_last_of('.') + 1);
+        Result &result = results[format];
+        std::vector<unsigned char> baseline, expanded;
+
+        for(int i = 0; i < iterations; i++) {
+            // Decode to RGBA, then copy into staging
+            auto start = std::chrono::high_resolution_clock::now();
+            int width, height, channels;
+            stbi_uc *pixels = stbi_load_from_memory(
+                bytes.data(), bytes.size(),
+                &width, &height, &channels,
+                STBI_rgb_alpha
+            );
+            baseline.resize(width * height * 4);
+            std::memcpy(baseline.data(), pixels, baseline.size());
+            stbi_image_free(pixels);
+            auto end = std::chrono::high_resolution_clock::now();
+            result.baseline_ms += std::chrono::duration<double, std::milli>(end - start).count();
+
+            // Decode to native channels, then expand into staging
+            start = std::chrono::high_resolution_clock::now();
+            ImageData image = decode_image(bytes.data(), bytes.size());
+            expanded.resize(image.width * image.height * 4);
+            expand_to_rgba(
+                image.pixels.get(), 
+                expanded.data(), 
+                image.width * image.height, 
+                image.channels
+            );
+            end = std::chrono::high_resolution_clock::now();
+            result.expanded_ms += std::chrono::duration<double, std::milli>(end - start).count();
+            result.megapixels += width * height / 1e6;
+        }
+
+        if(baseline != expanded) {
+            std::cerr << filename << " does not decode identically!\n";
+            return 1;
+        }
+    }
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "format  rgba+copy (MP/s)  native+expand (MP/s)\n";
+    for(auto &pair : results) {
+        Result &result = pair.second;
+        std::cout << std::setw(6) << pair.first << "  "
+                  << std::setw(16) << result.megapixels / (result.baseline_ms / 1000) << "  "
+                  << std::setw(20) << result.megapixels / (result.expanded_ms / 1000) << "\n";
+    }
+    return 0;
+}
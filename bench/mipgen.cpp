@@ -0,0 +1,60 @@
+#include <SDL2/SDL.h>
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <random>
+
+#include "core.h"
+
+// Mip generation benchmark
+// Compares loading textures with the blit chain on the graphics queue
+// against a single compute dispatch per texture
+// Both paths upload the same base level, so the difference in load
+// time is the difference in mip generation
+int main(int argc, char **argv) {
+    SDL_Init(SDL_INIT_VIDEO);
+    SDL_Window *window = SDL_CreateWindow(
+        "Mip Generation Benchmark",
+        SDL_WINDOWPOS_CENTERED,
+        SDL_WINDOWPOS_CENTERED,
+        640,
+        480,
+        SDL_WINDOW_VULKAN | SDL_WINDOW_HIDDEN
+    );
+    const int iterations = 10;
+    const std::vector<int> sizes = {512, 1024, 2048, 4096};
+
+    {
+        Core renderer(window);
+
+        std::mt19937 random(0);
+        std::cout << std::setw(6) << "size"
+                  << std::setw(12) << "blit ms"
+                  << std::setw(12) << "compute ms" << "\n";
+        for(int size : sizes) {
+            std::vector<unsigned char> pixels(size * size * 4);
+            for(auto &texel : pixels) {
+                texel = random() & 0xff;
+            }
+
+            double times[2] = {0, 0};
+            for(int mode = 0; mode < 2; mode++) {
+                renderer.set_compute_mipmaps(mode == 1);
+                for(int i = 0; i < iterations; i++) {
+                    auto start = std::chrono::high_resolution_clock::now();
+                    renderer.load_texture(pixels.data(), size, size);
+                    renderer.wait_compute_mipmaps();
+                    auto end = std::chrono::high_resolution_clock::now();
+                    times[mode] += std::chrono::duration<double, std::milli>(end - start).count();
+                }
+            }
+            std::cout << std::setw(6) << size
+                      << std::setw(12) << std::fixed << std::setprecision(2) << times[0] / iterations
+                      << std::setw(12) << times[1] / iterations << "\n";
+        }
+    }
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+    return 0;
+}
@@ -0,0 +1,48 @@
+#include <SDL2/SDL.h>
+
+#include <iostream>
+#include <iomanip>
+#include <cstdio>
+#include <chrono>
+
+#include "core.h"
+
+// Pipeline cache benchmark
+// Starts the renderer without a pipeline cache on disk, then again with
+// the cache the first run saved, timing the creation of its pipelines
+// and the whole startup
+int main(int argc, char **argv) {
+    SDL_Init(SDL_INIT_VIDEO);
+    SDL_Window *window = SDL_CreateWindow(
+        "Pipeline Cache Benchmark",
+        SDL_WINDOWPOS_CENTERED,
+        SDL_WINDOWPOS_CENTERED,
+        640,
+        480,
+        SDL_WINDOW_VULKAN | SDL_WINDOW_HIDDEN
+    );
+    std::remove("pipeline.cache");
+
+    std::cout << std::setw(8) << "cache"
+              << std::setw(12) << "pipelines"
+              << std::setw(14) << "pipeline ms"
+              << std::setw(14) << "startup ms"
+              << std::setw(12) << "bytes" << "\n";
+    for(int run = 0; run < 2; run++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        Core renderer(window);
+        double startup_ms = std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - start
+        ).count();
+
+        PipelineCacheStats &stats = renderer.get_pipeline_cache_stats();
+        std::cout << std::setw(8) << (stats.warm ? "warm" : "cold")
+                  << std::setw(12) << stats.pipelines
+                  << std::setw(14) << std::fixed << std::setprecision(2) << stats.create_ms
+                  << std::setw(14) << startup_ms
+                  << std::setw(12) << stats.loaded_size << "\n";
+    }
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+    return 0;
+}
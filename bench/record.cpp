@@ -0,0 +1,87 @@
+#include <SDL2/SDL.h>
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include "core.h"
+
+// Command recording benchmark
+// Records the draws of many models with an increasing number of 
+// threads, each recording its share into secondary command buffers
+// Then adds a single model, which only re-records its own batch
+int main(int argc, char **argv) {
+    SDL_Init(SDL_INIT_VIDEO);
+    SDL_Window *window = SDL_CreateWindow(
+        "Command Recording Benchmark",
+        SDL_WINDOWPOS_CENTERED,
+        SDL_WINDOWPOS_CENTERED,
+        640,
+        480,
+        SDL_WINDOW_VULKAN | SDL_WINDOW_HIDDEN
+    );
+    const int iterations = 10;
+    const std::vector<int> counts = {10000, 50000};
+
+    {
+        Core renderer(window);
+
+        Mesh square;
+        square.vertices = {
+            {{-0.5f, -0.5f, 0.0f}, {1.0f, 0.0f, 0.0f, 1.0f}, {0.0f, 0.0f}},
+            {{0.5f, -0.5f, 0.0f}, {0.0f, 1.0f, 0.0f, 1.0f}, {1.0f, 0.0f}},
+            {{0.5f, 0.5f, 0.0f}, {0.0f, 0.0f, 1.0f, 1.0f}, {1.0f, 1.0f}},
+            {{-0.5f, 0.5f, 0.0f}, {1.0f, 1.0f, 1.0f, 1.0f}, {0.0f, 1.0f}}
+        };
+        square.indices = {0, 1, 2, 2, 3, 0};
+
+        int added = 0;
+        unsigned max_threads = std::max(1u, std::thread::hardware_concurrency());
+        std::cout << std::setw(8) << "models"
+                  << std::setw(10) << "threads"
+                  << std::setw(12) << "record ms" 
+                  << std::setw(10) << "speedup"
+                  << std::setw(10) << "binds"
+                  << std::setw(10) << "pipelines" << "\n";
+        for(int count : counts) {
+            std::vector<Mesh *> meshes(std::max(count - added, 0), &square);
+            renderer.add_models(meshes, 0);
+            added = count;
+
+            double single = 0;
+            for(unsigned threads = 1; threads <= max_threads; threads *= 2) {
+                double total = 0;
+                for(int i = 0; i < iterations; i++) {
+                    renderer.set_record_threads(threads);
+                    renderer.refresh();
+                    total += renderer.get_record_stats().record_ms;
+                }
+                double average = total / iterations;
+                if(threads == 1) {
+                    single = average;
+                }
+                std::cout << std::setw(8) << count
+                          << std::setw(10) << renderer.get_record_stats().threads
+                          << std::setw(12) << std::fixed << std::setprecision(2) << average
+                          << std::setw(10) << single / average
+                          << std::setw(10) << renderer.get_record_stats().binds
+                          << std::setw(10) << renderer.get_record_stats().pipelines << "\n";
+            }
+
+            // Adding a model dirties a single batch
+            double total = 0;
+            for(int i = 0; i < iterations; i++) {
+                renderer.add_model(square, 0);
+                renderer.refresh();
+                total += renderer.get_record_stats().record_ms;
+            }
+            added += iterations;
+            std::cout << std::setw(8) << count
+                      << std::setw(10) << "add"
+                      << std::setw(12) << total / iterations << "\n";
+        }
+    }
+    SDL_DestroyWindow(window);
+    SDL_Quit();
+    return 0;
+}
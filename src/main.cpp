@@ -29,9 +29,14 @@ int main(int argc, char **argv) {
     Core renderer(window);
 
     // Load textures
-    Texture t1 = renderer.load_texture("../assets/texture.jpg");
-    Texture t2 = renderer.load_texture("../assets/hazard.png");
-    Texture viking_room_texture = renderer.load_texture("../assets/viking_room.png");
+    std::vector<Texture> textures = renderer.load_textures({
+        "../assets/texture.jpg",
+        "../assets/hazard.png",
+        "../assets/viking_room.png"
+    });
+    Texture t1 = textures[0];
+    Texture t2 = textures[1];
+    Texture viking_room_texture = textures[2];
 
     // Load models
     Mesh squares;
@@ -52,11 +57,26 @@ int main(int argc, char **argv) {
     };
     Mesh viking_room("../assets/viking_room.obj");
 
+    // Upload each mesh once, its models are drawn as instances
+    MeshHandle squares_mesh = renderer.upload_mesh(squares);
+    MeshHandle viking_room_mesh = renderer.upload_mesh(viking_room);
+
     std::vector<Model> models;
 
     SDL_Event e;
     bool running = true;
+    auto start_time = std::chrono::high_resolution_clock::now();
     while(running) {
+        // Spin all models together
+        float time = std::chrono::duration<float>(
+            std::chrono::high_resolution_clock::now() - start_time
+        ).count();
+        glm::mat4 spin = glm::rotate(
+            glm::mat4(1.0f), 
+            time * glm::radians(60.0f), 
+            glm::vec3(0.0f, 0.0f, 1.0f)
+        );
+        renderer.set_transforms(models, std::vector<glm::mat4>(models.size(), spin));
         renderer.refresh();
         while(SDL_PollEvent(&e) != 0) {
             if(e.type == SDL_QUIT) {
@@ -86,16 +106,16 @@ int main(int argc, char **argv) {
                     }
                 }
                 else if(e.key.keysym.sym == SDLK_t) {
-                    models.push_back(renderer.add_model(squares, 0));
+                    models.push_back(renderer.add_model(squares_mesh, 0));
                 }
                 else if(e.key.keysym.sym == SDLK_y) {
-                    models.push_back(renderer.add_model(squares, t1));
+                    models.push_back(renderer.add_model(squares_mesh, t1));
                 }
                 else if(e.key.keysym.sym == SDLK_u) {
-                    models.push_back(renderer.add_model(squares, t2));
+                    models.push_back(renderer.add_model(squares_mesh, t2));
                 }
                 else if(e.key.keysym.sym == SDLK_i) {
-                    models.push_back(renderer.add_model(viking_room, viking_room_texture));
+                    models.push_back(renderer.add_model(viking_room_mesh, viking_room_texture));
                 }
                 else if(e.key.keysym.sym == SDLK_r) {
                     Model model = models.back();
@@ -0,0 +1,201 @@
+#include "atlas.h"
+
+AtlasPage::AtlasPage(uint32_t size, Texture texture) {
+    size_ = size;
+    texture_ = texture;
+    dirty_ = false;
+    dirty_rect_ = {0, 0, 0, 0};
+
+    // Initially, the skyline is a single segment spanning the page
+    skyline_.push_back({0, 0, size_});
+    pixels_.resize(size_ * size_ * 4, 0);
+}
+
+bool AtlasPage::fit(int index, uint32_t width, uint32_t height, uint32_t &y) {
+    uint32_t x = skyline_[index].x;
+    if(x + width > size_) {
+        return false;
+    }
+
+    // Rest the rectangle on the highest segment it spans
+    int remaining = width;
+    y = skyline_[index].y;
+    while(remaining > 0) {
+        y = std::max(y, skyline_[index].y);
+        if(y + height > size_) {
+            return false;
+        }
+        remaining -= skyline_[index].width;
+        index++;
+    }
+    return true;
+}
+
+void AtlasPage::merge() {
+    for(int i = 0; i + 1 < skyline_.size(); i++) {
+        if(skyline_[i].y == skyline_[i + 1].y) {
+            skyline_[i].width += skyline_[i + 1].width;
+            skyline_.erase(skyline_.begin() + i + 1);
+            i--;
+        }
+    }
+}
+
+bool AtlasPage::pack(uint32_t width, uint32_t height, uint32_t &x, uint32_t &y) {
+    // Find the placement that keeps the skyline lowest
+    int best = -1;
+    uint32_t best_top = UINT32_MAX;
+    uint32_t best_y = 0;
+    for(int i = 0; i < skyline_.size(); i++) {
+        uint32_t fit_y;
+        if(fit(i, width, height, fit_y) && fit_y + height < best_top) {
+            best = i;
+            best_top = fit_y + height;
+            best_y = fit_y;
+        }
+    }
+    if(best < 0) {
+        return false;
+    }
+    x = skyline_[best].x;
+    y = best_y;
+
+    // Raise the skyline over the new rectangle
+    Segment segment = {x, y + height, width};
+    skyline_.insert(skyline_.begin() + best, segment);
+
+    // Shrink or remove the segments it now covers
+    for(int i = best + 1; i < skyline_.size(); i++) {
+        uint32_t prev_end = skyline_[i - 1].x + skyline_[i - 1].width;
+        Segment &curr = skyline_[i];
+        if(curr.x >= prev_end) {
+            break;
+        }
+
+        uint32_t shrink = prev_end - curr.x;
+        if(curr.width <= shrink) {
+            skyline_.erase(skyline_.begin() + i);
+            i--;
+        }
+        else {
+            curr.x += shrink;
+            curr.width -= shrink;
+            break;
+        }
+    }
+    merge();
+    return true;
+}
+
+void AtlasPage::blit(unsigned char pixels[],
+                     uint32_t x, uint32_t y,
+                     uint32_t width, uint32_t height,
+                     uint32_t padding) {
+    // Border texels are repeated into the padding so that
+    // linear filtering does not bleed in neighboring sprites
+    uint32_t padded_height = height + 2 * padding;
+    for(uint32_t row = 0; row < padded_height; row++) {
+        int src_row = clamp<int>(
+            static_cast<int>(row) - static_cast<int>(padding),
+            0, height - 1
+        );
+        unsigned char *dst = &pixels_[((y + row) * size_ + x) * 4];
+        unsigned char *src = &pixels[src_row * width * 4];
+        for(uint32_t col = 0; col < padding; col++) {
+            std::memcpy(dst + col * 4, src, 4);
+            std::memcpy(
+                dst + (padding + width + col) * 4,
+                src + (width - 1) * 4,
+                4
+            );
+        }
+        std::memcpy(dst + padding * 4, src, width * 4);
+    }
+
+    // Grow the dirty region to include the padded rectangle
+    uint32_t right = x + width + 2 * padding;
+    uint32_t bottom = y + padded_height;
+    if(dirty_) {
+        right = std::max(right, dirty_rect_.x + dirty_rect_.width);
+        bottom = std::max(bottom, dirty_rect_.y + dirty_rect_.height);
+        x = std::min(x, dirty_rect_.x);
+        y = std::min(y, dirty_rect_.y);
+    }
+    dirty_rect_ = {x, y, right - x, bottom - y};
+    dirty_ = true;
+}
+
+uint32_t AtlasPage::get_size() {
+    return size_;
+}
+
+Texture AtlasPage::get_texture() {
+    return texture_;
+}
+
+unsigned char *AtlasPage::get_pixels() {
+    return &pixels_[0];
+}
+
+bool AtlasPage::is_dirty() {
+    return dirty_;
+}
+
+TextureRect AtlasPage::get_dirty_rect() {
+    return dirty_rect_;
+}
+
+void AtlasPage::clean() {
+    dirty_ = false;
+    dirty_rect_ = {0, 0, 0, 0};
+}
+
+TextureAtlas::TextureAtlas(uint32_t page_size, uint32_t padding) {
+    page_size_ = page_size;
+    padding_ = padding;
+}
+
+uint32_t TextureAtlas::get_page_size() {
+    return page_size_;
+}
+
+bool TextureAtlas::is_packable(uint32_t width, uint32_t height) {
+    // Larger images would waste most of a page, load them separately
+    uint32_t limit = page_size_ / 4;
+    return width + 2 * padding_ <= limit &&
+           height + 2 * padding_ <= limit;
+}
+
+void TextureAtlas::add_page(Texture texture) {
+    pages_.push_back(
+        std::make_unique<AtlasPage>(page_size_, texture)
+    );
+}
+
+bool TextureAtlas::pack(unsigned char pixels[],
+                        uint32_t width, uint32_t height,
+                        Sprite &sprite) {
+    uint32_t padded_width = width + 2 * padding_;
+    uint32_t padded_height = height + 2 * padding_;
+    for(auto &page : pages_) {
+        uint32_t x, y;
+        if(!page->pack(padded_width, padded_height, x, y)) {
+            continue;
+        }
+        page->blit(pixels, x, y, width, height, padding_);
+
+        // Texture coordinates exclude the padding
+        float size = static_cast<float>(page_size_);
+        sprite.texture = page->get_texture();
+        sprite.rect.x = (x + padding_) / size;
+        sprite.rect.y = (y + padding_) / size;
+        sprite.rect.width = width / size;
+        sprite.rect.height = height / size;
+        return true;
+    }
+    return false;
+}
+
+std::vector<std::unique_ptr<AtlasPage>> &TextureAtlas::get_pages() {
+    return pages_;
+}
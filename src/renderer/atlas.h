@@ -0,0 +1,115 @@
+#ifndef RENDER_ATLAS_H_
+#define RENDER_ATLAS_H_
+
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+
+#include "texture.h"
+#include "util.h"
+
+// Normalized texture coordinates of a region within a texture
+struct UVRect {
+    float x = 0.0f;
+    float y = 0.0f;
+    float width = 1.0f;
+    float height = 1.0f;
+};
+
+// A small image packed into a shared texture
+// Sprites on the same texture can be drawn in a single batch
+struct Sprite {
+    Texture texture = 0;
+    UVRect rect;
+};
+
+// A single square page of the atlas
+// Rectangles are placed with the skyline bottom-left heuristic
+class AtlasPage {
+    struct Segment {
+        uint32_t x;
+        uint32_t y;
+        uint32_t width;
+    };
+
+    uint32_t size_;
+    Texture texture_;
+    bool dirty_;
+
+    // Bounds of the texels blitted since the last upload
+    TextureRect dirty_rect_;
+
+    std::vector<Segment> skyline_;
+    std::vector<unsigned char> pixels_;
+
+    // Test if a rectangle fits on the skyline starting at a segment
+    // Writes the lowest y-coordinate it can be placed at
+    bool fit(int index, uint32_t width, uint32_t height, uint32_t &y);
+
+    // Merge adjacent segments that share the same height
+    void merge();
+
+public:
+    AtlasPage(uint32_t size, Texture texture);
+
+    // Find space for a rectangle and reserve it
+    // Returns false if the page is full
+    bool pack(uint32_t width, uint32_t height, uint32_t &x, uint32_t &y);
+
+    // Copy RGBA pixels into the page, extruding the edges into the padding
+    void blit(unsigned char pixels[],
+              uint32_t x, uint32_t y,
+              uint32_t width, uint32_t height,
+              uint32_t padding);
+
+    // Get the length of a side of the page
+    uint32_t get_size();
+
+    // Get the texture this page is uploaded to
+    Texture get_texture();
+
+    // Get the RGBA texel data of the page
+    unsigned char *get_pixels();
+
+    // Has the page changed since it was last uploaded?
+    bool is_dirty();
+
+    // Get the region covering every change since the last upload
+    TextureRect get_dirty_rect();
+
+    // Mark the page as uploaded
+    void clean();
+};
+
+// Packs small images into shared pages to reduce the number of
+// textures bound to the descriptor sets
+class TextureAtlas {
+    uint32_t page_size_;
+    uint32_t padding_;
+
+    std::vector<std::unique_ptr<AtlasPage>> pages_;
+
+public:
+    TextureAtlas(uint32_t page_size, uint32_t padding);
+
+    // Get the length of a side of each page
+    uint32_t get_page_size();
+
+    // Check if an image is small enough to be worth packing
+    bool is_packable(uint32_t width, uint32_t height);
+
+    // Add a new empty page backed by a texture
+    void add_page(Texture texture);
+
+    // Pack an image into an existing page
+    // Returns false if no page has room for it
+    bool pack(unsigned char pixels[],
+              uint32_t width, uint32_t height,
+              Sprite &sprite);
+
+    // Get all pages of the atlas
+    std::vector<std::unique_ptr<AtlasPage>> &get_pages();
+};
+
+#endif
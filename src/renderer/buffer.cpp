@@ -60,11 +60,19 @@ void RenderBuffer::alloc_memory() {
     int memory_type = -1;
     for(uint32_t i = 0; i < device_spec.memoryTypeCount; i++) {
         if((requirements.memoryTypeBits & (1 << i)) && 
-           (device_spec.memoryTypes[i].propertyFlags & properties_)) {
+           (device_spec.memoryTypes[i].propertyFlags & properties_) == properties_) {
             memory_type = i;
             break;
         }
     }
+
+    // Settle for a type with some of the properties
+    for(uint32_t i = 0; memory_type < 0 && i < device_spec.memoryTypeCount; i++) {
+        if((requirements.memoryTypeBits & (1 << i)) && 
+           (device_spec.memoryTypes[i].propertyFlags & properties_)) {
+            memory_type = i;
+        }
+    }
     if(memory_type < 0) {
         throw std::runtime_error("Vulkan failed to create buffer.");
     }
@@ -258,6 +266,15 @@ SubBuffer RenderBuffer::suballoc(size_t size) {
 }
 
 void RenderBuffer::copy(SubBuffer buffer, void *data, size_t length) {
+    size_t offset = reserve(buffer, length);
+    std::memcpy(
+        bind_ + subbuffers_[buffer].offset + offset, 
+        data, 
+        length
+    );
+}
+
+size_t RenderBuffer::reserve(SubBuffer buffer, size_t length) {
     check_subbuffer(buffer);
     auto &buffer_data = subbuffers_[buffer];
     if(!host_visible_) {
@@ -266,12 +283,9 @@ void RenderBuffer::copy(SubBuffer buffer, void *data, size_t length) {
     if(length + buffer_data.filled > buffer_data.size) {
         resuballoc(buffer, length + buffer_data.filled);
     }
-    std::memcpy(
-        bind_ + buffer_data.offset + buffer_data.filled, 
-        data, 
-        length
-    );
+    size_t offset = buffer_data.filled;
     buffer_data.filled += length;
+    return offset;
 }
 
 void RenderBuffer::copy_buffer(RenderBuffer &target, size_t length,
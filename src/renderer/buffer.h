@@ -49,6 +49,7 @@ class RenderBuffer {
     void initialize_buffer();
 
     // Allocate memory in the GPU for the buffer
+    // A memory type with all the requested properties is preferred
     void alloc_memory();
 
     // Copy data to another RenderBuffers using offsets
@@ -104,6 +105,11 @@ public:
 
     // Copy CPU data into a GPU subbuffer
     void copy(SubBuffer buffer, void *data, size_t length);
+
+    // Reserve a length of bytes at the end of a subbuffer to be
+    // written directly through the mapped pointer
+    // Returns the offset of the reserved bytes within the subbuffer
+    size_t reserve(SubBuffer buffer, size_t length);
     
     // Copy data to another RenderBuffer
     void copy_buffer(RenderBuffer &target, size_t length,
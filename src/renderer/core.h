@@ -1,7 +1,6 @@
 #ifndef RENDERER_H_
 #define RENDERER_H_
 #define VULKAN_HPP_TYPESAFE_CONVERSION
-#define STB_IMAGE_IMPLEMENTATION
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 
@@ -18,15 +17,34 @@
 
 #include <vector>
 #include <unordered_map>
+#include <map>
+#include <tuple>
 #include <exception>
 #include <iostream>
 #include <fstream>
 #include <memory>
 
 #include "pipeline.h"
+#include "pipecache.h"
+#include "variants.h"
 #include "image.h"
 #include "texture.h"
+#include "atlas.h"
+#include "loader.h"
+#include "threads.h"
+#include "recorder.h"
+#include "pack.h"
+#include "residency.h"
+#include "virtual.h"
+#include "sampler.h"
+#include "mipgen.h"
 #include "buffer.h"
+#include "geometry.h"
+#include "queue.h"
+#include "cull.h"
+#include "gpucull.h"
+#include "hiz.h"
+#include "graph.h"
 #include "physical.h"
 #include "mesh.h"
 #include "vertex.h"
@@ -45,15 +63,100 @@ struct PushConstantObject {
 
 struct UniformBufferObject {
     alignas(16) glm::mat4 transform;
+    alignas(16) glm::vec4 planes[6]; // View frustum, for GPU culling
+    alignas(16) glm::mat4 previous;  // Last frame's view-projection, for occlusion
+};
+
+// Per-instance data, indexed by the instance index
+// Aligned to match the std430 array stride in the vertex shader
+struct alignas(16) ObjectData {
+    glm::mat4 transform = glm::mat4(1.0f);
+    glm::vec4 sphere = glm::vec4(0.0f); // World space center and radius
+    int texture = 0;
+};
+
+// Push constant texture telling the vertex shader to read the texture
+// from the instance's object data instead
+constexpr int TEXTURE_FROM_OBJECT = 0x7FFFFFFF;
+
+// Pipeline variant of the default settings, registered first
+constexpr PipelineVariant DEFAULT_PIPELINE = 0;
+
+// Unique handle for uploaded meshes
+using MeshHandle = int;
+
+struct MeshData {
+    GeometryRange geometry;
+
+    // Bounding sphere of the vertices
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0;
+
+    // Models drawing the mesh
+    int models = 0;
+
+    // The geometry is freed once the mesh is removed and unused
+    bool removed = false;
 };
 
 // Unique handle for models
 using Model = int;
 
+// Models of the same mesh and texture are drawn as instances of a 
+// single draw
+using DrawGroup = int;
+
+struct DrawGroupData {
+    MeshHandle mesh;
+    Texture texture;
+    PipelineVariant pipeline = DEFAULT_PIPELINE;
+
+    // Range of instance slots, the models fill it from the start
+    uint32_t first_instance = 0;
+    uint32_t capacity = 0;
+    std::vector<Model> models;
+};
+
 struct ModelData {
-    SubBuffer vertexes;
-    SubBuffer indexes;
-    Texture texture = 0;
+    DrawGroup group;
+    uint32_t instance; // Index of the model within its group
+};
+
+// A swapchain image's copies of the draw records and instance data,
+// sized for the capacities they were created with
+struct DrawBuffers {
+    std::unique_ptr<RenderBuffer> records;
+    std::unique_ptr<RenderBuffer> culled;     // Halves for each cull pass
+    std::unique_ptr<RenderBuffer> objects;
+    std::unique_ptr<RenderBuffer> indices;
+    std::unique_ptr<RenderBuffer> visibility;
+    uint32_t draw_capacity = 0;
+    uint32_t instance_capacity = 0;
+};
+
+// A band of rows of a mip level staged for upload
+struct StagingChunk {
+    int upload;
+    uint32_t level;
+    TextureRect rect;
+    const unsigned char *pixels;
+    size_t offset;
+    bool last;
+};
+
+// Location of a streamed texture's texel data
+struct StreamSource {
+    int pack;
+    int entry;
+};
+
+// A texture replaced by streaming, kept while frames may still use it
+// Per swapchain image, 2 until its descriptor set points at the
+// replacement, then 1 until the first frame drawn with it finishes,
+// which also orders it after the copies out of the old image
+struct RetiredTexture {
+    std::unique_ptr<TextureData> texture;
+    std::vector<int> frames;
 };
 
 // TODO: Implement better command buffer management
@@ -78,21 +181,16 @@ class Core {
     std::unique_ptr<PhysicalDevice> physical_;
     vk::UniqueDevice logical_;
 
+    // Pipeline cache shared by all pipelines, kept on disk between runs
+    std::unique_ptr<PipelineCache> pipeline_cache_;
+
     // Swapchain and its images
     vk::UniqueSwapchainKHR swapchain_;
     std::vector<vk::Image> images_;
     std::vector<vk::UniqueImageView> views_;
-    
-    // Depth buffer
-    vk::UniqueImage depth_image_;
-    vk::UniqueImageView depth_view_;
-    ImageMemoryHandle depth_memory_handle_;
 
-    // Color buffer for MSAA
+    // Sample count of the color and depth buffers for MSAA
     vk::SampleCountFlagBits msaa_samples_;
-    vk::UniqueImage color_image_;
-    vk::UniqueImageView color_view_;
-    ImageMemoryHandle color_memory_handle_;
 
     // Image meta data
     vk::Extent2D image_extent_;
@@ -106,12 +204,25 @@ class Core {
     vk::UniqueDescriptorPool descriptor_pool_;
     std::vector<vk::UniqueDescriptorSet> descriptor_sets_;
 
-    // Graphics pipeline
-    vk::UniqueRenderPass render_pass_;
-    std::unique_ptr<Pipeline> pipeline_;
-
-    // Framebuffers
-    std::vector<vk::UniqueFramebuffer> framebuffers_;
+    // Passes of a frame, owning the color and depth buffers, render
+    // passes and framebuffers, and the barriers between the passes
+    // Rebuilt when the drawing or culling modes change the passes
+    std::unique_ptr<RenderGraph> graph_;
+    GraphResource color_target_;
+    GraphResource depth_target_;
+    GraphResource swapchain_target_;
+    GraphPass scene_pass_;
+    bool graph_dirty_;
+
+    // Attachments of the scene pass the pipelines were built for
+    std::vector<GraphAttachment> scene_attachments_;
+
+    // Graphics pipelines, built for the scene pass and compatible with
+    // the render passes of every graph
+    // The default pipeline is built up front and binds the descriptor
+    // sets and push constants, which every variant's layout matches
+    std::unique_ptr<PipelineVariants> variants_;
+    Pipeline *pipeline_;
 
     // Command pool (memory buffer for commands)
     vk::UniqueCommandPool graphics_pool_;
@@ -121,28 +232,179 @@ class Core {
     std::vector<vk::UniqueCommandBuffer> graphics_commands_;
     vk::UniqueCommandBuffer transfer_commands_; // For copying
 
+    // Records the draws into secondary buffers across worker threads
+    std::unique_ptr<CommandRecorder> recorder_;
+
     // Command Queues (submitting commands)
     AvailableQueues queues_;
     vk::Queue graphics_queue_;
     vk::Queue present_queue_;
     vk::Queue transfer_queue_;
+    vk::Queue compute_queue_;
 
     // Data buffers
-    // Object buffer is a one-size-fits-all for vertex and index data
-    std::unique_ptr<RenderBuffer> staging_buffer_;
-    std::unique_ptr<RenderBuffer> object_buffer_;
+    // Geometry buffer holds the vertex and index data of all models
+    std::unique_ptr<GeometryBuffer> geometry_;
     size_t buffer_size_;
     
-    // Manage model data
+    // Manage mesh, draw group and model data
+    std::unordered_map<MeshHandle, MeshData> mesh_data_;
+    MeshHandle mesh_id_;
+    std::unordered_map<DrawGroup, DrawGroupData> group_data_;
+    std::map<std::tuple<MeshHandle, Texture, PipelineVariant>, DrawGroup> group_keys_;
+    DrawGroup group_id_;
     std::unordered_map<Model, ModelData> model_data_;
     Model model_id_;
 
+    // Draw groups of the whole frame sorted by state, then front to
+    // back, before they are split into recording batches
+    RenderQueue draw_queue_;
+    std::vector<DrawGroup> draw_order_;
+
+    // Per-instance object data of all draw groups
+    // Changes are gathered into a range of slots per swapchain image,
+    // copied in bulk when the image is acquired
+    std::unique_ptr<RangeAllocator> instances_;
+    std::vector<ObjectData> instance_objects_;
+    std::vector<std::pair<uint32_t, uint32_t>> object_ranges_;
+
+    // Indirect draw records of all draw groups
+    // In indirect mode the whole scene draws with a single indirect 
+    // call, so adding a model only changes a record
+    // Each swapchain image has its own copy of the records and object
+    // data, refreshed from these when it is acquired
+    // An image's buffers are recreated when it is acquired after either
+    // capacity grew, so growing never waits on the frames in flight
+    std::vector<vk::DrawIndexedIndirectCommand> draw_commands_;
+    std::vector<DrawGroup> draw_groups_;
+    std::unordered_map<DrawGroup, uint32_t> draw_slots_;
+    std::vector<DrawBuffers> draw_buffers_;
+    std::vector<uint64_t> draw_versions_;
+    uint64_t draw_version_;
+    uint32_t draw_capacity_;
+    bool indirect_;
+    bool indirect_count_;
+
+    // Images whose primary command buffers must be re-recorded
+    std::vector<bool> commands_dirty_;
+
+    // Frustum culling of instances against world space bounds
+    std::unique_ptr<FrustumCuller> culler_;
+    CullStats cull_stats_;
+    bool culling_;
+
+    // Images whose draw records and instance indices were compacted by
+    // culling on the CPU, rather than holding every instance
+    std::vector<bool> cpu_culled_images_;
+
+    // Frustum culling in a compute pass before the draws
+    // Each image's visible draw records are compacted into its culled
+    // buffer, whose count is read back a frame late for the stats
+    std::unique_ptr<GpuCuller> gpu_culler_;
+    bool gpu_culling_;
+
+    // Images whose culled buffer holds results not yet read
+    std::vector<bool> gpu_cull_pending_;
+
+    // Occlusion culling against a depth pyramid of the last frame
+    // Instances rejected by it are tested again against this frame's
+    // pyramid, and drawn by a second render pass if visible
+    std::unique_ptr<DepthPyramid> pyramid_;
+    glm::mat4 previous_view_projection_;
+    bool occlusion_culling_;
+
     // Uniform buffers
     std::unique_ptr<RenderBuffer> uniform_buffer_;
 
+    // Camera position and clipping planes
+    glm::vec3 eye_;
+    float near_;
+    float far_;
+    glm::mat4 view_projection_;
+
     // Texture handling
     std::vector<std::unique_ptr<TextureData>> textures_;
-    vk::UniqueSampler texture_sampler_;
+
+    // Sampling state of each texture
+    std::unique_ptr<SamplerCache> samplers_;
+    std::vector<SamplerSettings> texture_samplers_;
+
+    // Shared pages for small sprites
+    std::unique_ptr<TextureAtlas> atlas_;
+
+    // Worker threads for decoding textures
+    std::unique_ptr<ThreadPool> workers_;
+    TextureLoadStats texture_stats_;
+
+    // Memory mapped texture packs
+    std::vector<std::unique_ptr<TexturePack>> packs_;
+
+    // Mip streaming for textures loaded from packs
+    std::unique_ptr<TextureResidency> residency_;
+    std::unordered_map<Texture, StreamSource> stream_sources_;
+    size_t stream_limit_;
+
+    // Textures added or changed since each swapchain image's descriptor
+    // set was last written, and how many elements the set points at
+    // The sets are allocated for the most textures a stage can sample,
+    // so new textures only write their own element
+    std::vector<std::vector<Texture>> texture_writes_;
+    std::vector<uint32_t> texture_counts_;
+
+    // Textures replaced by streaming that frames may still use
+    std::vector<RetiredTexture> retired_textures_;
+
+    // Can texture descriptors be rewritten without invalidating the
+    // command buffers that bound their set?
+    bool update_after_bind_;
+
+    // Can texture descriptors no recorded command uses be written
+    // without invalidating the command buffers that bound their set?
+    bool update_unused_;
+
+    // Virtual textures, paged into a shared cache texture as the 
+    // fragment shader reports sampling them
+    // Each swapchain image has its own copy of the page tables and
+    // feedback buffer, only touched once its frame has finished
+    // The runs of entries changed since an image's last frame are
+    // queued for it, and its table buffer grows when it is acquired
+    std::unique_ptr<VirtualTextures> virtual_;
+    std::vector<StreamSource> virtual_sources_;
+    std::vector<std::unique_ptr<RenderBuffer>> virtual_tables_;
+    std::unique_ptr<RenderBuffer> virtual_feedback_;
+    std::vector<uint64_t> virtual_versions_;
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> virtual_changes_;
+    size_t virtual_page_limit_;
+
+    // Fixed window for staging texture loads, split into two halves
+    std::unique_ptr<RenderBuffer> upload_staging_;
+    std::vector<vk::UniqueFence> upload_fences_;
+    size_t upload_size_;
+
+    // Mip generation in a compute shader, on the async compute 
+    // queue if there is one
+    std::unique_ptr<RenderBuffer> mip_counters_;
+    std::unique_ptr<MipGenerator> mip_generator_;
+    vk::UniqueCommandPool compute_pool_;
+    std::vector<vk::UniqueSemaphore> mip_signals_;
+    bool compute_mipmaps_;
+
+    // Last batch generated on the async compute queue, whose commands
+    // and dispatch resources are kept until the fence of its hand back
+    // to the graphics queue
+    std::vector<vk::UniqueCommandBuffer> mip_commands_;
+    vk::UniqueFence mip_fence_;
+
+    // Per-frame texture updates
+    // Each frame owns a fixed region of the staging ring, so updates
+    // never wait on the frame currently being drawn
+    std::unique_ptr<RenderBuffer> update_staging_;
+    vk::UniqueCommandPool update_pool_;
+    std::vector<vk::UniqueCommandBuffer> update_commands_;
+    std::vector<vk::UniqueFence> update_fences_;
+    size_t update_size_;
+    int update_frame_;
+    bool updating_;
 
     // Semaphores
     // Ensures correct ordering between graphic and present commands
@@ -162,9 +424,6 @@ class Core {
     vk::ClearValue clear_value_;
     vk::ClearValue depth_clear_value_;
 
-    // Mip levels for all textures
-    uint32_t mip_levels_;
-
     bool vsync_ = false;
 
     // Get all required Vulkan extensions from SDL
@@ -298,6 +557,7 @@ class Core {
         unique_families.insert(queues_.graphics);
         unique_families.insert(queues_.present);
         unique_families.insert(queues_.transfer);
+        unique_families.insert(queues_.compute);
 
         // Allocate queues
         std::vector<vk::DeviceQueueCreateInfo> queue_infos;
@@ -320,11 +580,37 @@ class Core {
         device_features.sampleRateShading = true;
         device_features.fillModeNonSolid = true;
         device_features.wideLines = true;
-
-        vk::PhysicalDeviceDescriptorIndexingFeatures descriptor_indexing_features;
+        device_features.shaderStorageImageArrayDynamicIndexing = 
+            physical_->get_features().shaderStorageImageArrayDynamicIndexing;
+        device_features.fragmentStoresAndAtomics = 
+            physical_->get_features().fragmentStoresAndAtomics;
+        device_features.multiDrawIndirect = 
+            physical_->get_features().multiDrawIndirect;
+        device_features.drawIndirectFirstInstance = 
+            physical_->get_features().drawIndirectFirstInstance;
+
+        // Indirect draws can read their count from a buffer on Vulkan 1.2
+        auto supported = physical_->get_handle().getFeatures2<
+            vk::PhysicalDeviceFeatures2, 
+            vk::PhysicalDeviceVulkan12Features
+        >();
+        indirect_count_ = supported.get<vk::PhysicalDeviceVulkan12Features>().drawIndirectCount;
+
+        // Streaming rewrites texture descriptors of sets already bound
+        update_after_bind_ = supported.get<vk::PhysicalDeviceVulkan12Features>()
+                                      .descriptorBindingSampledImageUpdateAfterBind;
+
+        // New textures write descriptors of sets already bound
+        update_unused_ = supported.get<vk::PhysicalDeviceVulkan12Features>()
+                                  .descriptorBindingUpdateUnusedWhilePending;
+
+        vk::PhysicalDeviceVulkan12Features descriptor_indexing_features;
         descriptor_indexing_features.descriptorBindingPartiallyBound = true;
         descriptor_indexing_features.runtimeDescriptorArray = true;
         descriptor_indexing_features.descriptorBindingVariableDescriptorCount = true;
+        descriptor_indexing_features.drawIndirectCount = indirect_count_;
+        descriptor_indexing_features.descriptorBindingSampledImageUpdateAfterBind = update_after_bind_;
+        descriptor_indexing_features.descriptorBindingUpdateUnusedWhilePending = update_unused_;
 
         // Create the logical device
         auto &device_extensions = physical_->get_extensions();
@@ -346,6 +632,9 @@ class Core {
         present_queue_  = logical_->getQueue(
             queues_.present.index, 0
         );
+        compute_queue_ = logical_->getQueue(
+            queues_.compute.index, 0
+        );
         transfer_queue_  = logical_->getQueue(
             queues_.transfer.index, 0
         );
@@ -488,24 +777,67 @@ class Core {
         ubo_layout_binding.descriptorCount = 1;
         ubo_layout_binding.stageFlags = vk::ShaderStageFlagBits::eVertex;
 
+        // Virtual texture page tables and feedback bindings
+        vk::DescriptorSetLayoutBinding page_table_layout_binding;
+        page_table_layout_binding.binding = 1;
+        page_table_layout_binding.descriptorType = vk::DescriptorType::eStorageBuffer;
+        page_table_layout_binding.descriptorCount = 1;
+        page_table_layout_binding.stageFlags = vk::ShaderStageFlagBits::eFragment;
+
+        vk::DescriptorSetLayoutBinding feedback_layout_binding;
+        feedback_layout_binding.binding = 2;
+        feedback_layout_binding.descriptorType = vk::DescriptorType::eStorageBuffer;
+        feedback_layout_binding.descriptorCount = 1;
+        feedback_layout_binding.stageFlags = vk::ShaderStageFlagBits::eFragment;
+
+        // Per-instance object data binding
+        vk::DescriptorSetLayoutBinding object_layout_binding;
+        object_layout_binding.binding = 3;
+        object_layout_binding.descriptorType = vk::DescriptorType::eStorageBuffer;
+        object_layout_binding.descriptorCount = 1;
+        object_layout_binding.stageFlags = vk::ShaderStageFlagBits::eVertex;
+
+        // Instance index to object data slot binding
+        vk::DescriptorSetLayoutBinding instance_layout_binding;
+        instance_layout_binding.binding = 4;
+        instance_layout_binding.descriptorType = vk::DescriptorType::eStorageBuffer;
+        instance_layout_binding.descriptorCount = 1;
+        instance_layout_binding.stageFlags = vk::ShaderStageFlagBits::eVertex;
+
         // Image layout sampler binding (supports variable count textures)
+        // Variable count bindings must come last
         uint32_t max_samplers = physical_->get_limits().maxPerStageDescriptorSamplers;
         vk::DescriptorSetLayoutBinding sampler_layout_binding;
-        sampler_layout_binding.binding = 1;
+        sampler_layout_binding.binding = 5;
         sampler_layout_binding.descriptorType = vk::DescriptorType::eCombinedImageSampler;
         sampler_layout_binding.descriptorCount = max_samplers;
         sampler_layout_binding.stageFlags = vk::ShaderStageFlagBits::eFragment;
         
         std::vector<vk::DescriptorSetLayoutBinding> bindings = {
             ubo_layout_binding, 
+            page_table_layout_binding,
+            feedback_layout_binding,
+            object_layout_binding,
+            instance_layout_binding,
             sampler_layout_binding
         };
 
         // Set binding flags
         std::vector<vk::DescriptorBindingFlags> flags = {
-            vk::DescriptorBindingFlagBitsEXT::ePartiallyBound,
+            {},
+            {},
+            {},
+            {},
+            {},
+            vk::DescriptorBindingFlagBitsEXT::ePartiallyBound |
             vk::DescriptorBindingFlagBitsEXT::eVariableDescriptorCount
         };
+        if(update_after_bind_) {
+            flags.back() |= vk::DescriptorBindingFlagBitsEXT::eUpdateAfterBind;
+        }
+        if(update_unused_) {
+            flags.back() |= vk::DescriptorBindingFlagBitsEXT::eUpdateUnusedWhilePending;
+        }
         vk::DescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info;
         binding_flags_info.bindingCount = flags.size();
         binding_flags_info.pBindingFlags = &flags[0];
@@ -515,165 +847,305 @@ class Core {
         descriptor_layout_info.bindingCount = bindings.size();
         descriptor_layout_info.pBindings = &bindings[0];
         descriptor_layout_info.pNext = &binding_flags_info;
+        if(update_after_bind_) {
+            descriptor_layout_info.flags = vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool;
+        }
         
         descriptor_layout_ = logical_->createDescriptorSetLayoutUnique(
             descriptor_layout_info
         );
     }
 
-    // Initialize the render pass
-    // Describes the scope of a render operation (color, depth, stencil)
-    // Lists attachments, dependencies, and subpasses
-    // Driver knows what to expect for render operation
-    void create_render_pass() {
-        // Color buffer for a single swapchain image
-        vk::AttachmentDescription color_attachment;
-        color_attachment.format = image_format_;
-        color_attachment.samples = msaa_samples_;
+    // Declare the passes of a frame and compile them into a new graph
+    // Culling on the GPU adds a compute pass before the scene, and
+    // occlusion culling splits the scene around building the depth
+    // pyramid and culling what it wrongly occluded
+    void create_render_graph() {
+        graph_.reset();
+        graph_ = std::make_unique<RenderGraph>(logical_.get(), *physical_);
+        bool gpu_culling = indirect_ && culling_ && gpu_culling_;
+        bool occlusion = gpu_culling && occlusion_culling_;
+
+        GraphImageInfo color_info;
+        color_info.format = image_format_;
+        color_info.extent = image_extent_;
+        color_info.samples = msaa_samples_;
+        color_target_ = graph_->create_image("color", color_info);
+
+        // Always sampleable, so the pyramid can be pointed at it
+        GraphImageInfo depth_info;
+        depth_info.format = get_depth_format();
+        depth_info.extent = image_extent_;
+        depth_info.samples = msaa_samples_;
+        depth_info.aspect = vk::ImageAspectFlagBits::eDepth;
+        depth_info.usage = vk::ImageUsageFlagBits::eSampled;
+        depth_target_ = graph_->create_image("depth", depth_info);
+
+        GraphImageInfo swapchain_info;
+        swapchain_info.format = image_format_;
+        swapchain_info.extent = image_extent_;
+        std::vector<vk::ImageView> swapchain_views;
+        for(auto &view : views_) {
+            swapchain_views.push_back(view.get());
+        }
+        swapchain_target_ = graph_->import_image(
+            "swapchain",
+            swapchain_info,
+            images_,
+            swapchain_views,
+            vk::ImageLayout::eUndefined,
+            vk::ImageLayout::ePresentSrcKHR
+        );
+        graph_->set_output(swapchain_target_);
 
-        // Overwrite old buffer data
-        color_attachment.loadOp = vk::AttachmentLoadOp::eClear;
-        color_attachment.storeOp = vk::AttachmentStoreOp::eDontCare;
-        
-        color_attachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
-        color_attachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+        // The culled counts are read back by the host for the stats
+        GraphResource culled = graph_->import_buffer(
+            "culled",
+            vk::PipelineStageFlagBits::eHost,
+            vk::AccessFlagBits::eHostRead
+        );
+        GraphResource instances = graph_->import_buffer("instances");
+        GraphResource visibility = graph_->import_buffer("visibility");
+        graph_->set_output(culled);
+
+        // Virtual texture feedback is written by the fragment shader and
+        // read by the host once the image's frame has finished
+        GraphResource feedback = graph_->import_buffer(
+            "feedback",
+            vk::PipelineStageFlagBits::eHost,
+            vk::AccessFlagBits::eHostRead
+        );
+        graph_->set_output(feedback);
+
+        // Built from this frame's depth, and read by the first cull
+        // pass of the next frame
+        GraphResource pyramid = -1;
+        if(occlusion) {
+            GraphImageInfo pyramid_info;
+            pyramid_info.format = vk::Format::eR32Sfloat;
+            pyramid_info.levels = pyramid_->get_levels();
+            pyramid = graph_->import_image(
+                "pyramid",
+                pyramid_info,
+                {pyramid_->get_image()},
+                {pyramid_->get_descriptor().imageView},
+                vk::ImageLayout::eGeneral,
+                vk::ImageLayout::eGeneral
+            );
+        }
+
+        // Reset by the transfer stage, then written by the shader
+        vk::PipelineStageFlags cull_stages = vk::PipelineStageFlagBits::eTransfer |
+                                             vk::PipelineStageFlagBits::eComputeShader;
+        if(gpu_culling) {
+            GraphPass cull_pass = graph_->add_pass(
+                "cull",
+                vk::PipelineBindPoint::eCompute,
+                [this, occlusion](vk::CommandBuffer command_buffer, uint32_t image) {
+                    gpu_culler_->record_cull(
+                        command_buffer,
+                        image,
+                        CullPass::Visible,
+                        occlusion,
+                        draw_buffers_[image].draw_capacity
+                    );
+                }
+            );
+            graph_->use(cull_pass, culled, GraphUsage::StorageWrite, cull_stages);
+            graph_->use(cull_pass, instances, GraphUsage::StorageWrite);
+            graph_->use(cull_pass, visibility, GraphUsage::StorageWrite);
+            if(occlusion) {
+                graph_->use(cull_pass, pyramid, GraphUsage::Sampled);
+            }
+        }
 
-        // Transition to another color attachment layout for multisampling
-        color_attachment.initialLayout = vk::ImageLayout::eUndefined;
-        color_attachment.finalLayout = vk::ImageLayout::eColorAttachmentOptimal;
+        scene_pass_ = graph_->add_pass(
+            "scene",
+            vk::PipelineBindPoint::eGraphics,
+            [this](vk::CommandBuffer command_buffer, uint32_t image) {
+                if(indirect_) {
+                    record_indirect_draws(command_buffer, image);
+                    return;
+                }
 
-        vk::AttachmentReference color_ref;
-        color_ref.attachment = 0;
-        color_ref.layout = vk::ImageLayout::eColorAttachmentOptimal;
+                // Execute the secondary buffers holding the draws
+                std::vector<vk::CommandBuffer> secondaries = recorder_->get_commands(image);
+                if(!secondaries.empty()) {
+                    command_buffer.executeCommands(secondaries);
+                }
+            }
+        );
+        graph_->use(scene_pass_, color_target_, GraphUsage::ColorAttachment);
+        graph_->use(scene_pass_, depth_target_, GraphUsage::DepthAttachment);
+        graph_->clear(scene_pass_, color_target_, clear_value_);
+        graph_->clear(scene_pass_, depth_target_, depth_clear_value_);
+        graph_->use(
+            scene_pass_, 
+            feedback, 
+            GraphUsage::StorageWrite, 
+            vk::PipelineStageFlagBits::eFragmentShader
+        );
 
-        // Depth buffer
-        vk::AttachmentDescription depth_attachment;
-        depth_attachment.format = get_depth_format();
-        depth_attachment.samples = msaa_samples_;
+        // Resolved even when a disoccluded pass follows, so that every
+        // scene pass has the same attachments and the same pipelines
+        // are compatible with all of them
+        graph_->use(scene_pass_, swapchain_target_, GraphUsage::ResolveAttachment);
+        if(gpu_culling) {
+            graph_->use(scene_pass_, culled, GraphUsage::IndirectRead);
+            graph_->use(
+                scene_pass_,
+                instances,
+                GraphUsage::StorageRead,
+                vk::PipelineStageFlagBits::eVertexShader
+            );
+        }
+        if(!indirect_) {
+            graph_->set_secondary(scene_pass_);
+        }
 
-        // Clear old buffer data
-        depth_attachment.loadOp = vk::AttachmentLoadOp::eClear;
-        depth_attachment.storeOp = vk::AttachmentStoreOp::eDontCare;
-        
-        depth_attachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
-        depth_attachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+        if(occlusion) {
+            GraphPass build_pass = graph_->add_pass(
+                "pyramid",
+                vk::PipelineBindPoint::eCompute,
+                [this](vk::CommandBuffer command_buffer, uint32_t image) {
+                    pyramid_->record_build(command_buffer);
+                }
+            );
+            graph_->use(build_pass, depth_target_, GraphUsage::Sampled);
+            graph_->use(build_pass, pyramid, GraphUsage::StorageWrite);
+
+            GraphPass disocclusion_cull_pass = graph_->add_pass(
+                "cull disoccluded",
+                vk::PipelineBindPoint::eCompute,
+                [this](vk::CommandBuffer command_buffer, uint32_t image) {
+                    gpu_culler_->record_cull(
+                        command_buffer,
+                        image,
+                        CullPass::Disoccluded,
+                        true,
+                        draw_buffers_[image].draw_capacity
+                    );
+                }
+            );
+            graph_->use(disocclusion_cull_pass, pyramid, GraphUsage::Sampled);
+            graph_->use(disocclusion_cull_pass, culled, GraphUsage::StorageWrite, cull_stages);
+            graph_->use(disocclusion_cull_pass, instances, GraphUsage::StorageWrite);
+            graph_->use(disocclusion_cull_pass, visibility, GraphUsage::StorageWrite);
+
+            // Continues the scene pass' attachments, resolving them again
+            // with the disoccluded draws
+            GraphPass disocclusion_pass = graph_->add_pass(
+                "scene disoccluded",
+                vk::PipelineBindPoint::eGraphics,
+                [this](vk::CommandBuffer command_buffer, uint32_t image) {
+                    record_indirect_draws(command_buffer, image, CullPass::Disoccluded);
+                }
+            );
+            graph_->use(disocclusion_pass, color_target_, GraphUsage::ColorAttachment);
+            graph_->use(disocclusion_pass, depth_target_, GraphUsage::DepthAttachment);
+            graph_->use(disocclusion_pass, swapchain_target_, GraphUsage::ResolveAttachment);
+            graph_->use(
+                disocclusion_pass, 
+                feedback, 
+                GraphUsage::StorageWrite, 
+                vk::PipelineStageFlagBits::eFragmentShader
+            );
+            graph_->use(disocclusion_pass, culled, GraphUsage::IndirectRead);
+            graph_->use(
+                disocclusion_pass,
+                instances,
+                GraphUsage::StorageRead,
+                vk::PipelineStageFlagBits::eVertexShader
+            );
+        }
+        graph_->compile(images_.size());
+        graph_dirty_ = false;
+    }
+
+    // Re-record the batches drawing with variants that became ready
+    void redraw_finished_pipelines() {
+        std::vector<PipelineVariant> finished = variants_->take_finished();
+        if(finished.empty()) {
+            return;
+        }
+        std::sort(finished.begin(), finished.end());
+        for(auto &entry : group_data_) {
+            if(std::binary_search(finished.begin(), finished.end(), entry.second.pipeline)) {
+                recorder_->invalidate(entry.first);
+            }
+        }
+    }
 
-        depth_attachment.initialLayout = vk::ImageLayout::eUndefined;
-        depth_attachment.finalLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+    // Rebuild the graph after a change of modes, once no frame uses it
+    void rebuild_render_graph() {
+        logical_->waitIdle();
+        variants_->stop();
+        create_render_graph();
+        retarget_graphics_pipeline();
+        pyramid_->set_depth(graph_->get_view(depth_target_, 0));
+        invalidate_commands();
+    }
 
-        vk::AttachmentReference depth_ref;
-        depth_ref.attachment = 1;
-        depth_ref.layout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+    // Create the pipeline cache, warm if the last run on this device
+    // and driver saved one
+    void create_pipeline_cache() {
+        pipeline_cache_ = std::make_unique<PipelineCache>(
+            logical_.get(),
+            *physical_,
+            "pipeline.cache"
+        );
+    }
 
-        // Color resolve buffer for multisampling
-        vk::AttachmentDescription color_resolve_attachment;
-        color_resolve_attachment.format = image_format_;
-        color_resolve_attachment.samples = vk::SampleCountFlagBits::e1;
+    // Create the registry of graphics pipelines
+    // Variants compile on two threads of their own
+    void create_pipeline_variants() {
+        variants_ = std::make_unique<PipelineVariants>(
+            logical_.get(),
+            *pipeline_cache_,
+            descriptor_layout_.get(),
+            sizeof(PushConstantObject),
+            2
+        );
+        variants_->add(get_supported_settings(PipelineSettings()));
+    }
 
-        // Overwrite old buffer data
-        color_resolve_attachment.loadOp = vk::AttachmentLoadOp::eDontCare;
-        color_resolve_attachment.storeOp = vk::AttachmentStoreOp::eStore;
-        
-        color_resolve_attachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
-        color_resolve_attachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
-
-        // Transition layout to something presentable to the screen
-        color_resolve_attachment.initialLayout = vk::ImageLayout::eUndefined;
-        color_resolve_attachment.finalLayout = vk::ImageLayout::ePresentSrcKHR;
-
-        vk::AttachmentReference color_resolve_ref;
-        color_resolve_ref.attachment = 2;
-        color_resolve_ref.layout = vk::ImageLayout::eColorAttachmentOptimal;
-
-        // Subpasses
-        vk::SubpassDescription initial_subpass;
-        initial_subpass.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
-        initial_subpass.colorAttachmentCount = 1;
-        initial_subpass.pColorAttachments = &color_ref;
-        initial_subpass.pDepthStencilAttachment = &depth_ref;
-        initial_subpass.pResolveAttachments = &color_resolve_ref;
-
-        // Define subpass dependencies
-        vk::SubpassDependency subpass_dependency;
-        subpass_dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-        subpass_dependency.dstSubpass = 0;
-        subpass_dependency.srcStageMask = 
-            vk::PipelineStageFlagBits::eColorAttachmentOutput | 
-            vk::PipelineStageFlagBits::eEarlyFragmentTests;
-        subpass_dependency.dstStageMask = 
-            vk::PipelineStageFlagBits::eColorAttachmentOutput | 
-            vk::PipelineStageFlagBits::eEarlyFragmentTests;
-        subpass_dependency.srcAccessMask = vk::AccessFlagBits::eNoneKHR;
-        subpass_dependency.dstAccessMask = 
-            vk::AccessFlagBits::eColorAttachmentWrite | 
-            vk::AccessFlagBits::eDepthStencilAttachmentWrite;
-        
-        // Create the render pass
-        std::vector<vk::SubpassDescription> subpasses = {
-            initial_subpass
-        };
-        std::vector<vk::AttachmentDescription> attachments = {
-            color_attachment, 
-            depth_attachment, 
-            color_resolve_attachment
-        };
-        std::vector<vk::SubpassDependency> dependencies = {
-            subpass_dependency
-        };
-        vk::RenderPassCreateInfo render_pass_info;
-        render_pass_info.attachmentCount = attachments.size();
-        render_pass_info.pAttachments = &attachments[0];
-        render_pass_info.subpassCount = subpasses.size();
-        render_pass_info.pSubpasses = &subpasses[0];
-        render_pass_info.dependencyCount = dependencies.size();
-        render_pass_info.pDependencies = &dependencies[0];
-        
-        render_pass_ = logical_->createRenderPassUnique(render_pass_info);
+    // Get pipeline settings the device can build
+    // The base fragment shader writes virtual texture feedback, so it
+    // is swapped for a variant without the write if fragment shaders
+    // cannot store to buffers, and virtual textures stay coarse
+    PipelineSettings get_supported_settings(PipelineSettings settings) {
+        if(!physical_->get_features().fragmentStoresAndAtomics &&
+           settings.fragment_shader == "base.frag.spv") {
+            settings.fragment_shader = "base.nofeedback.frag.spv";
+        }
+        return settings;
     }
 
     // Initialize all stages of the graphics pipeline
     // This determines what and how things are drawn
     // This is the heart of the renderer, fixed at runtime
-    // We can have multiple pipelines for different types of rendering
+    // Every variant is rebuilt for the scene pass, the default one
+    // right away, the others in the background
+    // Viewport and scissor are dynamic, so the extent is not part of it
     void create_graphics_pipeline() {
-        pipeline_ = std::make_unique<Pipeline>(
-            logical_.get(),
-            image_extent_,
-            descriptor_layout_.get(),
-            render_pass_.get(),
-            "base.vert.spv",
-            "base.frag.spv",
-            vk::PrimitiveTopology::eTriangleList,
-            vk::PolygonMode::eFill,
-            msaa_samples_,
-            sizeof(PushConstantObject)
+        variants_->set_target(
+            graph_->get_render_pass(scene_pass_),
+            msaa_samples_
         );
+        variants_->build(DEFAULT_PIPELINE);
+        pipeline_ = variants_->get(DEFAULT_PIPELINE);
+        scene_attachments_ = graph_->get_attachments(scene_pass_);
     }
 
-    // Create the framebuffers for each swapchain image
-    // Framebuffers hold the memory attachments used by render pass
-    // Ex. color image buffer and depth buffer
-    void create_framebuffers() {
-        for(auto &view : views_) {
-            std::vector<vk::ImageView> views = {
-                color_view_.get(),
-                depth_view_.get(),
-                view.get()
-            };
-            vk::FramebufferCreateInfo framebuffer_info;
-            framebuffer_info.renderPass = render_pass_.get();
-            framebuffer_info.attachmentCount = views.size();
-            framebuffer_info.pAttachments = &views[0];
-            framebuffer_info.width = image_extent_.width;
-            framebuffer_info.height = image_extent_.height;
-            framebuffer_info.layers = 1;
-
-            framebuffers_.push_back(std::move(
-                    logical_->createFramebufferUnique(
-                        framebuffer_info
-                    )
-                )
-            );
+    // Point the pipelines at a rebuilt scene pass
+    // They are kept only if its attachments match those they were built
+    // for, otherwise they are no longer compatible and are rebuilt
+    void retarget_graphics_pipeline() {
+        if(graph_->get_attachments(scene_pass_) == scene_attachments_) {
+            variants_->set_render_pass(graph_->get_render_pass(scene_pass_));
+        }
+        else {
+            create_graphics_pipeline();
         }
     }
 
@@ -682,6 +1154,7 @@ class Core {
     void create_command_pool() {
         // Command pool for the graphics queue
         vk::CommandPoolCreateInfo graphics_pool_info;
+        graphics_pool_info.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
         graphics_pool_info.queueFamilyIndex = queues_.graphics.index;
         graphics_pool_ = logical_->createCommandPoolUnique(graphics_pool_info);
 
@@ -696,7 +1169,7 @@ class Core {
         vk::CommandBufferAllocateInfo graphics_cmd_alloc_info;
         graphics_cmd_alloc_info.commandPool = graphics_pool_.get();
         graphics_cmd_alloc_info.level = vk::CommandBufferLevel::ePrimary;
-        graphics_cmd_alloc_info.commandBufferCount = framebuffers_.size();
+        graphics_cmd_alloc_info.commandBufferCount = images_.size();
         graphics_commands_ = logical_->allocateCommandBuffersUnique(
             graphics_cmd_alloc_info
         );
@@ -710,49 +1183,277 @@ class Core {
         transfer_commands_ = std::move(
             logical_->allocateCommandBuffersUnique(transfer_cmd_alloc_info)[0]
         );
+    }
 
-        // Create the staging buffer for CPU to GPU copies
-        staging_buffer_ = std::make_unique<RenderBuffer>(
-            buffer_size_, 
+    // Create the staging ring and command buffers for texture updates
+    void create_texture_updates() {
+        vk::CommandPoolCreateInfo update_pool_info;
+        update_pool_info.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+        update_pool_info.queueFamilyIndex = queues_.graphics.index;
+        update_pool_ = logical_->createCommandPoolUnique(update_pool_info);
+
+        vk::CommandBufferAllocateInfo update_cmd_alloc_info;
+        update_cmd_alloc_info.commandPool = update_pool_.get();
+        update_cmd_alloc_info.level = vk::CommandBufferLevel::ePrimary;
+        update_cmd_alloc_info.commandBufferCount = max_frames_processing_;
+        update_commands_ = logical_->allocateCommandBuffersUnique(
+            update_cmd_alloc_info
+        );
+
+        vk::FenceCreateInfo fence_info;
+        fence_info.flags = vk::FenceCreateFlagBits::eSignaled;
+        update_fences_.resize(max_frames_processing_);
+        for(int i = 0; i < max_frames_processing_; i++) {
+            update_fences_[i] = logical_->createFenceUnique(fence_info);
+        }
+
+        // One region per frame, the buffer never grows past this
+        update_staging_ = std::make_unique<RenderBuffer>(
+            update_size_ * max_frames_processing_, 
             logical_.get(), 
             *physical_, 
             vk::BufferUsageFlagBits::eTransferSrc,
             vk::MemoryPropertyFlagBits::eHostVisible | 
-            vk::MemoryPropertyFlagBits::eHostCoherent |
-            vk::MemoryPropertyFlagBits::eHostCached,
+            vk::MemoryPropertyFlagBits::eHostCoherent,
             transfer_commands_.get(),
             transfer_pool_.get(), 
             transfer_queue_
         );
-        staging_buffer_->suballoc(buffer_size_);
+        for(int i = 0; i < max_frames_processing_; i++) {
+            update_staging_->suballoc(update_size_);
+        }
+        update_frame_ = 0;
+        updating_ = false;
     }
 
-    // Create a sampler for loaded textures
-    void create_texture_sampler() {
-        vk::SamplerCreateInfo sampler_info;
-        sampler_info.magFilter = vk::Filter::eLinear;
-        sampler_info.minFilter = vk::Filter::eLinear;
-        sampler_info.mipmapMode = vk::SamplerMipmapMode::eLinear;
+    // Create the fixed staging window for texture loads
+    void create_texture_staging() {
+        vk::FenceCreateInfo fence_info;
+        fence_info.flags = vk::FenceCreateFlagBits::eSignaled;
+        upload_fences_.resize(2);
+        for(auto &fence : upload_fences_) {
+            fence = logical_->createFenceUnique(fence_info);
+        }
+
+        upload_staging_ = std::make_unique<RenderBuffer>(
+            upload_size_ * 2, 
+            logical_.get(), 
+            *physical_, 
+            vk::BufferUsageFlagBits::eTransferSrc,
+            vk::MemoryPropertyFlagBits::eHostVisible | 
+            vk::MemoryPropertyFlagBits::eHostCoherent,
+            transfer_commands_.get(),
+            transfer_pool_.get(), 
+            transfer_queue_
+        );
+        upload_staging_->suballoc(upload_size_);
+        upload_staging_->suballoc(upload_size_);
+    }
 
-        sampler_info.addressModeU = vk::SamplerAddressMode::eRepeat;
-        sampler_info.addressModeV = vk::SamplerAddressMode::eRepeat;
-        sampler_info.addressModeW = vk::SamplerAddressMode::eRepeat;
+    // Create the compute mip generator
+    void create_mip_generator() {
+        vk::CommandPoolCreateInfo compute_pool_info;
+        compute_pool_info.queueFamilyIndex = queues_.compute.index;
+        compute_pool_ = logical_->createCommandPoolUnique(compute_pool_info);
 
-        sampler_info.mipLodBias = 0.0f;
-        
-        sampler_info.anisotropyEnable = true;
-        sampler_info.maxAnisotropy = physical_->get_limits().maxSamplerAnisotropy;
+        // Signals between copying, generating and acquiring the textures
+        vk::SemaphoreCreateInfo semaphore_info;
+        mip_signals_.resize(2);
+        for(auto &signal : mip_signals_) {
+            signal = logical_->createSemaphoreUnique(semaphore_info);
+        }
+
+        mip_counters_ = std::make_unique<RenderBuffer>(
+            MIPGEN_COUNTERS * sizeof(uint32_t), 
+            logical_.get(), 
+            *physical_, 
+            vk::BufferUsageFlagBits::eStorageBuffer,
+            vk::MemoryPropertyFlagBits::eHostVisible | 
+            vk::MemoryPropertyFlagBits::eHostCoherent,
+            transfer_commands_.get(),
+            transfer_pool_.get(), 
+            transfer_queue_
+        );
+        mip_counters_->suballoc(MIPGEN_COUNTERS * sizeof(uint32_t));
 
-        sampler_info.compareEnable = false;
-        sampler_info.compareOp = vk::CompareOp::eAlways;
+        mip_generator_ = std::make_unique<MipGenerator>(
+            logical_.get(),
+            *physical_,
+            *pipeline_cache_,
+            *mip_counters_,
+            queues_.graphics.index,
+            queues_.compute.index,
+            "mipgen.comp.spv"
+        );
+        compute_mipmaps_ = false;
+    }
 
-        sampler_info.minLod = 0.0f;
-        sampler_info.maxLod = static_cast<float>(mip_levels_);
-        
-        sampler_info.borderColor = vk::BorderColor::eIntOpaqueBlack;
-        sampler_info.unnormalizedCoordinates = false;
+    // Wait for the last batch of mips generated on the async compute
+    // queue, then free the resources it used
+    void finish_compute_mipmaps() {
+        if(mip_fence_) {
+            vk::Result result = logical_->waitForFences(
+                mip_fence_.get(),
+                true,
+                UINT64_MAX
+            );
+            mip_fence_.reset();
+        }
+        mip_commands_.clear();
+        mip_generator_->reset();
+    }
+
+    // Generate the mips of textures on the async compute queue after
+    // their base levels are copied, then hand them back to graphics
+    // Neither queue is waited on, the graphics queue takes the textures
+    // back before any later work samples them
+    void generate_compute_mipmaps(std::vector<TextureData *> &textures) {
+        vk::CommandBufferAllocateInfo cmd_alloc_info;
+        cmd_alloc_info.commandPool = compute_pool_.get();
+        cmd_alloc_info.level = vk::CommandBufferLevel::ePrimary;
+        cmd_alloc_info.commandBufferCount = 1;
+        vk::UniqueCommandBuffer compute_commands = std::move(
+            logical_->allocateCommandBuffersUnique(cmd_alloc_info)[0]
+        );
+
+        vk::CommandBufferBeginInfo cmd_begin_info;
+        cmd_begin_info.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+        compute_commands->begin(cmd_begin_info);
+        for(TextureData *texture : textures) {
+            mip_generator_->record_generate(compute_commands.get(), *texture);
+        }
+        compute_commands->end();
+
+        vk::PipelineStageFlags compute_stage = vk::PipelineStageFlagBits::eComputeShader;
+        vk::SubmitInfo compute_submit_info;
+        compute_submit_info.waitSemaphoreCount = 1;
+        compute_submit_info.pWaitSemaphores = &mip_signals_[0].get();
+        compute_submit_info.pWaitDstStageMask = &compute_stage;
+        compute_submit_info.commandBufferCount = 1;
+        compute_submit_info.pCommandBuffers = &compute_commands.get();
+        compute_submit_info.signalSemaphoreCount = 1;
+        compute_submit_info.pSignalSemaphores = &mip_signals_[1].get();
+        compute_queue_.submit(compute_submit_info, nullptr);
+
+        vk::UniqueCommandBuffer graphics_commands = begin_one_time_commands();
+        for(TextureData *texture : textures) {
+            mip_generator_->record_acquire(graphics_commands.get(), *texture);
+        }
+        graphics_commands->end();
+
+        vk::PipelineStageFlags graphics_stage = vk::PipelineStageFlagBits::eAllCommands;
+        vk::SubmitInfo graphics_submit_info;
+        graphics_submit_info.waitSemaphoreCount = 1;
+        graphics_submit_info.pWaitSemaphores = &mip_signals_[1].get();
+        graphics_submit_info.pWaitDstStageMask = &graphics_stage;
+        graphics_submit_info.commandBufferCount = 1;
+        graphics_submit_info.pCommandBuffers = &graphics_commands.get();
+
+        mip_fence_ = logical_->createFenceUnique(vk::FenceCreateInfo());
+        graphics_queue_.submit(graphics_submit_info, mip_fence_.get());
+        mip_commands_.push_back(std::move(compute_commands));
+        mip_commands_.push_back(std::move(graphics_commands));
+    }
+
+    // Get the command buffer recording this frame's texture updates
+    // Recording begins once the region's previous updates have finished
+    vk::CommandBuffer get_update_commands() {
+        if(!updating_) {
+            vk::Result result = logical_->waitForFences(
+                update_fences_[update_frame_].get(),
+                true,
+                UINT64_MAX
+            );
+            update_staging_->clear(update_frame_);
+
+            vk::CommandBufferBeginInfo begin_info;
+            begin_info.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+            update_commands_[update_frame_]->begin(begin_info);
+            updating_ = true;
+        }
+        return update_commands_[update_frame_].get();
+    }
+
+    // Submit the recorded texture updates and move on to the next region
+    // Submission order on the graphics queue keeps them ahead of the
+    // frame that samples the updated texels
+    void submit_texture_updates() {
+        if(!updating_) {
+            return;
+        }
+        update_commands_[update_frame_]->end();
+        logical_->resetFences(update_fences_[update_frame_].get());
+
+        vk::SubmitInfo submit_info;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &update_commands_[update_frame_].get();
+        graphics_queue_.submit(submit_info, update_fences_[update_frame_].get());
+
+        updating_ = false;
+        update_frame_++;
+        update_frame_ %= max_frames_processing_;
+    }
+
+    // Stage elements in the staging ring and record copying them out
+    // The elements are split into runs that fit the remaining space,
+    // moving on to the next region when this one is full
+    // record is called with the command buffer, the staged offset and
+    // the first element and count of each run
+    void stage_elements(const void *data, size_t element_size, uint32_t count,
+                        const std::function<void(vk::CommandBuffer, size_t, uint32_t, uint32_t)> &record) {
+        if(element_size > update_size_) {
+            throw std::runtime_error("Staged elements exceed the staging ring.");
+        }
+        const char *bytes = static_cast<const char *>(data);
+        uint32_t first = 0;
+        while(first < count) {
+            vk::CommandBuffer command_buffer = get_update_commands();
+            size_t available = update_staging_->get_subsize(update_frame_) - 
+                               update_staging_->get_subfill(update_frame_);
+            uint32_t elements = std::min<size_t>(count - first, available / element_size);
+            if(!elements) {
+                submit_texture_updates();
+                continue;
+            }
+
+            size_t offset = update_staging_->get_offset(update_frame_) + 
+                            update_staging_->reserve(update_frame_, round_up(elements * element_size, 4));
+            std::memcpy(
+                update_staging_->get_mapped() + offset,
+                bytes + first * element_size,
+                elements * element_size
+            );
+            record(command_buffer, offset, first, elements);
+            first += elements;
+        }
+    }
+
+    // Create the cache of samplers for loaded textures
+    void create_sampler_cache() {
+        samplers_ = std::make_unique<SamplerCache>(
+            logical_.get(), 
+            *physical_
+        );
+    }
+
+    // Get the sampler of a texture
+    // The maximum LOD always covers the texture's full mip chain
+    vk::Sampler get_texture_sampler(Texture texture) {
+        SamplerSettings settings = texture_samplers_[texture];
+        settings.max_lod = static_cast<float>(textures_[texture]->get_mip_levels());
+        return samplers_->get(settings);
+    }
 
-        texture_sampler_ = logical_->createSamplerUnique(sampler_info);
+    // Register a new texture and return its handle
+    // The descriptor sets hold as many textures as a stage can sample
+    Texture add_texture(std::unique_ptr<TextureData> texture, 
+                        const SamplerSettings &sampler) {
+        if(textures_.size() == physical_->get_limits().maxPerStageDescriptorSamplers) {
+            throw std::runtime_error("Too many textures for the descriptor sets.");
+        }
+        textures_.push_back(std::move(texture));
+        texture_samplers_.push_back(sampler);
+        return textures_.size() - 1;
     }
 
     vk::Format get_depth_format() {
@@ -762,7 +1463,9 @@ class Core {
             vk::Format::eD24UnormS8Uint
         };
         vk::ImageTiling tiling = vk::ImageTiling::eOptimal;
-        vk::FormatFeatureFlags feature_flags = vk::FormatFeatureFlagBits::eDepthStencilAttachment;
+        // The depth pyramid samples the depth buffer
+        vk::FormatFeatureFlags feature_flags = vk::FormatFeatureFlagBits::eDepthStencilAttachment |
+                                               vk::FormatFeatureFlagBits::eSampledImage;
 
         // Get an available format of the image
         vk::Format depth_image_format;
@@ -781,34 +1484,13 @@ class Core {
         throw std::runtime_error("Could not find a suitable format for the depth buffer.");
     }
 
-    // Create the depth buffer
-    void create_depth_buffer() {
-        auto supported = physical_->get_swapchain_support();
-        auto extent2D = get_swapchain_extent(supported.capabilities);
-        depth_image_ = create_image(
-            logical_.get(),
-            extent2D.width,
-            extent2D.height,
-            1,
-            get_depth_format(),
-            vk::ImageTiling::eOptimal,
-            vk::ImageUsageFlagBits::eDepthStencilAttachment,
-            msaa_samples_
-        );
-        depth_memory_handle_ = image_memory_->allocate_memory(depth_image_.get());
-
-        depth_view_ = create_view(
-            logical_.get(),
-            depth_image_.get(),
-            get_depth_format(),
-            vk::ImageAspectFlagBits::eDepth,
-            1
-        );
-    }
-
     vk::SampleCountFlagBits get_sample_count() {
         auto &limits = physical_->get_limits();
         vk::SampleCountFlags counts = limits.framebufferColorSampleCounts;
+
+        // The depth buffer shares the sample count and is sampled
+        counts &= limits.framebufferDepthSampleCounts;
+        counts &= limits.sampledImageDepthSampleCounts;
         
         // Get the maximum available sample count for improved visuals
         if (counts & vk::SampleCountFlagBits::e64) return vk::SampleCountFlagBits::e64;
@@ -820,95 +1502,457 @@ class Core {
         return vk::SampleCountFlagBits::e1;
     }
 
-    // Create the multisampling color buffer
-    void create_color_buffer() {
-        auto supported = physical_->get_swapchain_support();
-        auto extent2D = get_swapchain_extent(supported.capabilities);
-        color_image_ = create_image(
-            logical_.get(),
-            extent2D.width,
-            extent2D.height,
-            1,
-            image_format_,
-            vk::ImageTiling::eOptimal,
-            vk::ImageUsageFlagBits::eColorAttachment,
-            msaa_samples_
-        );
-        color_memory_handle_ = image_memory_->allocate_memory(color_image_.get());
-        
-        color_view_ = create_view(
-            logical_.get(),
-            color_image_.get(),
-            image_format_,
-            vk::ImageAspectFlagBits::eColor,
-            1
-        );
-    }
-
-    // Create the object buffer
-    void create_object_buffer() {
-        auto usage = vk::BufferUsageFlagBits::eIndexBuffer |
-                     vk::BufferUsageFlagBits::eVertexBuffer;
-        object_buffer_ = std::make_unique<RenderBuffer>(
-            buffer_size_, 
+    // Create the geometry buffer
+    void create_geometry_buffer() {
+        geometry_ = std::make_unique<GeometryBuffer>(
             logical_.get(), 
             *physical_,
-            usage, 
-            vk::MemoryPropertyFlagBits::eDeviceLocal,
-            transfer_commands_.get(), 
-            transfer_pool_.get(), 
-            transfer_queue_
+            buffer_size_ / sizeof(Vertex),
+            buffer_size_ / sizeof(uint32_t)
         );
     }
 
-    // Create a uniform buffer per swapchain image
-    // This is where we store global data that is passed to all shaders
-    // E.g., camera matrix, mouse pointer location, screen size, etc.
-    void create_uniform_buffer() {
-        uniform_buffer_ = std::make_unique<RenderBuffer>(
-            buffer_size_, 
+    // Grow the geometry buffer to fit a mesh
+    // Pending uploads are submitted first, since they copy into the 
+    // old buffers, and all frames in flight must finish reading them
+    void grow_geometry_buffer(uint32_t vertex_count, uint32_t index_count) {
+        submit_texture_updates();
+        wait_frames();
+
+        vk::UniqueCommandBuffer command_buffer = begin_one_time_commands();
+        geometry_->grow(command_buffer.get(), vertex_count, index_count);
+        submit_one_time_commands(command_buffer);
+        geometry_->release();
+
+        // Every recorded draw binds the old buffers
+        invalidate_commands();
+    }
+
+    // Create a host visible buffer read by a swapchain image's frame
+    std::unique_ptr<RenderBuffer> create_draw_buffer(size_t size, vk::BufferUsageFlags usage) {
+        return std::make_unique<RenderBuffer>(
+            size,
             logical_.get(), 
             *physical_, 
-            vk::BufferUsageFlagBits::eUniformBuffer,
+            usage,
             vk::MemoryPropertyFlagBits::eHostVisible |
-            vk::MemoryPropertyFlagBits::eHostCoherent |
-            vk::MemoryPropertyFlagBits::eHostCached,
+            vk::MemoryPropertyFlagBits::eHostCoherent,
             transfer_commands_.get(), 
             transfer_pool_.get(), 
             transfer_queue_
         );
+    }
 
-        // Ensure buffer offsets fit alignment requirements
-        size_t size = round_up(
-            sizeof(UniformBufferObject),
-            physical_->get_limits().minUniformBufferOffsetAlignment
+    // Create a swapchain image's copies of the indirect draw records and
+    // instance data for the current capacities, and fill them
+    // Its frame must have finished
+    void create_draw_buffers(uint32_t image_index) {
+        DrawBuffers &buffers = draw_buffers_[image_index];
+        buffers.draw_capacity = draw_capacity_;
+        buffers.instance_capacity = instances_->get_capacity();
+
+        // Each half of the culled buffer is bound at its own offset
+        size_t record_size = round_up(
+            sizeof(vk::DrawIndexedIndirectCommand) * (draw_capacity_ + 1),
+            physical_->get_limits().minStorageBufferOffsetAlignment
         );
-        for(int i = 0; i < images_.size(); i++) {
-            uniform_buffer_->suballoc(size);
+        buffers.records = create_draw_buffer(
+            record_size,
+            vk::BufferUsageFlagBits::eIndirectBuffer |
+            vk::BufferUsageFlagBits::eStorageBuffer
+        );
+        buffers.culled = create_draw_buffer(
+            record_size * 2,
+            vk::BufferUsageFlagBits::eIndirectBuffer |
+            vk::BufferUsageFlagBits::eStorageBuffer |
+            vk::BufferUsageFlagBits::eTransferDst
+        );
+        buffers.objects = create_draw_buffer(
+            sizeof(ObjectData) * instances_->get_capacity(),
+            vk::BufferUsageFlagBits::eStorageBuffer
+        );
+        buffers.indices = create_draw_buffer(
+            sizeof(uint32_t) * instances_->get_capacity(),
+            vk::BufferUsageFlagBits::eStorageBuffer
+        );
+        buffers.visibility = create_draw_buffer(
+            sizeof(uint32_t) * instances_->get_capacity(),
+            vk::BufferUsageFlagBits::eStorageBuffer
+        );
+
+        object_ranges_[image_index] = {0, instance_objects_.size()};
+        cpu_culled_images_[image_index] = false;
+        gpu_cull_pending_[image_index] = false;
+        write_draw_records(image_index);
+        write_object_data(image_index);
+        write_instance_indices(image_index);
+    }
+
+    // Create the draw buffers of every swapchain image
+    void create_draw_buffers() {
+        draw_buffers_.resize(images_.size());
+        draw_versions_.resize(images_.size());
+        object_ranges_.resize(images_.size());
+        cpu_culled_images_.resize(images_.size());
+        gpu_cull_pending_.resize(images_.size());
+        for(uint32_t i = 0; i < images_.size(); i++) {
+            create_draw_buffers(i);
         }
     }
 
-    // Create the pool that manages all descriptor sets
-    void create_descriptor_pool() {
-        // Size of the UBO descriptors
-        vk::DescriptorPoolSize ubo_pool_size;
-        ubo_pool_size.type = vk::DescriptorType::eUniformBuffer;
-        ubo_pool_size.descriptorCount = images_.size();
+    // Recreate a swapchain image's draw buffers if either capacity grew
+    // since they were created, and point its descriptor sets at them
+    // Its frame must have finished, the other frames in flight keep
+    // reading their own buffers
+    void grow_draw_buffers(uint32_t image_index) {
+        DrawBuffers &buffers = draw_buffers_[image_index];
+        if(buffers.draw_capacity == draw_capacity_ && 
+           buffers.instance_capacity == instances_->get_capacity()) {
+            return;
+        }
+        create_draw_buffers(image_index);
+        write_descriptor_set(image_index);
+        write_cull_buffers(image_index);
 
-        // Size of the sampler descriptors
-        uint32_t max_samplers = physical_->get_limits().maxPerStageDescriptorSamplers;
-        vk::DescriptorPoolSize sampler_pool_size;
-        sampler_pool_size.type = vk::DescriptorType::eCombinedImageSampler;
-        sampler_pool_size.descriptorCount = images_.size() * max_samplers;
+        // The image's commands bind the old buffers
+        recorder_->invalidate_image(image_index);
+        commands_dirty_[image_index] = true;
+    }
 
-        // Create the descriptor pool
-        std::vector<vk::DescriptorPoolSize> pool_sizes = {
-            ubo_pool_size, 
-            sampler_pool_size
-        };
-        vk::DescriptorPoolCreateInfo pool_info;
-        pool_info.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
-        pool_info.maxSets = images_.size();
+    // Reset a swapchain image's instance indices to the identity
+    void write_instance_indices(uint32_t image_index) {
+        uint32_t *indices = reinterpret_cast<uint32_t *>(
+            draw_buffers_[image_index].indices->get_mapped()
+        );
+        for(uint32_t slot = 0; slot < instances_->get_capacity(); slot++) {
+            indices[slot] = slot;
+        }
+    }
+
+    // Cull the instances against the view frustum, then write a 
+    // swapchain image's draw records and instance indices so that 
+    // each draw group only draws its visible instances
+    void cull_draws(uint32_t image_index) {
+        auto start = std::chrono::high_resolution_clock::now();
+        culler_->cull(extract_frustum(view_projection_), instances_->get_capacity());
+
+        uint32_t *indices = reinterpret_cast<uint32_t *>(
+            draw_buffers_[image_index].indices->get_mapped()
+        );
+        char *commands = draw_buffers_[image_index].records->get_mapped();
+        uint32_t count = draw_commands_.size();
+        std::memcpy(commands, &count, sizeof(count));
+
+        // Compact the visible instances to the start of each group
+        count_cull_totals();
+        cull_stats_.visible = 0;
+        cull_stats_.visible_triangles = 0;
+        cull_stats_.disoccluded = 0;
+        for(uint32_t slot = 0; slot < count; slot++) {
+            const DrawGroupData &group = group_data_[draw_groups_[slot]];
+            uint32_t visible = 0;
+            for(uint32_t i = 0; i < group.models.size(); i++) {
+                uint32_t instance = group.first_instance + i;
+                if(culler_->is_visible(instance)) {
+                    indices[group.first_instance + visible++] = instance;
+                }
+            }
+            vk::DrawIndexedIndirectCommand command = draw_commands_[slot];
+            command.instanceCount = visible;
+            std::memcpy(
+                commands + (slot + 1) * sizeof(vk::DrawIndexedIndirectCommand),
+                &command,
+                sizeof(command)
+            );
+            cull_stats_.visible += visible;
+            cull_stats_.visible_triangles += visible * (command.indexCount / 3);
+        }
+        draw_versions_[image_index] = draw_version_;
+        cpu_culled_images_[image_index] = true;
+
+        cull_stats_.cull_ms = std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - start
+        ).count();
+    }
+
+    // Set the world space bounding sphere of an instance
+    // The radius grows with the largest scale of the transform
+    void update_bounds(uint32_t instance, const glm::mat4 &transform, const MeshData &mesh) {
+        float scale = std::max(
+            glm::length(glm::vec3(transform[0])),
+            std::max(
+                glm::length(glm::vec3(transform[1])),
+                glm::length(glm::vec3(transform[2]))
+            )
+        );
+        glm::vec3 center(transform * glm::vec4(mesh.center, 1.0f));
+        culler_->set_sphere(instance, center, mesh.radius * scale);
+        instance_objects_[instance].sphere = glm::vec4(center, mesh.radius * scale);
+    }
+
+    // Copy the draw records to a swapchain image's buffer
+    // The draw count comes first, followed by the draw commands
+    void write_draw_records(uint32_t image_index) {
+        char *commands = draw_buffers_[image_index].records->get_mapped();
+        uint32_t count = draw_commands_.size();
+        std::memcpy(commands, &count, sizeof(count));
+        std::memcpy(
+            commands + sizeof(vk::DrawIndexedIndirectCommand), 
+            draw_commands_.data(), 
+            count * sizeof(vk::DrawIndexedIndirectCommand)
+        );
+        draw_versions_[image_index] = draw_version_;
+    }
+
+    // Copy the changed range of instance data to a swapchain image's 
+    // buffer with a single copy
+    void write_object_data(uint32_t image_index) {
+        auto &range = object_ranges_[image_index];
+        if(range.first >= range.second) {
+            return;
+        }
+        std::memcpy(
+            draw_buffers_[image_index].objects->get_mapped() + 
+            range.first * sizeof(ObjectData),
+            instance_objects_.data() + range.first,
+            (range.second - range.first) * sizeof(ObjectData)
+        );
+        range = {UINT32_MAX, 0};
+    }
+
+    // Mark a range of instance slots as changed for every image
+    void changed_objects(uint32_t first, uint32_t count) {
+        for(auto &range : object_ranges_) {
+            range.first = std::min(range.first, first);
+            range.second = std::max(range.second, first + count);
+        }
+    }
+
+    // Get the draw group of a mesh, texture and pipeline, creating it
+    // if needed
+    DrawGroup get_draw_group(MeshHandle mesh, Texture texture, PipelineVariant pipeline) {
+        auto it = group_keys_.find({mesh, texture, pipeline});
+        if(it != group_keys_.end()) {
+            return it->second;
+        }
+        DrawGroup group = group_id_++;
+        group_data_[group].mesh = mesh;
+        group_data_[group].texture = texture;
+        group_data_[group].pipeline = pipeline;
+        group_keys_[{mesh, texture, pipeline}] = group;
+        recorder_->add(group);
+        add_draw_record(group);
+        return group;
+    }
+
+    // Remove an empty draw group
+    void remove_draw_group(DrawGroup group) {
+        DrawGroupData &data = group_data_[group];
+        instances_->free(data.first_instance, data.capacity);
+        recorder_->remove(group);
+        remove_draw_record(group);
+        group_keys_.erase({data.mesh, data.texture, data.pipeline});
+        group_data_.erase(group);
+    }
+
+    // Make room for one more instance in a draw group
+    // Full groups move to a range twice as large, and the instance 
+    // buffers double in size when no such range is free
+    // Each image's draw buffers grow when it is next acquired
+    void reserve_instance(DrawGroup group) {
+        DrawGroupData &data = group_data_[group];
+        if(data.models.size() < data.capacity) {
+            return;
+        }
+        uint32_t capacity = std::max(1u, data.capacity * 2);
+        uint32_t first_instance;
+        if(!instances_->allocate(capacity, first_instance)) {
+            instances_->grow(instances_->get_capacity() * 2 + capacity);
+            instances_->allocate(capacity, first_instance);
+            instance_objects_.resize(instances_->get_capacity());
+            culler_->resize(instances_->get_capacity());
+        }
+        std::copy(
+            instance_objects_.begin() + data.first_instance,
+            instance_objects_.begin() + data.first_instance + data.models.size(),
+            instance_objects_.begin() + first_instance
+        );
+        for(uint32_t i = 0; i < data.models.size(); i++) {
+            culler_->copy_sphere(data.first_instance + i, first_instance + i);
+        }
+        changed_objects(first_instance, data.models.size());
+        instances_->free(data.first_instance, data.capacity);
+        data.first_instance = first_instance;
+        data.capacity = capacity;
+    }
+
+    // Add a model as the last instance of a draw group
+    void add_instance(DrawGroup group, Model model) {
+        reserve_instance(group);
+        DrawGroupData &data = group_data_[group];
+        uint32_t instance = data.models.size();
+        instance_objects_[data.first_instance + instance] = {
+            glm::mat4(1.0f), glm::vec4(0.0f), data.texture
+        };
+        changed_objects(data.first_instance + instance, 1);
+        update_bounds(data.first_instance + instance, glm::mat4(1.0f), mesh_data_[data.mesh]);
+        data.models.push_back(model);
+        model_data_[model] = {group, instance};
+
+        // Only the group's own batch records its instance count
+        recorder_->invalidate(group);
+        update_draw_record(group);
+    }
+
+    // Remove a model from its draw group
+    // The group's last instance takes its place
+    void remove_instance(Model model) {
+        ModelData model_data = model_data_[model];
+        DrawGroupData &data = group_data_[model_data.group];
+        uint32_t last = data.models.size() - 1;
+        instance_objects_[data.first_instance + model_data.instance] = 
+            instance_objects_[data.first_instance + last];
+        changed_objects(data.first_instance + model_data.instance, 1);
+        culler_->copy_sphere(
+            data.first_instance + last, 
+            data.first_instance + model_data.instance
+        );
+        data.models[model_data.instance] = data.models[last];
+        model_data_[data.models[model_data.instance]].instance = model_data.instance;
+        data.models.pop_back();
+        model_data_.erase(model);
+
+        if(data.models.empty()) {
+            remove_draw_group(model_data.group);
+        }
+        else {
+            recorder_->invalidate(model_data.group);
+            update_draw_record(model_data.group);
+        }
+    }
+
+    // Append the indirect draw record of a draw group
+    // The draw buffers double in size when they are full, each image's
+    // when it is next acquired
+    void add_draw_record(DrawGroup group) {
+        if(draw_commands_.size() == draw_capacity_) {
+            draw_capacity_ *= 2;
+        }
+        draw_slots_[group] = draw_commands_.size();
+        draw_commands_.emplace_back();
+        draw_groups_.push_back(group);
+        update_draw_record(group);
+        changed_draw_records();
+    }
+
+    // Rewrite the indirect draw record of a draw group
+    // The vertex shader finds each instance's object data from its 
+    // instance index, which starts at the group's first instance
+    void update_draw_record(DrawGroup group) {
+        DrawGroupData &data = group_data_[group];
+        GeometryRange &geometry = mesh_data_[data.mesh].geometry;
+        vk::DrawIndexedIndirectCommand &command = draw_commands_[draw_slots_[group]];
+        command.indexCount = geometry.index_count;
+        command.instanceCount = data.models.size();
+        command.firstIndex = geometry.first_index;
+        command.vertexOffset = geometry.first_vertex;
+        command.firstInstance = data.first_instance;
+        draw_version_++;
+    }
+
+    // Remove the indirect draw record of a draw group
+    // The last record takes its place
+    void remove_draw_record(DrawGroup group) {
+        uint32_t slot = draw_slots_[group];
+        uint32_t last = draw_commands_.size() - 1;
+        draw_commands_[slot] = draw_commands_[last];
+        draw_groups_[slot] = draw_groups_[last];
+        draw_slots_[draw_groups_[slot]] = slot;
+
+        draw_commands_.pop_back();
+        draw_groups_.pop_back();
+        draw_slots_.erase(group);
+        changed_draw_records();
+    }
+
+    // Mark the number of draw records as changed
+    // Without a draw count buffer, the count is recorded in the commands
+    void changed_draw_records() {
+        draw_version_++;
+        if(indirect_ && !indirect_count_) {
+            invalidate_primaries();
+        }
+    }
+
+    // Mark the primary command buffers of all images as changed
+    void invalidate_primaries() {
+        std::fill(commands_dirty_.begin(), commands_dirty_.end(), true);
+    }
+
+    // Mark all command buffers as changed
+    void invalidate_commands() {
+        recorder_->invalidate_all();
+        invalidate_primaries();
+    }
+
+    // Create a uniform buffer per swapchain image
+    // This is where we store global data that is passed to all shaders
+    // E.g., camera matrix, mouse pointer location, screen size, etc.
+    void create_uniform_buffer() {
+        uniform_buffer_ = std::make_unique<RenderBuffer>(
+            buffer_size_, 
+            logical_.get(), 
+            *physical_, 
+            vk::BufferUsageFlagBits::eUniformBuffer,
+            vk::MemoryPropertyFlagBits::eHostVisible |
+            vk::MemoryPropertyFlagBits::eHostCoherent |
+            vk::MemoryPropertyFlagBits::eHostCached,
+            transfer_commands_.get(), 
+            transfer_pool_.get(), 
+            transfer_queue_
+        );
+
+        // Ensure buffer offsets fit alignment requirements
+        size_t size = round_up(
+            sizeof(UniformBufferObject),
+            physical_->get_limits().minUniformBufferOffsetAlignment
+        );
+        for(int i = 0; i < images_.size(); i++) {
+            uniform_buffer_->suballoc(size);
+        }
+    }
+
+    // Create the pool that manages all descriptor sets
+    void create_descriptor_pool() {
+        // Size of the UBO descriptors
+        vk::DescriptorPoolSize ubo_pool_size;
+        ubo_pool_size.type = vk::DescriptorType::eUniformBuffer;
+        ubo_pool_size.descriptorCount = images_.size();
+
+        // Size of the sampler descriptors
+        uint32_t max_samplers = physical_->get_limits().maxPerStageDescriptorSamplers;
+        vk::DescriptorPoolSize sampler_pool_size;
+        sampler_pool_size.type = vk::DescriptorType::eCombinedImageSampler;
+        sampler_pool_size.descriptorCount = images_.size() * max_samplers;
+
+        // Size of the page table, feedback, object data and instance 
+        // index descriptors
+        vk::DescriptorPoolSize storage_pool_size;
+        storage_pool_size.type = vk::DescriptorType::eStorageBuffer;
+        storage_pool_size.descriptorCount = images_.size() * 4;
+
+        // Create the descriptor pool
+        std::vector<vk::DescriptorPoolSize> pool_sizes = {
+            ubo_pool_size, 
+            storage_pool_size,
+            sampler_pool_size
+        };
+        vk::DescriptorPoolCreateInfo pool_info;
+        pool_info.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
+        if(update_after_bind_) {
+            pool_info.flags |= vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind;
+        }
+        pool_info.maxSets = images_.size();
         pool_info.poolSizeCount = pool_sizes.size();
         pool_info.pPoolSizes = &pool_sizes[0];
 
@@ -919,10 +1963,18 @@ class Core {
 
     // Create the descriptor sets and map them to the UBOs
     // Descriptor sets can be accessed by a particular shader stage
+    // The texture array has room for as many textures as a stage can
+    // sample, so the sets never need reallocating as textures are added
     void allocate_descriptor_sets() {
         // Reset the pool
         descriptor_sets_.clear();
 
+        // New sets point at the current views, so no frame samples the
+        // replaced ones any more
+        texture_writes_.assign(images_.size(), {});
+        texture_counts_.assign(images_.size(), 0);
+        retired_textures_.clear();
+
         // Allocate new descriptor sets within the pool
         std::vector<vk::DescriptorSetLayout> layouts(
             images_.size(), descriptor_layout_.get()
@@ -933,7 +1985,10 @@ class Core {
         descriptor_alloc_info.pSetLayouts = &layouts[0];
 
         // How many descriptors do we need for each variable sized set?
-        std::vector<uint32_t> descriptor_counts(images_.size(), textures_.size());
+        std::vector<uint32_t> descriptor_counts(
+            images_.size(), 
+            physical_->get_limits().maxPerStageDescriptorSamplers
+        );
 
         vk::DescriptorSetVariableDescriptorCountAllocateInfo var_descriptor_alloc_info;
         var_descriptor_alloc_info.descriptorSetCount = images_.size();
@@ -947,145 +2002,352 @@ class Core {
 
     // Update where the descriptor sets read from
     void write_descriptor_sets() {
-        // Map each UBO and texture to a descriptor set
-        for(int i = 0; i < uniform_buffer_->get_subbuffer_count(); i++) {
-            // Uniform buffer descriptor set
-            vk::DescriptorBufferInfo ubo_buffer_info;
-            ubo_buffer_info.buffer = uniform_buffer_->get_handle();
-            ubo_buffer_info.offset = uniform_buffer_->get_offset(i);
-            ubo_buffer_info.range = sizeof(UniformBufferObject);
-
-            vk::WriteDescriptorSet ubo_descriptor_write;
-            ubo_descriptor_write.dstSet = descriptor_sets_[i].get();
-            ubo_descriptor_write.dstBinding = 0;
-            ubo_descriptor_write.dstArrayElement = 0;
-            ubo_descriptor_write.descriptorCount = 1;
-            ubo_descriptor_write.descriptorType = vk::DescriptorType::eUniformBuffer;
-            ubo_descriptor_write.pBufferInfo = &ubo_buffer_info;
-
-
-            // Image sampler descriptor set
-            std::vector<vk::DescriptorImageInfo> image_infos;
-            for(auto &texture : textures_) {
-                vk::DescriptorImageInfo image_info;
-                image_info.sampler = texture_sampler_.get();
-                image_info.imageView = texture->get_view();
-                image_info.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
-
-                image_infos.push_back(image_info);
-            }
-
-            vk::WriteDescriptorSet texture_descriptor_write;
-            texture_descriptor_write.dstSet = descriptor_sets_[i].get();
-            texture_descriptor_write.dstBinding = 1;
-            texture_descriptor_write.dstArrayElement = 0;
-            texture_descriptor_write.descriptorCount = static_cast<uint32_t>(textures_.size());
-            texture_descriptor_write.descriptorType = vk::DescriptorType::eCombinedImageSampler;
-            texture_descriptor_write.pImageInfo = &image_infos[0];
-
-
-            // Update all descriptor sets
-            std::vector<vk::WriteDescriptorSet> descriptor_writes = {
-                ubo_descriptor_write, 
-                texture_descriptor_write
-            };
-            logical_->updateDescriptorSets(descriptor_writes, nullptr);
+        for(uint32_t i = 0; i < descriptor_sets_.size(); i++) {
+            write_descriptor_set(i);
         }
     }
 
-    // Record the commands for each framebuffer
-    // This can be called whenever image specific stuff changes
-    // But don't call this too frequently for performance
-    void record_commands() {
-        // Wait for all queues using pool before resetting
-        graphics_queue_.waitIdle();
-        logical_->resetCommandPool(
-            graphics_pool_.get(),
-            vk::CommandPoolResetFlagBits::eReleaseResources
-        );
-        std::array<vk::ClearValue, 2> clear_values = {
-            clear_value_, 
-            depth_clear_value_
-        };
+    // Update where a swapchain image's descriptor set reads from
+    // Its frame must have finished
+    void write_descriptor_set(uint32_t i) {
+        // Uniform buffer descriptor set
+        vk::DescriptorBufferInfo ubo_buffer_info;
+        ubo_buffer_info.buffer = uniform_buffer_->get_handle();
+        ubo_buffer_info.offset = uniform_buffer_->get_offset(i);
+        ubo_buffer_info.range = sizeof(UniformBufferObject);
+
+        vk::WriteDescriptorSet ubo_descriptor_write;
+        ubo_descriptor_write.dstSet = descriptor_sets_[i].get();
+        ubo_descriptor_write.dstBinding = 0;
+        ubo_descriptor_write.dstArrayElement = 0;
+        ubo_descriptor_write.descriptorCount = 1;
+        ubo_descriptor_write.descriptorType = vk::DescriptorType::eUniformBuffer;
+        ubo_descriptor_write.pBufferInfo = &ubo_buffer_info;
+
+
+        // Virtual texture page table and feedback descriptor sets
+        vk::DescriptorBufferInfo page_table_buffer_info;
+        page_table_buffer_info.buffer = virtual_tables_[i]->get_handle();
+        page_table_buffer_info.offset = 0;
+        page_table_buffer_info.range = virtual_tables_[i]->get_size();
+
+        vk::WriteDescriptorSet page_table_descriptor_write;
+        page_table_descriptor_write.dstSet = descriptor_sets_[i].get();
+        page_table_descriptor_write.dstBinding = 1;
+        page_table_descriptor_write.dstArrayElement = 0;
+        page_table_descriptor_write.descriptorCount = 1;
+        page_table_descriptor_write.descriptorType = vk::DescriptorType::eStorageBuffer;
+        page_table_descriptor_write.pBufferInfo = &page_table_buffer_info;
+
+        vk::DescriptorBufferInfo feedback_buffer_info;
+        feedback_buffer_info.buffer = virtual_feedback_->get_handle();
+        feedback_buffer_info.offset = virtual_feedback_->get_offset(i);
+        feedback_buffer_info.range = VT_FEEDBACK_SIZE * sizeof(uint32_t);
+
+        vk::WriteDescriptorSet feedback_descriptor_write;
+        feedback_descriptor_write.dstSet = descriptor_sets_[i].get();
+        feedback_descriptor_write.dstBinding = 2;
+        feedback_descriptor_write.dstArrayElement = 0;
+        feedback_descriptor_write.descriptorCount = 1;
+        feedback_descriptor_write.descriptorType = vk::DescriptorType::eStorageBuffer;
+        feedback_descriptor_write.pBufferInfo = &feedback_buffer_info;
+
+
+        // Object data descriptor set
+        vk::DescriptorBufferInfo object_buffer_info;
+        object_buffer_info.buffer = draw_buffers_[i].objects->get_handle();
+        object_buffer_info.offset = 0;
+        object_buffer_info.range = draw_buffers_[i].objects->get_size();
+
+        vk::WriteDescriptorSet object_descriptor_write;
+        object_descriptor_write.dstSet = descriptor_sets_[i].get();
+        object_descriptor_write.dstBinding = 3;
+        object_descriptor_write.dstArrayElement = 0;
+        object_descriptor_write.descriptorCount = 1;
+        object_descriptor_write.descriptorType = vk::DescriptorType::eStorageBuffer;
+        object_descriptor_write.pBufferInfo = &object_buffer_info;
+
+
+        // Instance index descriptor set
+        vk::DescriptorBufferInfo instance_buffer_info;
+        instance_buffer_info.buffer = draw_buffers_[i].indices->get_handle();
+        instance_buffer_info.offset = 0;
+        instance_buffer_info.range = draw_buffers_[i].indices->get_size();
+
+        vk::WriteDescriptorSet instance_descriptor_write;
+        instance_descriptor_write.dstSet = descriptor_sets_[i].get();
+        instance_descriptor_write.dstBinding = 4;
+        instance_descriptor_write.dstArrayElement = 0;
+        instance_descriptor_write.descriptorCount = 1;
+        instance_descriptor_write.descriptorType = vk::DescriptorType::eStorageBuffer;
+        instance_descriptor_write.pBufferInfo = &instance_buffer_info;
+
+
+        // Image sampler descriptor set
+        std::vector<vk::DescriptorImageInfo> image_infos;
+        for(Texture texture = 0; texture < textures_.size(); texture++) {
+            vk::DescriptorImageInfo image_info;
+            image_info.sampler = get_texture_sampler(texture);
+            image_info.imageView = textures_[texture]->get_view();
+            image_info.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+
+            image_infos.push_back(image_info);
+        }
 
-        // Begin recording commands
-        vk::CommandBufferBeginInfo begin_info;
-        for(int i = 0; i < graphics_commands_.size(); i++) {
-            graphics_commands_[i]->begin(begin_info);
-
-            vk::Rect2D render_area;
-            render_area.offset.x = 0;
-            render_area.offset.y = 0;
-            render_area.extent = image_extent_;
-
-            // Start the render pass
-            vk::RenderPassBeginInfo render_begin_info;
-            render_begin_info.renderPass = render_pass_.get();
-            render_begin_info.framebuffer = framebuffers_[i].get();
-            render_begin_info.renderArea = render_area;
-
-            render_begin_info.clearValueCount = clear_values.size();
-            render_begin_info.pClearValues = &clear_values[0];
-
-            graphics_commands_[i]->beginRenderPass(
-                render_begin_info, 
-                vk::SubpassContents::eInline
-            );
+        vk::WriteDescriptorSet texture_descriptor_write;
+        texture_descriptor_write.dstSet = descriptor_sets_[i].get();
+        texture_descriptor_write.dstBinding = 5;
+        texture_descriptor_write.dstArrayElement = 0;
+        texture_descriptor_write.descriptorCount = static_cast<uint32_t>(textures_.size());
+        texture_descriptor_write.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+        texture_descriptor_write.pImageInfo = image_infos.data();
+
+
+        // Update all descriptor sets
+        std::vector<vk::WriteDescriptorSet> descriptor_writes = {
+            ubo_descriptor_write, 
+            page_table_descriptor_write,
+            feedback_descriptor_write,
+            object_descriptor_write,
+            instance_descriptor_write
+        };
+        if(!textures_.empty()) {
+            descriptor_writes.push_back(texture_descriptor_write);
+        }
+        logical_->updateDescriptorSets(descriptor_writes, nullptr);
+        texture_counts_[i] = textures_.size();
+    }
 
-            // Bind the command buffer to the graphics pipeline
-            graphics_commands_[i]->bindPipeline(
-                vk::PipelineBindPoint::eGraphics,
-                pipeline_->get_handle()
+    // Get the sort key of a draw group
+    // Its depth is that of its nearest instance's world space bounds
+    uint64_t get_draw_key(const DrawGroupData &group) {
+        float distance = far_;
+        for(uint32_t i = 0; i < group.models.size(); i++) {
+            const glm::vec4 &sphere = instance_objects_[group.first_instance + i].sphere;
+            distance = std::min(
+                distance, 
+                glm::distance(eye_, glm::vec3(sphere)) - sphere.w
             );
+        }
+        float depth = (distance - near_) / (far_ - near_);
+        return make_sort_key(group.pipeline, group.texture, depth);
+    }
 
-            // Draw each mesh
-            // TODO: Use secondary buffers for multithreaded rendering
-            //       Secondary buffers are hidden from CPU but can be
-            //       called by primary command buffers
-            for(auto &pair : model_data_) {
-                ModelData &model = pair.second;
+    // Sort the draw groups of the whole frame and hand them to the 
+    // recorder in that order
+    // Only the batches whose groups moved are re-recorded
+    void sort_draws() {
+        draw_queue_.clear();
+        for(auto &entry : group_data_) {
+            draw_queue_.push(get_draw_key(entry.second), entry.first);
+        }
+        draw_queue_.sort();
 
-                // Bind the vertex and index sub-buffers to the command queue
-                std::vector<vk::DeviceSize> offsets = {
-                    object_buffer_->get_offset(model.vertexes)
-                };
-                graphics_commands_[i]->bindVertexBuffers(
-                    0, object_buffer_->get_handle(), offsets
-                );
-                graphics_commands_[i]->bindIndexBuffer(
-                    object_buffer_->get_handle(), 
-                    object_buffer_->get_offset(model.indexes), 
-                    vk::IndexType::eUint32
-                );
+        draw_order_.resize(draw_queue_.get_size());
+        for(size_t i = 0; i < draw_queue_.get_size(); i++) {
+            draw_order_[i] = draw_queue_.get_draw(i);
+        }
+        recorder_->order(draw_order_);
+    }
 
-                // Bind desccriptor sets
-                graphics_commands_[i]->bindDescriptorSets(
-                    vk::PipelineBindPoint::eGraphics, pipeline_->get_layout(),
-                    0, descriptor_sets_[i].get(), nullptr
-                );
+    // Record the draws of a batch of draw groups into a secondary buffer
+    // The groups arrive sorted by state, then front to back, and only
+    // what differs from the previous draw is bound
+    // Called from the worker threads, so only reads renderer state
+    StateChanges record_draws(vk::CommandBuffer command_buffer, uint32_t image,
+                              const std::vector<DrawGroup> &groups) {
+        // Bind the geometry buffers and descriptor set once, each mesh
+        // is drawn from its range with firstIndex and vertexOffset
+        StateChanges changes;
+        bind_scene(command_buffer, image);
+        changes.binds += 3;
+
+        // Draw each group's mesh once for all of its instances
+        // Groups whose pipeline variant is still compiling are skipped,
+        // their batches are re-recorded once it is ready
+        uint32_t pipeline = 0;
+        Pipeline *bound = nullptr;
+        bool looked_up = false;
+        Texture pushed = TEXTURE_FROM_OBJECT;
+        for(DrawGroup draw : groups) {
+            const DrawGroupData &group = group_data_.at(draw);
+            const GeometryRange &geometry = mesh_data_.at(group.mesh).geometry;
+
+            // Bind the command buffer to the draw's graphics pipeline
+            if(!looked_up || group.pipeline != pipeline) {
+                pipeline = group.pipeline;
+                bound = variants_->get(pipeline);
+                looked_up = true;
+                if(bound) {
+                    command_buffer.bindPipeline(
+                        vk::PipelineBindPoint::eGraphics,
+                        bound->get_handle()
+                    );
+                    changes.pipelines++;
+                }
+            }
+            if(!bound) {
+                continue;
+            }
 
-                // Send push constant data to shader stages
+            // Send push constant data to shader stages when the texture
+            // differs from the previous group's
+            if(group.texture != pushed) {
                 PushConstantObject push_constant = {
-                    model.texture
+                    group.texture
                 };
-                graphics_commands_[i]->pushConstants(
+                command_buffer.pushConstants(
                     pipeline_->get_layout(), 
                     vk::ShaderStageFlagBits::eVertex,
                     0, 
                     sizeof(push_constant), 
                     &push_constant
                 );
-                    
-                // Draw the mesh
-                graphics_commands_[i]->drawIndexed(
-                    object_buffer_->get_subfill(model.indexes) / sizeof(uint32_t),
-                    1, 0, 0, 0
-                );
+                pushed = group.texture;
+                changes.binds++;
             }
+                
+            // Draw the mesh
+            command_buffer.drawIndexed(
+                geometry.index_count,
+                group.models.size(), 
+                geometry.first_index, 
+                geometry.first_vertex, 
+                group.first_instance
+            );
+        }
+        return changes;
+    }
 
-            // Stop recording
-            graphics_commands_[i]->endRenderPass();
-            graphics_commands_[i]->end();
+    // Bind the geometry buffers and an image's descriptor set, and set
+    // the dynamic state to the swapchain extent
+    // Secondary buffers inherit no dynamic state, so each sets its own
+    void bind_scene(vk::CommandBuffer command_buffer, uint32_t image) {
+        vk::Viewport viewport(
+            0.0f, 0.0f,
+            static_cast<float>(image_extent_.width),
+            static_cast<float>(image_extent_.height),
+            0.0f, 1.0f
+        );
+        vk::Rect2D scissor({0, 0}, image_extent_);
+        command_buffer.setViewport(0, viewport);
+        command_buffer.setScissor(0, scissor);
+        command_buffer.setLineWidth(1.0f);
+
+        std::vector<vk::DeviceSize> offsets = {0};
+        command_buffer.bindVertexBuffers(
+            0, geometry_->get_vertex_buffer(), offsets
+        );
+        command_buffer.bindIndexBuffer(
+            geometry_->get_index_buffer(), 
+            0, 
+            vk::IndexType::eUint32
+        );
+        command_buffer.bindDescriptorSets(
+            vk::PipelineBindPoint::eGraphics, pipeline_->get_layout(),
+            0, descriptor_sets_[image].get(), nullptr
+        );
+    }
+
+    // Record the whole scene as a single indirect draw
+    // The vertex shader reads each draw's texture from its object data
+    // With GPU culling, draws the records appended by a culling pass
+    void record_indirect_draws(vk::CommandBuffer command_buffer, 
+                               uint32_t image, 
+                               CullPass pass = CullPass::Visible) {
+        command_buffer.bindPipeline(
+            vk::PipelineBindPoint::eGraphics,
+            pipeline_->get_handle()
+        );
+
+        bind_scene(command_buffer, image);
+
+        PushConstantObject push_constant = {
+            TEXTURE_FROM_OBJECT
+        };
+        command_buffer.pushConstants(
+            pipeline_->get_layout(), 
+            vk::ShaderStageFlagBits::eVertex,
+            0, 
+            sizeof(push_constant), 
+            &push_constant
+        );
+
+        // The draw count is read from the start of the image's records
+        // when supported, otherwise it is recorded in the commands
+        // GPU culling writes the visible records to their own buffer
+        DrawBuffers &buffers = draw_buffers_[image];
+        uint32_t stride = sizeof(vk::DrawIndexedIndirectCommand);
+        if(culling_ && gpu_culling_) {
+            vk::DeviceSize offset = 0;
+            if(pass == CullPass::Disoccluded) {
+                offset = buffers.culled->get_size() / 2;
+            }
+            command_buffer.drawIndexedIndirectCount(
+                buffers.culled->get_handle(),
+                offset + stride,
+                buffers.culled->get_handle(),
+                offset,
+                buffers.draw_capacity,
+                stride
+            );
+        }
+        else if(indirect_count_) {
+            command_buffer.drawIndexedIndirectCount(
+                buffers.records->get_handle(),
+                stride,
+                buffers.records->get_handle(),
+                0,
+                buffers.draw_capacity,
+                stride
+            );
+        }
+        else if(!draw_commands_.empty()) {
+            command_buffer.drawIndexedIndirect(
+                buffers.records->get_handle(),
+                stride,
+                draw_commands_.size(),
+                stride
+            );
+        }
+    }
+
+    // Record the commands of a framebuffer
+    // Only the dirty batches of draws are re-recorded, split across 
+    // the worker threads, then the primary buffer executes them all
+    // In indirect mode the primary draws the scene by itself
+    // The passes and the barriers between them come from the graph
+    // The image's previous frame must have finished
+    void record_commands(uint32_t image) {
+        commands_dirty_[image] = false;
+        if(!indirect_) {
+            recorder_->record(
+                image,
+                graph_->get_render_pass(scene_pass_),
+                graph_->get_framebuffer(scene_pass_, image),
+                [this](vk::CommandBuffer command_buffer, uint32_t image, const std::vector<DrawGroup> &groups) {
+                    return record_draws(command_buffer, image, groups);
+                }
+            );
+        }
+
+        // Begin recording commands
+        vk::CommandBufferBeginInfo begin_info;
+        graphics_commands_[image]->begin(begin_info);
+        graph_->execute(graphics_commands_[image].get(), image);
+
+        // Stop recording
+        graphics_commands_[image]->end();
+    }
+
+    // Wait for all frames in flight to finish
+    void wait_frames() {
+        for(auto &fence : fences_) {
+            vk::Result result = logical_->waitForFences(
+                fence.get(),
+                true,
+                UINT64_MAX
+            );
         }
     }
 
@@ -1116,98 +2378,971 @@ class Core {
         }
     }
 
-    // Update the uniform buffers every frame
-    // This is where we update view and projection matrices
-    void update_uniform_buffer(uint32_t image_index) {
-        static auto start_time = std::chrono::high_resolution_clock::now();
-        auto current_time = std::chrono::high_resolution_clock::now();
-        float time = std::chrono::duration<float, std::chrono::seconds::period>(
-            current_time - start_time
-        ).count();
-
-        // World coordinates (Per object)
-        glm::mat4 model = glm::rotate(
-            glm::mat4(1.0f), 
-            time * glm::radians(60.0f), 
-            glm::vec3(0.0f, 0.0f, 1.0f)
-        );
+    // Update the uniform buffers every frame
+    // This is where we update view and projection matrices
+    void update_uniform_buffer(uint32_t image_index) {
+        // Camera coordinates (Uniform)
+        glm::mat4 view = glm::lookAt(
+            eye_, 
+            glm::vec3(0.0f, 0.0f, 0.0f), 
+            glm::vec3(0.0f, 0.0f, 1.0f)
+        );
+
+        // 45 deg FOV (Uniform)
+        float ratio = 0.0f;
+        if(image_extent_.height) {
+            ratio = image_extent_.width / static_cast<float>(image_extent_.height);
+        }
+        glm::mat4 proj = glm::perspective(
+            glm::radians(45.0f), ratio, near_, far_
+        );
+
+        // Vertically flip the projection so the model isn't upside down
+        proj[1][1] *= -1;
+        
+        // Overwrite currently written UBO
+        view_projection_ = proj * view;
+        Frustum frustum = extract_frustum(view_projection_);
+        UniformBufferObject ubo;
+        ubo.transform = view_projection_;
+        std::copy(frustum.planes, frustum.planes + 6, ubo.planes);
+        ubo.previous = previous_view_projection_;
+        previous_view_projection_ = view_projection_;
+        uniform_buffer_->clear(image_index);
+        uniform_buffer_->copy(image_index, &ubo, sizeof(ubo));
+    }
+
+    // Reset the swapchain on changes in window size
+    void reset_swapchain() {
+        logical_->waitIdle();
+
+        // Do not recreate swapchain if minimized
+        auto supported = physical_->get_swapchain_support();
+        auto extent = get_swapchain_extent(supported.capabilities);
+        if(!extent.width || !extent.height) {
+            return;
+        }
+
+        // Clear array objects
+        // Compiles in flight must not outlive the scene pass
+        variants_->stop();
+        graph_.reset();
+        images_.clear();
+        views_.clear();
+
+        // Recreate swapchain and its dependents
+        // Only the size-dependent images and framebuffers are rebuilt,
+        // the pipelines are kept unless the new scene pass is no longer
+        // compatible with them
+        swapchain_.reset();
+        try {
+            create_swapchain();
+            create_views();
+
+            // The pyramid is sized first, as the graph imports it
+            pyramid_->resize(image_extent_, msaa_samples_);
+            create_render_graph();
+            retarget_graphics_pipeline();
+            create_depth_pyramid();
+            write_cull_buffers();
+
+            invalidate_commands();
+        }
+        catch(vk::SystemError &err) {
+            std::cerr << "Vulkan SystemError: " << err.what() << "\n";
+            exit(-1);
+        }
+    }
+
+    // Point the sized depth pyramid at the graph's depth buffer
+    // Cleared to the far plane, so nothing is occluded before its
+    // first build
+    void create_depth_pyramid() {
+        pyramid_->set_depth(graph_->get_view(depth_target_, 0));
+        vk::UniqueCommandBuffer command_buffer = begin_one_time_commands();
+        pyramid_->record_clear(command_buffer.get());
+        submit_one_time_commands(command_buffer);
+    }
+
+    // Get the buffers read and written by an image's GPU culling passes
+    GpuCullBuffers get_cull_buffers(uint32_t image_index) {
+        DrawBuffers &draw = draw_buffers_[image_index];
+        size_t half = draw.culled->get_size() / 2;
+        GpuCullBuffers buffers;
+        buffers.uniforms = vk::DescriptorBufferInfo(
+            uniform_buffer_->get_handle(),
+            uniform_buffer_->get_offset(image_index),
+            sizeof(UniformBufferObject)
+        );
+        buffers.objects = vk::DescriptorBufferInfo(
+            draw.objects->get_handle(), 0, draw.objects->get_size()
+        );
+        buffers.records = vk::DescriptorBufferInfo(
+            draw.records->get_handle(), 0, draw.records->get_size()
+        );
+        buffers.culled = vk::DescriptorBufferInfo(
+            draw.culled->get_handle(), 0, half
+        );
+        buffers.disoccluded = vk::DescriptorBufferInfo(
+            draw.culled->get_handle(), half, half
+        );
+        buffers.visibility = vk::DescriptorBufferInfo(
+            draw.visibility->get_handle(), 0, draw.visibility->get_size()
+        );
+        buffers.pyramid = pyramid_->get_descriptor();
+        buffers.instances = vk::DescriptorBufferInfo(
+            draw.indices->get_handle(), 0, draw.indices->get_size()
+        );
+        return buffers;
+    }
+
+    // Point the GPU culling passes at each image's buffers
+    void write_cull_buffers() {
+        std::vector<GpuCullBuffers> buffers;
+        for(uint32_t i = 0; i < images_.size(); i++) {
+            buffers.push_back(get_cull_buffers(i));
+        }
+        gpu_culler_->set_buffers(buffers);
+    }
+
+    // Point the GPU culling passes of an image at its buffers
+    // Its frame must have finished
+    void write_cull_buffers(uint32_t image_index) {
+        gpu_culler_->set_image_buffers(image_index, get_cull_buffers(image_index));
+    }
+
+    // Read the results of an image's last GPU culling passes
+    // Its frame must have finished
+    void read_gpu_cull_stats(uint32_t image_index) {
+        RenderBuffer &buffer = *draw_buffers_[image_index].culled;
+        char *culled = buffer.get_mapped();
+        CulledHeader headers[2] = {};
+        std::memcpy(&headers[0], culled, sizeof(CulledHeader));
+        if(occlusion_culling_) {
+            std::memcpy(
+                &headers[1],
+                culled + buffer.get_size() / 2,
+                sizeof(CulledHeader)
+            );
+        }
+        count_cull_totals();
+        cull_stats_.visible = headers[0].visible_count + headers[1].visible_count;
+        cull_stats_.visible_triangles = headers[0].triangle_count + headers[1].triangle_count;
+        cull_stats_.disoccluded = headers[1].visible_count;
+
+        cull_stats_.cull_ms = gpu_culler_->get_cull_ms(image_index, CullPass::Visible);
+        if(occlusion_culling_ && cull_stats_.cull_ms >= 0) {
+            cull_stats_.cull_ms += gpu_culler_->get_cull_ms(image_index, CullPass::Disoccluded);
+        }
+    }
+
+    // Count the instances and triangles of all draw groups
+    void count_cull_totals() {
+        cull_stats_.instances = 0;
+        cull_stats_.triangles = 0;
+        for(auto &command : draw_commands_) {
+            cull_stats_.instances += command.instanceCount;
+            cull_stats_.triangles += command.instanceCount * (command.indexCount / 3);
+        }
+    }
+
+    // Allocate a one-time command buffer on the graphics queue and begin it
+    vk::UniqueCommandBuffer begin_one_time_commands() {
+        vk::CommandBufferAllocateInfo cmd_alloc_info;
+        cmd_alloc_info.commandPool = graphics_pool_.get();
+        cmd_alloc_info.level = vk::CommandBufferLevel::ePrimary;
+        cmd_alloc_info.commandBufferCount = 1;
+
+        vk::UniqueCommandBuffer command_buffer = std::move(
+            logical_->allocateCommandBuffersUnique(cmd_alloc_info)[0]
+        );
+
+        vk::CommandBufferBeginInfo cmd_begin_info;
+        cmd_begin_info.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+        command_buffer->begin(cmd_begin_info);
+        return command_buffer;
+    }
+
+    // End a one-time command buffer, submit it, and wait for it to finish
+    void submit_one_time_commands(vk::UniqueCommandBuffer &command_buffer) {
+        command_buffer->end();
+
+        vk::SubmitInfo submit_info;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &command_buffer.get();
+
+        graphics_queue_.submit(submit_info, nullptr);
+        graphics_queue_.waitIdle();
+    }
+
+    // Wait for a half of the upload staging window to be free and 
+    // begin recording the copies out of it
+    vk::UniqueCommandBuffer begin_staging(int half) {
+        vk::Result result = logical_->waitForFences(
+            upload_fences_[half].get(),
+            true,
+            UINT64_MAX
+        );
+        upload_staging_->clear(half);
+        return begin_one_time_commands();
+    }
+
+    // Expand the staged chunks into a half of the upload staging window
+    // on the worker threads, then record their copies and submit them
+    void submit_staging(int half, 
+                        vk::UniqueCommandBuffer &command_buffer,
+                        std::vector<StagingChunk> &chunks,
+                        std::vector<TextureUpload> &uploads,
+                        std::vector<std::unique_ptr<TextureData>> &textures,
+                        vk::Semaphore signal = nullptr) {
+        char *mapped = upload_staging_->get_mapped();
+        for(StagingChunk &chunk : chunks) {
+            int channels = uploads[chunk.upload].channels;
+            int stored = textures[chunk.upload]->get_channels();
+            workers_->submit([&chunk, mapped, channels, stored]() {
+                const unsigned char *src = chunk.pixels + 
+                                           chunk.rect.y * chunk.rect.width * channels;
+                size_t count = chunk.rect.width * chunk.rect.height;
+                if(channels == stored) {
+                    std::memcpy(mapped + chunk.offset, src, count * channels);
+                }
+                else {
+                    expand_to_rgba(
+                        src,
+                        reinterpret_cast<unsigned char *>(mapped + chunk.offset),
+                        count,
+                        channels
+                    );
+                }
+            });
+        }
+        workers_->wait();
+
+        for(StagingChunk &chunk : chunks) {
+            textures[chunk.upload]->record_copy(
+                command_buffer.get(),
+                upload_staging_->get_handle(),
+                chunk.offset,
+                chunk.rect,
+                chunk.level
+            );
+            if(!chunk.last) {
+                continue;
+            }
+            TextureData &texture = *textures[chunk.upload];
+            if(!texture.is_storage()) {
+                texture.end_upload(command_buffer.get(), uploads[chunk.upload].mipped);
+                continue;
+            }
+
+            // Mips are generated in a compute shader, right away unless
+            // it runs on the async compute queue
+            mip_generator_->record_release(command_buffer.get(), texture);
+            if(!mip_generator_->is_async()) {
+                mip_generator_->record_generate(command_buffer.get(), texture);
+            }
+        }
+        chunks.clear();
+
+        command_buffer->end();
+        logical_->resetFences(upload_fences_[half].get());
+
+        vk::SubmitInfo submit_info;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &command_buffer.get();
+        if(signal) {
+            submit_info.signalSemaphoreCount = 1;
+            submit_info.pSignalSemaphores = &signal;
+        }
+        graphics_queue_.submit(submit_info, upload_fences_[half].get());
+    }
+
+    // Get the channels stored for texels with a number of channels
+    // Grey images keep their channel if the device can sample, filter
+    // and blit its format, all others become RGBA
+    int get_stored_channels(int channels) {
+        if(channels != 1) {
+            return 4;
+        }
+        vk::FormatFeatureFlags required = vk::FormatFeatureFlagBits::eSampledImage |
+                                          vk::FormatFeatureFlagBits::eSampledImageFilterLinear |
+                                          vk::FormatFeatureFlagBits::eBlitSrc |
+                                          vk::FormatFeatureFlagBits::eBlitDst |
+                                          vk::FormatFeatureFlagBits::eTransferDst;
+        auto properties = physical_->get_format_properties(get_texture_format(channels));
+        if((properties.optimalTilingFeatures & required) != required) {
+            return 4;
+        }
+        return channels;
+    }
+
+    // Should the mips of an upload be generated in a compute shader?
+    bool is_compute_mipmapped(TextureUpload &upload) {
+        return compute_mipmaps_ && 
+               !upload.mipped && 
+               upload.mip_levels > 1 &&
+               mip_generator_->is_supported(
+                   get_texture_format(get_stored_channels(upload.channels)),
+                   upload.mip_levels
+               );
+    }
+
+    // Create a batch of textures
+    // Texel data is streamed through the fixed upload staging window in
+    // bands of rows, so the staging footprint never depends on the size
+    // of the images
+    // One half of the window is filled on the worker threads while the 
+    // other is copied on the GPU
+    std::vector<std::unique_ptr<TextureData>> create_textures(std::vector<TextureUpload> &uploads) {
+        // The dispatch resources of the last async batch are freed
+        // before recording more
+        finish_compute_mipmaps();
+
+        std::vector<std::unique_ptr<TextureData>> textures;
+        for(auto &upload : uploads) {
+            if(!upload.pixels) {
+                throw std::runtime_error("Could not load image.");
+            }
+            if(upload.width * 4 > upload_size_) {
+                throw std::runtime_error("Texture rows exceed the staging window.");
+            }
+            uint32_t base = upload.mipped ? upload.base_level : 0;
+            textures.push_back(
+                std::make_unique<TextureData>(
+                    std::max(upload.width >> base, 1u), 
+                    std::max(upload.height >> base, 1u),
+                    upload.mip_levels - base,
+                    get_stored_channels(upload.channels),
+                    logical_.get(), 
+                    *physical_,
+                    *image_memory_,
+                    is_compute_mipmapped(upload)
+                )
+            );
+        }
+
+        int half = 0;
+        std::array<vk::UniqueCommandBuffer, 2> command_buffers;
+        command_buffers[half] = begin_staging(half);
+        for(auto &texture : textures) {
+            texture->begin_upload(command_buffers[half].get());
+        }
+
+        std::vector<StagingChunk> chunks;
+        for(int i = 0; i < uploads.size(); i++) {
+            TextureUpload &upload = uploads[i];
+            uint32_t levels = upload.mipped ? upload.mip_levels : 1;
+            uint32_t base = upload.mipped ? upload.base_level : 0;
+            for(uint32_t level = base; level < levels; level++) {
+                uint32_t width = std::max(upload.width >> level, 1u);
+                uint32_t height = std::max(upload.height >> level, 1u);
+                size_t row_size = width * textures[i]->get_channels();
+                size_t texel = get_mip_offset(upload.width, upload.height, level) / 4;
+
+                uint32_t row = 0;
+                while(row < height) {
+                    size_t available = upload_staging_->get_subsize(half) - 
+                                       upload_staging_->get_subfill(half);
+                    uint32_t rows = std::min<size_t>(height - row, available / row_size);
+                    if(!rows) {
+                        // This half is full, switch to the other one
+                        submit_staging(half, command_buffers[half], chunks, uploads, textures);
+                        half = 1 - half;
+                        command_buffers[half] = begin_staging(half);
+                        continue;
+                    }
+
+                    StagingChunk chunk;
+                    chunk.upload = i;
+                    chunk.level = level - base;
+                    chunk.rect = {0, row, width, rows};
+                    chunk.pixels = upload.pixels + texel * upload.channels;
+                    // Copies must start at a multiple of 4 bytes
+                    chunk.offset = upload_staging_->get_offset(half) + 
+                                   upload_staging_->reserve(half, round_up(rows * row_size, 4));
+                    chunk.last = level + 1 == levels && row + rows == height;
+                    chunks.push_back(chunk);
+                    row += rows;
+                }
+            }
+        }
+        std::vector<TextureData *> generated;
+        if(mip_generator_->is_async()) {
+            for(auto &texture : textures) {
+                if(texture->is_storage()) {
+                    generated.push_back(texture.get());
+                }
+            }
+        }
+        if(generated.empty()) {
+            submit_staging(half, command_buffers[half], chunks, uploads, textures);
+        }
+        else {
+            submit_staging(
+                half, command_buffers[half], chunks, uploads, textures, 
+                mip_signals_[0].get()
+            );
+            generate_compute_mipmaps(generated);
+        }
+
+        // Wait for both halves before their command buffers are freed
+        // Mips generated on the async compute queue are left running
+        for(auto &fence : upload_fences_) {
+            vk::Result result = logical_->waitForFences(
+                fence.get(),
+                true,
+                UINT64_MAX
+            );
+        }
+        if(generated.empty()) {
+            mip_generator_->reset();
+        }
+        return textures;
+    }
+
+    // Create a single texture from RGBA pixels
+    std::unique_ptr<TextureData> create_texture(unsigned char pixels[], 
+                                                int width, int height,
+                                                uint32_t mip_levels) {
+        std::vector<TextureUpload> uploads = {
+            {pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height), mip_levels}
+        };
+        return std::move(create_textures(uploads)[0]);
+    }
+
+    // Create the atlas for packing small sprites
+    void create_atlas() {
+        uint32_t page_size = std::min(
+            2048u, 
+            physical_->get_limits().maxImageDimension2D
+        );
+        atlas_ = std::make_unique<TextureAtlas>(page_size, 1);
+    }
+
+    // Create the mip residency manager
+    // The default budget is half of the largest device local heap
+    void create_residency() {
+        auto &memory = physical_->get_memory();
+        vk::DeviceSize heap_size = 0;
+        for(uint32_t i = 0; i < memory.memoryHeapCount; i++) {
+            if(memory.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal) {
+                heap_size = std::max(heap_size, memory.memoryHeaps[i].size);
+            }
+        }
+        residency_ = std::make_unique<TextureResidency>(heap_size / 2);
+
+        // Limit how much texel data is streamed in per frame
+        stream_limit_ = 16 * 1024 * 1024;
+    }
+
+    // Get the memory properties of a buffer the CPU reads back
+    // Cached memory makes reads fast, but devices need not have it
+    vk::MemoryPropertyFlags get_readback_properties() {
+        vk::MemoryPropertyFlags properties = 
+            vk::MemoryPropertyFlagBits::eHostVisible |
+            vk::MemoryPropertyFlagBits::eHostCoherent;
+        vk::MemoryPropertyFlags cached = 
+            properties | vk::MemoryPropertyFlagBits::eHostCached;
+
+        auto &memory = physical_->get_memory();
+        for(uint32_t i = 0; i < memory.memoryTypeCount; i++) {
+            if((memory.memoryTypes[i].propertyFlags & cached) == cached) {
+                return cached;
+            }
+        }
+        return properties;
+    }
+
+    // Create the virtual texture page tracker and its buffers
+    // The page cache texture itself is only created once a virtual 
+    // texture is loaded
+    void create_virtual_textures() {
+        uint32_t slots = std::min(
+            32u, 
+            physical_->get_limits().maxImageDimension2D / VT_SLOT_SIZE
+        );
+        virtual_ = std::make_unique<VirtualTextures>(slots);
+
+        // Limit how many pages are streamed in per frame
+        virtual_page_limit_ = 16;
+
+        size_t size = round_up(
+            VT_FEEDBACK_SIZE * sizeof(uint32_t),
+            physical_->get_limits().minStorageBufferOffsetAlignment
+        );
+        virtual_feedback_ = std::make_unique<RenderBuffer>(
+            size * images_.size(),
+            logical_.get(), 
+            *physical_, 
+            vk::BufferUsageFlagBits::eStorageBuffer,
+            get_readback_properties(),
+            transfer_commands_.get(), 
+            transfer_pool_.get(), 
+            transfer_queue_
+        );
+        for(int i = 0; i < images_.size(); i++) {
+            virtual_feedback_->suballoc(size);
+            std::memset(
+                virtual_feedback_->get_mapped() + virtual_feedback_->get_offset(i),
+                0xFF,
+                VT_FEEDBACK_SIZE * sizeof(uint32_t)
+            );
+        }
+        create_virtual_tables();
+    }
+
+    // Create a page table buffer of at least a size in bytes
+    std::unique_ptr<RenderBuffer> create_virtual_table(size_t size) {
+        return std::make_unique<RenderBuffer>(
+            round_up(size, physical_->get_limits().minStorageBufferOffsetAlignment),
+            logical_.get(), 
+            *physical_, 
+            vk::BufferUsageFlagBits::eStorageBuffer,
+            vk::MemoryPropertyFlagBits::eHostVisible |
+            vk::MemoryPropertyFlagBits::eHostCoherent,
+            transfer_commands_.get(), 
+            transfer_pool_.get(), 
+            transfer_queue_
+        );
+    }
+
+    // Create a copy of the page tables for each swapchain image
+    void create_virtual_tables() {
+        size_t size = sizeof(VirtualHeader) + 
+                      std::max<size_t>(virtual_->get_tables().size(), 1) * sizeof(uint32_t);
+        virtual_tables_.clear();
+        virtual_versions_.assign(images_.size(), 0);
+        virtual_changes_.assign(images_.size(), {});
+        for(int i = 0; i < images_.size(); i++) {
+            virtual_tables_.push_back(create_virtual_table(size));
+            write_virtual_tables(i);
+        }
+    }
+
+    // Queue the page table entries changed since the last call for 
+    // every image
+    void queue_virtual_changes() {
+        for(auto &change : virtual_->take_changes()) {
+            for(auto &changes : virtual_changes_) {
+                changes.push_back(change);
+            }
+        }
+    }
+
+    // Bring a swapchain image's copy of the page tables up to date
+    // The image's frame must have finished
+    // Only the header and the entries queued for it are copied, unless
+    // the tables outgrew its buffer
+    // A grown buffer changes the image's descriptor set, so its 
+    // commands are re-recorded
+    void write_virtual_tables(uint32_t image_index) {
+        auto &tables = virtual_->get_tables();
+        auto &changes = virtual_changes_[image_index];
+        size_t size = sizeof(VirtualHeader) + tables.size() * sizeof(uint32_t);
+        if(size > virtual_tables_[image_index]->get_size()) {
+            virtual_tables_[image_index] = create_virtual_table(size * 2);
+            changes.assign(1, {0, static_cast<uint32_t>(tables.size())});
+
+            vk::DescriptorBufferInfo buffer_info;
+            buffer_info.buffer = virtual_tables_[image_index]->get_handle();
+            buffer_info.offset = 0;
+            buffer_info.range = virtual_tables_[image_index]->get_size();
+
+            vk::WriteDescriptorSet descriptor_write;
+            descriptor_write.dstSet = descriptor_sets_[image_index].get();
+            descriptor_write.dstBinding = 1;
+            descriptor_write.dstArrayElement = 0;
+            descriptor_write.descriptorCount = 1;
+            descriptor_write.descriptorType = vk::DescriptorType::eStorageBuffer;
+            descriptor_write.pBufferInfo = &buffer_info;
+            logical_->updateDescriptorSets(descriptor_write, nullptr);
+            recorder_->invalidate_image(image_index);
+            commands_dirty_[image_index] = true;
+        }
+
+        // Runs may overlap, each entry is only copied once
+        char *mapped = virtual_tables_[image_index]->get_mapped();
+        std::memcpy(mapped, &virtual_->get_header(), sizeof(VirtualHeader));
+        std::sort(changes.begin(), changes.end());
+        uint32_t copied = 0;
+        for(auto &change : changes) {
+            uint32_t first = std::max(change.first, copied);
+            uint32_t last = change.first + change.second;
+            if(last <= first) {
+                continue;
+            }
+            std::memcpy(
+                mapped + sizeof(VirtualHeader) + first * sizeof(uint32_t), 
+                tables.data() + first, 
+                (last - first) * sizeof(uint32_t)
+            );
+            copied = last;
+        }
+        changes.clear();
+        virtual_versions_[image_index] = virtual_->get_version();
+    }
+
+    // Copy a page of a virtual texture into its slot of the page cache
+    void upload_virtual_page(PageId page, uint32_t slot) {
+        uint32_t texture = page >> 24;
+        uint32_t level = (page >> 20) & 0xF;
+        StreamSource &source = virtual_sources_[texture];
+        TexturePack &pack = *packs_[source.pack];
+        const PackEntry &entry = pack.get_entries()[source.entry];
+
+        std::vector<unsigned char> texels(VT_SLOT_SIZE * VT_SLOT_SIZE * 4);
+        extract_page(
+            pack.get_texels(source.entry, level),
+            std::max(entry.width >> level, 1u),
+            std::max(entry.height >> level, 1u),
+            page & 0x3FF,
+            (page >> 10) & 0x3FF,
+            &texels[0]
+        );
+
+        uint32_t slots = virtual_->get_header().slots;
+        TextureRect rect = {
+            (slot % slots) * VT_SLOT_SIZE,
+            (slot / slots) * VT_SLOT_SIZE,
+            VT_SLOT_SIZE,
+            VT_SLOT_SIZE
+        };
+        update_texture(virtual_->get_header().cache, rect, &texels[0], false);
+    }
+
+    // Read back the pages sampled by the last frame drawn to an image 
+    // and stream in the missing ones
+    // The image's frame must have finished, new pages are copied into 
+    // the cache before its next frame is drawn
+    void update_virtual_textures(uint32_t image_index) {
+        if(!virtual_->get_count()) {
+            return;
+        }
+        uint32_t *feedback = reinterpret_cast<uint32_t *>(
+            virtual_feedback_->get_mapped() + 
+            virtual_feedback_->get_offset(image_index)
+        );
+        virtual_->begin_frame();
+        virtual_->request(feedback, VT_FEEDBACK_SIZE);
+        std::memset(feedback, 0xFF, VT_FEEDBACK_SIZE * sizeof(uint32_t));
+
+        for(PageId page : virtual_->get_missing(virtual_page_limit_)) {
+            int slot = virtual_->place(page);
+            if(slot < 0) {
+                break;
+            }
+            upload_virtual_page(page, slot);
+        }
+        submit_texture_updates();
+        queue_virtual_changes();
+
+        if(virtual_versions_[image_index] != virtual_->get_version()) {
+            write_virtual_tables(image_index);
+        }
+    }
+
+    // Get the upload for the target mip levels of a streamed texture
+    // The image only holds the levels from the target on
+    TextureUpload get_stream_upload(Texture texture) {
+        StreamSource &source = stream_sources_[texture];
+        TexturePack &pack = *packs_[source.pack];
+        const PackEntry &entry = pack.get_entries()[source.entry];
+
+        TextureUpload upload = {
+            pack.get_texels(source.entry),
+            entry.width,
+            entry.height,
+            entry.mip_levels
+        };
+        upload.mipped = true;
+        upload.base_level = residency_->get_target(texture);
+        return upload;
+    }
+
+    // Reallocate a streamed texture with its mip levels from a target
+    // level on, so that dropped levels no longer take any memory
+    // Levels both images hold are copied on the GPU, and those streamed
+    // in are copied from the pack through the staging ring
+    // Returns the replaced texture, which frames may still sample
+    std::unique_ptr<TextureData> restream_texture(Texture texture, uint32_t target) {
+        StreamSource &source = stream_sources_[texture];
+        TexturePack &pack = *packs_[source.pack];
+        const PackEntry &entry = pack.get_entries()[source.entry];
+        uint32_t resident = residency_->get_resident(texture);
+
+        std::unique_ptr<TextureData> replaced = std::move(textures_[texture]);
+        textures_[texture] = std::make_unique<TextureData>(
+            std::max(entry.width >> target, 1u),
+            std::max(entry.height >> target, 1u),
+            entry.mip_levels - target,
+            replaced->get_channels(),
+            logical_.get(),
+            *physical_,
+            *image_memory_
+        );
+        TextureData &data = *textures_[texture];
+
+        vk::CommandBuffer command_buffer = get_update_commands();
+        data.begin_upload(command_buffer);
+        uint32_t kept = std::max(target, resident);
+        data.record_copy_levels(
+            command_buffer,
+            *replaced,
+            kept - resident,
+            kept - target,
+            entry.mip_levels - kept
+        );
+        for(uint32_t level = target; level < resident; level++) {
+            uint32_t width = std::max(entry.width >> level, 1u);
+            uint32_t height = std::max(entry.height >> level, 1u);
+            stage_elements(
+                pack.get_texels(source.entry, level),
+                width * 4,
+                height,
+                [&](vk::CommandBuffer command_buffer, size_t offset, uint32_t row, uint32_t rows) {
+                    data.record_copy(
+                        command_buffer,
+                        update_staging_->get_handle(),
+                        offset,
+                        {0, row, width, rows},
+                        level - target
+                    );
+                }
+            );
+        }
+        command_buffer = get_update_commands();
+        data.end_upload(command_buffer, true);
+        return replaced;
+    }
+
+    // Write the elements of an image's descriptor set whose textures
+    // were added, or whose views or samplers changed
+    // Its frame must have finished
+    // Without update after bind, the image's commands are re-recorded
+    // since updating a bound set invalidates them, unless only new
+    // elements no recorded command uses were written
+    void write_texture_descriptors(uint32_t image_index) {
+        std::vector<Texture> &textures = texture_writes_[image_index];
+        if(textures.empty()) {
+            return;
+        }
+        std::vector<vk::DescriptorImageInfo> image_infos(textures.size());
+        std::vector<vk::WriteDescriptorSet> writes(textures.size());
+        bool replaced = false;
+        for(int i = 0; i < textures.size(); i++) {
+            replaced |= static_cast<uint32_t>(textures[i]) < texture_counts_[image_index];
+            image_infos[i].sampler = get_texture_sampler(textures[i]);
+            image_infos[i].imageView = textures_[textures[i]]->get_view();
+            image_infos[i].imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+
+            writes[i].dstSet = descriptor_sets_[image_index].get();
+            writes[i].dstBinding = 5;
+            writes[i].dstArrayElement = textures[i];
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+            writes[i].pImageInfo = &image_infos[i];
+        }
+        logical_->updateDescriptorSets(writes, nullptr);
+        textures.clear();
+        texture_counts_[image_index] = textures_.size();
+
+        // The replaced textures are used until this frame finishes
+        for(auto &retired : retired_textures_) {
+            if(retired.frames[image_index] == 2) {
+                retired.frames[image_index] = 1;
+            }
+        }
 
-        // Camera coordinates (Uniform)
-        glm::mat4 view = glm::lookAt(
-            glm::vec3(2.0f, 2.0f, 2.0f), 
-            glm::vec3(0.0f, 0.0f, 0.0f), 
-            glm::vec3(0.0f, 0.0f, 1.0f)
-        );
+        if(!update_after_bind_ && (replaced || !update_unused_)) {
+            recorder_->invalidate_image(image_index);
+            commands_dirty_[image_index] = true;
+        }
+    }
 
-        // 45 deg FOV (Uniform)
-        float ratio = 0.0f;
-        if(image_extent_.height) {
-            ratio = image_extent_.width / static_cast<float>(image_extent_.height);
+    // Free the textures streaming replaced once no frame uses them
+    // The image's frame must have finished
+    void free_retired_textures(uint32_t image_index) {
+        for(auto &retired : retired_textures_) {
+            if(retired.frames[image_index] == 1) {
+                retired.frames[image_index] = 0;
+            }
         }
-        glm::mat4 proj = glm::perspective(
-            glm::radians(45.0f), ratio, 1.0f, 10.0f
+        retired_textures_.erase(
+            std::remove_if(
+                retired_textures_.begin(),
+                retired_textures_.end(),
+                [](RetiredTexture &retired) {
+                    return std::all_of(
+                        retired.frames.begin(), 
+                        retired.frames.end(), 
+                        [](int frames) { return frames == 0; }
+                    );
+                }
+            ),
+            retired_textures_.end()
         );
-
-        // Vertically flip the projection so the model isn't upside down
-        proj[1][1] *= -1;
-        
-        // Overwrite currently written UBO
-        UniformBufferObject ubo = {
-            proj * view * model
-        };
-        uniform_buffer_->clear(image_index);
-        uniform_buffer_->copy(image_index, &ubo, sizeof(ubo));
     }
 
-    // Reset the swapchain on changes in window size
-    void reset_swapchain() {
-        logical_->waitIdle();
+    // Queue a texture's descriptor to be written into each image's set
+    // once its frame has finished
+    void queue_texture_write(Texture texture) {
+        for(auto &textures : texture_writes_) {
+            if(std::find(textures.begin(), textures.end(), texture) == textures.end()) {
+                textures.push_back(texture);
+            }
+        }
+    }
 
-        // Do not recreate swapchain if minimized
-        auto supported = physical_->get_swapchain_support();
-        auto extent = get_swapchain_extent(supported.capabilities);
-        if(!extent.width || !extent.height) {
+    // Stream mip levels of pack textures in or out to meet their targets
+    // Each changed texture is reallocated with only its target levels,
+    // copying the ones it keeps on the GPU and the ones streamed in
+    // through the staging ring, so nothing waits on the device
+    // The replaced textures are freed once no frame uses them
+    // Dropping levels always happens immediately, but streaming them 
+    // back in is limited per frame to avoid hitches
+    void stream_textures() {
+        std::vector<Texture> changed = residency_->update();
+        if(changed.empty()) {
             return;
         }
 
-        // Clear array objects
-        images_.clear();
-        views_.clear();
-        framebuffers_.clear();
+        size_t streamed = 0;
+        for(Texture texture : changed) {
+            StreamSource &source = stream_sources_[texture];
+            const PackEntry &entry = packs_[source.pack]->get_entries()[source.entry];
+            uint32_t target = residency_->get_target(texture);
+            uint32_t resident = residency_->get_resident(texture);
+            if(target < resident) {
+                size_t size = get_mip_offset(entry.width, entry.height, resident) -
+                              get_mip_offset(entry.width, entry.height, target);
+                if(streamed && streamed + size > stream_limit_) {
+                    continue;
+                }
+                streamed += size;
+            }
 
-        // Recreate swapchain and its dependents
-        swapchain_.reset();
-        try {
-            create_swapchain();
-            create_views();
-            
-            // Reset memory handles for depth and color buffers
-            image_memory_->remove_image(depth_memory_handle_);
-            image_memory_->remove_image(color_memory_handle_);
-            
-            // Reset buffer images
-            create_depth_buffer();
-            create_color_buffer();
+            // Each image switches to the new texture once its frame is done
+            retired_textures_.push_back({
+                restream_texture(texture, target),
+                std::vector<int>(images_.size(), 2)
+            });
+            queue_texture_write(texture);
+            residency_->set_resident(texture, target);
+        }
 
-            create_render_pass();
-            create_graphics_pipeline();
+        // The copies are submitted ahead of the frame sampling them
+        submit_texture_updates();
+    }
+
+    // Upload the regions of atlas pages that changed since the last frame
+    // Pages are not mipmapped so that sprites do not bleed together
+    // Only the dirty rectangle is copied into the page's texture through
+    // the staging ring, so the device is not idled and the page keeps 
+    // its image and descriptors
+    void flush_atlas() {
+        for(auto &page : atlas_->get_pages()) {
+            if(!page->is_dirty()) {
+                continue;
+            }
+            TextureRect rect = page->get_dirty_rect();
+            uint32_t size = page->get_size();
+            std::vector<unsigned char> texels(rect.width * rect.height * 4);
+            for(uint32_t row = 0; row < rect.height; row++) {
+                std::memcpy(
+                    &texels[row * rect.width * 4],
+                    page->get_pixels() + ((rect.y + row) * size + rect.x) * 4,
+                    rect.width * 4
+                );
+            }
+            update_texture(page->get_texture(), rect, &texels[0], false);
+            page->clean();
+        }
+        submit_texture_updates();
+    }
 
-            create_framebuffers();
+    // Upload the vertex and index data of a mesh
+    MeshHandle upload_mesh_data(Mesh &mesh) {
+        uint32_t vertex_count = mesh.vertices.size();
+        uint32_t index_count = mesh.indices.size();
+        GeometryRange range;
+        if(!geometry_->allocate(vertex_count, index_count, range)) {
+            grow_geometry_buffer(vertex_count, index_count);
+            geometry_->allocate(vertex_count, index_count, range);
+        }
 
-            record_commands();
+        // Copy through the staging ring, after any draws that may still
+        // read a freed range and before the next frame's draws
+        vk::CommandBuffer command_buffer = get_update_commands();
+        geometry_->begin_upload(command_buffer);
+        stage_elements(
+            mesh.vertices.data(), 
+            sizeof(Vertex), 
+            vertex_count,
+            [&](vk::CommandBuffer command_buffer, size_t offset, uint32_t first, uint32_t count) {
+                geometry_->record_vertex_copy(
+                    command_buffer, 
+                    update_staging_->get_handle(), 
+                    offset, 
+                    range, 
+                    first, 
+                    count
+                );
+            }
+        );
+        stage_elements(
+            mesh.indices.data(), 
+            sizeof(uint32_t), 
+            index_count,
+            [&](vk::CommandBuffer command_buffer, size_t offset, uint32_t first, uint32_t count) {
+                geometry_->record_index_copy(
+                    command_buffer, 
+                    update_staging_->get_handle(), 
+                    offset, 
+                    range, 
+                    first, 
+                    count
+                );
+            }
+        );
+        command_buffer = get_update_commands();
+        geometry_->end_upload(command_buffer);
+
+        // The center of the mesh's vertices orders draws by depth and
+        // bounds the mesh for culling
+        glm::vec3 center(0.0f);
+        for(Vertex &vertex : mesh.vertices) {
+            center += vertex.position;
         }
-        catch(vk::SystemError &err) {
-            std::cerr << "Vulkan SystemError: " << err.what() << "\n";
-            exit(-1);
+        if(vertex_count) {
+            center /= static_cast<float>(vertex_count);
+        }
+
+        float radius = 0;
+        for(Vertex &vertex : mesh.vertices) {
+            radius = std::max(radius, glm::distance(center, vertex.position));
         }
+
+        mesh_data_[mesh_id_].geometry = range;
+        mesh_data_[mesh_id_].center = center;
+        mesh_data_[mesh_id_].radius = radius;
+        return mesh_id_++;
     }
 
-    // Reset all descriptor sets
-    void reset_descriptor_sets() {
-        logical_->waitIdle();
-        allocate_descriptor_sets();
-        write_descriptor_sets();
-        record_commands();
+    // Release a model's reference to its mesh
+    void release_mesh(MeshHandle mesh) {
+        mesh_data_[mesh].models--;
+        free_unused_mesh(mesh);
+    }
+
+    // Free a mesh if it was removed and no model draws it
+    void free_unused_mesh(MeshHandle mesh) {
+        MeshData &data = mesh_data_[mesh];
+        if(data.removed && !data.models) {
+            // Frames in flight may still read the freed ranges, but 
+            // later uploads into them wait for earlier draws
+            geometry_->free(data.geometry);
+            mesh_data_.erase(mesh);
+        }
     }
 
 public:
@@ -1218,13 +3353,37 @@ public:
 
         // 1M initial buffer size
         buffer_size_ = 1024 * 1024;
+
+        // 8M of texture updates per frame
+        update_size_ = 8 * 1024 * 1024;
+
+        // 16M for each half of the texture staging window
+        upload_size_ = 16 * 1024 * 1024;
         
+        mesh_id_ = 0;
+        group_id_ = 0;
         model_id_ = 0;
 
+        // Room for 1024 indirect draws of 4096 instances before growing
+        instances_ = std::make_unique<RangeAllocator>(4096);
+        instance_objects_.resize(instances_->get_capacity());
+        draw_capacity_ = 1024;
+        draw_version_ = 0;
+        indirect_ = false;
+        indirect_count_ = false;
+        culling_ = false;
+        gpu_culling_ = false;
+        occlusion_culling_ = false;
+        graph_dirty_ = false;
+        previous_view_projection_ = glm::mat4(1.0f);
+
+        eye_ = glm::vec3(2.0f, 2.0f, 2.0f);
+        near_ = 1.0f;
+        far_ = 10.0f;
+
         clear_value_.color.setFloat32({0, 0, 0, 1});
         depth_clear_value_.setDepthStencil({1, 0});
-        
-        mip_levels_ = 5;
+
 
         // Perform all initialization steps
         try {
@@ -1234,33 +3393,67 @@ public:
 
             create_physical_device();
             create_logical_device();
+            create_pipeline_cache();
             create_swapchain();
             create_views();
 
-            create_depth_buffer();
-            create_color_buffer();
-
             create_descriptor_layout();
-            create_render_pass();
+            create_render_graph();
+            create_pipeline_variants();
             create_graphics_pipeline();
-            
-            create_framebuffers();
+
             create_command_pool();
             create_command_buffers();
 
-            create_object_buffer();
+            create_geometry_buffer();
             create_uniform_buffer();
+            create_draw_buffers();
 
             create_descriptor_pool();
-            create_texture_sampler();
+            create_texture_updates();
+            create_texture_staging();
+            create_mip_generator();
+            create_sampler_cache();
+            create_atlas();
+            create_residency();
+            create_virtual_textures();
+
+            workers_ = std::make_unique<ThreadPool>(
+                std::max(1u, std::thread::hardware_concurrency())
+            );
+            recorder_ = std::make_unique<CommandRecorder>(
+                logical_.get(),
+                *workers_,
+                queues_.graphics.index,
+                images_.size()
+            );
+            commands_dirty_.assign(images_.size(), true);
+            culler_ = std::make_unique<FrustumCuller>(*workers_);
+            culler_->resize(instances_->get_capacity());
+            gpu_culler_ = std::make_unique<GpuCuller>(
+                logical_.get(),
+                *physical_,
+                *pipeline_cache_,
+                "cull.comp.spv"
+            );
+            pyramid_ = std::make_unique<DepthPyramid>(
+                logical_.get(),
+                *physical_,
+                *pipeline_cache_,
+                *image_memory_,
+                msaa_samples_ == vk::SampleCountFlagBits::e1 ? 
+                    "hiz.single.comp.spv" : 
+                    "hiz.comp.spv"
+            );
+            pyramid_->resize(image_extent_, msaa_samples_);
+            create_depth_pyramid();
 
             // Load a default white texture
             unsigned char white[] = {255, 255, 255, 255};
             load_texture(white, 1, 1);
             allocate_descriptor_sets();
             write_descriptor_sets();
-            
-            record_commands();
+            write_cull_buffers();
 
             create_synchronizers();
         }
@@ -1273,12 +3466,28 @@ public:
     ~Core() {
         // Wait for logical device to finish all operations
         logical_->waitIdle();
+
+        // Keep the compiled pipelines for the next run
+        try {
+            pipeline_cache_->save();
+        }
+        catch(std::runtime_error &err) {
+            std::cerr << err.what() << "\n";
+        }
+        recorder_.reset();
+        graph_.reset();
+        culler_.reset();
+        workers_.reset();
         textures_.clear();
         debugger_.reset();
     }
 
     // Update the display
     void refresh() {
+        submit_texture_updates();
+        flush_atlas();
+        stream_textures();
+
         vk::Result result;
         result = logical_->waitForFences(
             fences_[current_frame_].get(), 
@@ -1311,6 +3520,40 @@ public:
                 UINT64_MAX
             );
         }
+        grow_draw_buffers(image_index);
+        update_virtual_textures(image_index);
+        free_retired_textures(image_index);
+        write_texture_descriptors(image_index);
+        if(draw_versions_[image_index] != draw_version_) {
+            write_draw_records(image_index);
+        }
+        write_object_data(image_index);
+        // The culling shader reads every instance of the full draw
+        // records, so those compacted on the CPU are written back first
+        bool gpu_culling = indirect_ && culling_ && gpu_culling_;
+        bool cpu_culling = indirect_ && culling_ && !gpu_culling_;
+        if(cpu_culled_images_[image_index] && !cpu_culling) {
+            write_draw_records(image_index);
+            write_instance_indices(image_index);
+            cpu_culled_images_[image_index] = false;
+        }
+        if(cpu_culling) {
+            cull_draws(image_index);
+        }
+        if(gpu_culling && gpu_cull_pending_[image_index]) {
+            read_gpu_cull_stats(image_index);
+        }
+        gpu_cull_pending_[image_index] = gpu_culling;
+        if(graph_dirty_) {
+            rebuild_render_graph();
+        }
+        redraw_finished_pipelines();
+        if(!indirect_) {
+            sort_draws();
+        }
+        if(commands_dirty_[image_index] || (!indirect_ && recorder_->is_dirty(image_index))) {
+            record_commands(image_index);
+        }
         active_fences_[image_index] = fences_[current_frame_].get();
         logical_->resetFences(active_fences_[image_index]);
 
@@ -1376,105 +3619,541 @@ public:
             b/255.0f, 
             a/255.0f
         });
-        record_commands();
-    }
-
-    // Testing dynamic subbuffer appending
-    // TODO: In practice, we will also record a secondary command buffer in a new thread that draws this new mesh
-    // ALGORITHM FOR RENDERING ANY MESH
-    // * Allocate new subbuffers for the vertex and index data (keep track of an array of these subbuffers)
-    // * Record a new secondary command buffer that renders this mesh
-    // * At the end of each frame (right before render call), merge secondary buffers with primary
-    // * Re-record primary command buffer and submit to queue
-    // * Clear the index and staging buffers
-
-    // Alternative? Record secondary buffer ONLY when something new is added
-    Model add_model(Mesh &mesh, Texture texture) {
-        int index_len_bytes = sizeof(mesh.indices[0]) * mesh.indices.size();
-        int vertex_len_bytes = sizeof(mesh.vertices[0]) * mesh.vertices.size();
-
-        // Copy the index data
-        SubBuffer indices = object_buffer_->suballoc(index_len_bytes);
-        staging_buffer_->clear(0);
-        staging_buffer_->copy(0, &mesh.indices[0], index_len_bytes);
-        staging_buffer_->copy_buffer(
-            *object_buffer_, 
-            index_len_bytes, 
-            0, 
-            indices
-        );    
-
-        // Copy the vertex data
-        SubBuffer vertices = object_buffer_->suballoc(vertex_len_bytes);
-        staging_buffer_->clear(0);
-        staging_buffer_->copy(0, &mesh.vertices[0], vertex_len_bytes);
-        staging_buffer_->copy_buffer(
-            *object_buffer_, 
-            vertex_len_bytes, 
-            0, 
-            vertices
-        );
+        graph_dirty_ = true;
+    }
 
-        // Give each mesh its own descriptor set
-        model_data_[model_id_++] = {
-            vertices,
-            indices,
-            texture
-        };
-        record_commands();
-        return model_id_ - 1;
+    // Upload a mesh to be drawn by any number of models
+    MeshHandle upload_mesh(Mesh &mesh) {
+        return upload_mesh_data(mesh);
+    }
+
+    // Remove a mesh
+    // Its geometry is freed once the models drawing it are removed
+    void remove_mesh(MeshHandle mesh) {
+        auto it = mesh_data_.find(mesh);
+        if(it == mesh_data_.end() || it->second.removed) {
+            return;
+        }
+        it->second.removed = true;
+        free_unused_mesh(mesh);
+    }
+
+    // Add a model drawing an uploaded mesh
+    // Models of the same mesh, texture and pipeline are instances of 
+    // one draw, so only the secondary buffer of their batch is 
+    // re-recorded, for each image the next time it is acquired
+    // Indirect drawing draws every model with the default pipeline
+    Model add_model(MeshHandle mesh, 
+                    Texture texture, 
+                    PipelineVariant pipeline = DEFAULT_PIPELINE) {
+        if(mesh_data_.find(mesh) == mesh_data_.end() || mesh_data_[mesh].removed) {
+            throw std::runtime_error("Model added with an unknown mesh.");
+        }
+        if(pipeline >= variants_->get_size()) {
+            throw std::runtime_error("Model added with an unknown pipeline.");
+        }
+        mesh_data_[mesh].models++;
+        add_instance(get_draw_group(mesh, texture, pipeline), model_id_);
+        return model_id_++;
+    }
+
+    // Add a model drawing its own copy of a mesh
+    // Upload the mesh once instead when drawing it many times
+    Model add_model(Mesh &mesh, 
+                    Texture texture, 
+                    PipelineVariant pipeline = DEFAULT_PIPELINE) {
+        MeshHandle handle = upload_mesh(mesh);
+        Model model = add_model(handle, texture, pipeline);
+        remove_mesh(handle);
+        return model;
+    }
+
+    // Add a batch of models, each with its own copy of its mesh
+    std::vector<Model> add_models(std::vector<Mesh *> meshes, Texture texture) {
+        std::vector<Model> models;
+        for(Mesh *mesh : meshes) {
+            models.push_back(add_model(*mesh, texture));
+        }
+        return models;
+    }
+
+    // Set the number of threads recording draws
+    // Defaults to one per worker thread
+    // All batches are re-recorded with the new thread count
+    void set_record_threads(unsigned threads) {
+        recorder_->set_threads(threads);
+        invalidate_commands();
+    }
+
+    // Get the timings of the last command recording and the state 
+    // changes of the frame it recorded
+    RecordStats &get_record_stats() {
+        return recorder_->get_stats();
+    }
+
+    // Register a pipeline variant for models to draw with
+    // It compiles in the background, and its models are skipped until
+    // it is ready, so a new combination of state never stalls a frame
+    PipelineVariant add_pipeline(const PipelineSettings &settings) {
+        return variants_->add(get_supported_settings(settings));
+    }
+
+    // Has a pipeline variant finished compiling?
+    bool is_pipeline_ready(PipelineVariant pipeline) {
+        return variants_->get(pipeline) != nullptr;
+    }
+
+    // Get whether the pipeline cache started warm, and the time spent
+    // creating pipelines since
+    PipelineCacheStats &get_pipeline_cache_stats() {
+        return pipeline_cache_->get_stats();
+    }
+
+    // Draw the whole scene with a single indirect call
+    // Adding or removing models then only rewrites the draw records,
+    // without re-recording any commands
+    void set_indirect_drawing(bool indirect) {
+        if(indirect && (!physical_->get_features().multiDrawIndirect || 
+                        !physical_->get_features().drawIndirectFirstInstance)) {
+            throw std::runtime_error("Indirect drawing is not supported.");
+        }
+        indirect_ = indirect;
+        graph_dirty_ = true;
+    }
+
+    bool get_indirect_drawing() {
+        return indirect_;
+    }
+
+    // Skip the instances outside the view frustum
+    // Culling applies to indirect drawing, whose records are rewritten
+    // with the visible instances every frame
+    void set_culling(bool culling) {
+        culling_ = culling;
+        graph_dirty_ = true;
+    }
+
+    bool get_culling() {
+        return culling_;
+    }
+
+    // Cull on the GPU in a compute pass instead of on the worker threads
+    // The CPU only writes the unculled records, so the stats of a frame
+    // are read once its image comes back around
+    // Requires the drawIndirectCount feature
+    void set_gpu_culling(bool gpu_culling) {
+        if(gpu_culling && !indirect_count_) {
+            throw std::runtime_error("GPU culling requires drawIndirectCount.");
+        }
+        gpu_culling_ = gpu_culling;
+        graph_dirty_ = true;
+    }
+
+    bool get_gpu_culling() {
+        return gpu_culling_;
+    }
+
+    // Also skip the instances hidden behind what was drawn last frame
+    // Applies with GPU culling, those wrongly hidden because the view
+    // or the scene moved are caught by a second pass over this frame's 
+    // depth, so nothing pops
+    void set_occlusion_culling(bool occlusion_culling) {
+        occlusion_culling_ = occlusion_culling;
+        graph_dirty_ = true;
+    }
+
+    bool get_occlusion_culling() {
+        return occlusion_culling_;
     }
 
-    // Testing dynamic subbuffer removal
+    // Get the results of the last frame's culling
+    CullStats &get_cull_stats() {
+        return cull_stats_;
+    }
+
+    // Set the world transform of a model
+    void set_transform(Model model, const glm::mat4 &transform) {
+        const ModelData &data = model_data_.at(model);
+        const DrawGroupData &group = group_data_[data.group];
+        uint32_t slot = group.first_instance + data.instance;
+        instance_objects_[slot].transform = transform;
+        changed_objects(slot, 1);
+        update_bounds(slot, transform, mesh_data_[group.mesh]);
+    }
+
+    // Set the world transforms of many models
+    // The changes reach the GPU as one copy per frame, however many 
+    // models move
+    void set_transforms(const std::vector<Model> &models, 
+                        const std::vector<glm::mat4> &transforms) {
+        for(size_t i = 0; i < models.size(); i++) {
+            set_transform(models[i], transforms[i]);
+        }
+    }
+
+    // Get the world transform of a model
+    const glm::mat4 &get_transform(Model model) {
+        const ModelData &data = model_data_.at(model);
+        return instance_objects_[group_data_[data.group].first_instance + data.instance].transform;
+    }
+
+    // Remove a model
     void remove_model(Model model) {
         if(model_data_.find(model) == model_data_.end()) {
             return;
         }
-        ModelData data = model_data_[model];
-        object_buffer_->delete_subbuffer(data.indexes);
-        object_buffer_->delete_subbuffer(data.vertexes);
-        model_data_.erase(model);
-        record_commands();
+        MeshHandle mesh = group_data_[model_data_[model].group].mesh;
+        remove_instance(model);
+        release_mesh(mesh);
     }
 
     // Load a texture
-    Texture load_texture(std::string filename) {
-        int width, height, channels;
-        stbi_uc *pixels = stbi_load(
-            filename.c_str(), 
-            &width, &height, &channels, 
-            STBI_rgb_alpha
-        );
-        Texture texture = load_texture(pixels, width, height);
-        stbi_image_free(pixels);
+    Texture load_texture(std::string filename, 
+                         const SamplerSettings &sampler = {}) {
+        return load_textures({filename}, sampler)[0];
+    }
+
+    Texture load_texture(unsigned char pixels[], int width, int height,
+                         const SamplerSettings &sampler = {}) {
+        Texture texture = add_texture(
+            create_texture(pixels, width, height, get_mip_levels(width, height)),
+            sampler
+        );
+        queue_texture_write(texture);
         return texture;
     }
 
-    Texture load_texture(unsigned char pixels[], int width, int height) {
-        vk::DeviceSize image_size = width * height * 4;
+    // Load a batch of textures
+    // Files are read and decoded in parallel on the worker threads,
+    // then uploaded together in a single submission
+    std::vector<Texture> load_textures(std::vector<std::string> filenames,
+                                       const SamplerSettings &sampler = {}) {
+        TextureLoadStats stats;
+        std::vector<ImageData> images = decode_images(
+            *workers_, 
+            filenames, 
+            stats
+        );
+
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<TextureUpload> uploads;
+        for(auto &image : images) {
+            uploads.push_back({
+                image.pixels.get(),
+                static_cast<uint32_t>(image.width),
+                static_cast<uint32_t>(image.height),
+                get_mip_levels(image.width, image.height),
+                image.channels
+            });
+        }
+        std::vector<Texture> handles;
+        for(auto &texture : create_textures(uploads)) {
+            handles.push_back(add_texture(std::move(texture), sampler));
+            queue_texture_write(handles.back());
+        }
+        stats.upload_ms = std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - start
+        ).count();
+
+        if constexpr(DEBUG) {
+            std::cerr << "Loaded " << stats.count << " textures:\n";
+            std::cerr << "* I/O " << stats.io_ms << "ms\n";
+            std::cerr << "* Decode " << stats.decode_ms << "ms\n";
+            std::cerr << "* Upload " << stats.upload_ms << "ms\n\n";
+        }
+        texture_stats_.count += stats.count;
+        texture_stats_.io_ms += stats.io_ms;
+        texture_stats_.decode_ms += stats.decode_ms;
+        texture_stats_.upload_ms += stats.upload_ms;
+        return handles;
+    }
+
+    // Load every texture from a pre-baked texture pack
+    // Texel data is copied from the mapped file straight into staging,
+    // skipping decoding and mipmap generation
+    // Pack textures are streamed, only the mip levels that fit the 
+    // texture budget are made resident
+    // Returns the texture handles keyed by their source image paths
+    std::unordered_map<std::string, Texture> load_texture_pack(std::string filename,
+                                                               const SamplerSettings &sampler = {}) {
+        packs_.push_back(std::make_unique<TexturePack>(filename));
+        TexturePack &pack = *packs_.back();
+
+        auto start = std::chrono::high_resolution_clock::now();
+        auto &entries = pack.get_entries();
+        Texture first = textures_.size();
+        for(int i = 0; i < entries.size(); i++) {
+            residency_->add(
+                first + i, 
+                entries[i].width, 
+                entries[i].height, 
+                entries[i].mip_levels
+            );
+            stream_sources_[first + i] = {
+                static_cast<int>(packs_.size() - 1), i
+            };
+        }
+        residency_->update();
+
+        std::vector<TextureUpload> uploads;
+        for(int i = 0; i < entries.size(); i++) {
+            uploads.push_back(get_stream_upload(first + i));
+        }
+        std::unordered_map<std::string, Texture> handles;
+        std::vector<std::unique_ptr<TextureData>> textures = create_textures(uploads);
+        for(int i = 0; i < textures.size(); i++) {
+            add_texture(std::move(textures[i]), sampler);
+            queue_texture_write(first + i);
+            residency_->set_resident(first + i, residency_->get_target(first + i));
+            handles[entries[i].name] = first + i;
+        }
+        double upload_ms = std::chrono::duration<double, std::milli>(
+            std::chrono::high_resolution_clock::now() - start
+        ).count();
+
+        if constexpr(DEBUG) {
+            std::cerr << "Loaded " << entries.size() << " textures from " << filename << ":\n";
+            std::cerr << "* Upload " << upload_ms << "ms\n\n";
+        }
+        texture_stats_.count += entries.size();
+        texture_stats_.upload_ms += upload_ms;
+        return handles;
+    }
+
+    // Load every texture from a texture pack as a virtual texture
+    // Virtual textures are never fully resident, only the pages the 
+    // fragment shader samples are streamed into a shared page cache, 
+    // so memory use is bounded by the cache rather than the textures
+    // The coarsest level of each texture is always kept resident, and 
+    // is sampled while finer pages stream in
+    // Returns the texture handles keyed by their source image paths
+    std::unordered_map<std::string, Texture> load_virtual_textures(std::string filename) {
+        packs_.push_back(std::make_unique<TexturePack>(filename));
+        TexturePack &pack = *packs_.back();
+
+        // Create the page cache on the first load
+        if(!virtual_->get_count()) {
+            uint32_t size = virtual_->get_header().slots * VT_SLOT_SIZE;
+            std::vector<unsigned char> blank(size * size * 4, 0);
+
+            SamplerSettings sampler;
+            sampler.address_mode = vk::SamplerAddressMode::eClampToEdge;
+            sampler.anisotropy = false;
+            Texture cache = add_texture(
+                create_texture(&blank[0], size, size, 1),
+                sampler
+            );
+            virtual_->set_cache(cache);
+            queue_texture_write(cache);
+        }
+
+        std::unordered_map<std::string, Texture> handles;
+        auto &entries = pack.get_entries();
+        for(int i = 0; i < entries.size(); i++) {
+            uint32_t texture = virtual_->add(
+                entries[i].width, 
+                entries[i].height, 
+                entries[i].mip_levels
+            );
+            virtual_sources_.push_back({
+                static_cast<int>(packs_.size() - 1), i
+            });
+            PageId root = virtual_->get_root(texture);
+            int slot = virtual_->place(root, true);
+            if(slot < 0) {
+                throw std::runtime_error("Virtual texture page cache is full.");
+            }
+            upload_virtual_page(root, slot);
+
+            // Virtual texture handles are negative to tell them apart
+            handles[entries[i].name] = -static_cast<Texture>(texture) - 1;
+        }
+        submit_texture_updates();
+
+        // Each image copies the new tables once its frame has finished
+        queue_virtual_changes();
+        return handles;
+    }
+
+    // Get the number of virtual texture pages resident in the cache
+    size_t get_virtual_page_count() {
+        return virtual_->get_resident_count();
+    }
+
+    // Set the memory budget in bytes for textures streamed from packs
+    void set_texture_budget(size_t budget) {
+        residency_->set_budget(budget);
+    }
+
+    // Set the largest size in pixels a streamed texture appears on screen
+    // Mip levels larger than this are not kept resident
+    void set_texture_screen_size(Texture texture, float pixels) {
+        if(residency_->is_tracked(texture)) {
+            residency_->set_screen_size(texture, pixels);
+        }
+    }
+
+    // Get the bytes of device memory allocated for streamed textures
+    // Textures replaced by streaming count until they are freed
+    size_t get_streamed_texture_memory() {
+        size_t size = 0;
+        for(auto &source : stream_sources_) {
+            size += textures_[source.first]->get_memory_size();
+        }
+        for(auto &retired : retired_textures_) {
+            size += retired.texture->get_memory_size();
+        }
+        return size;
+    }
+
+    // Overwrite a region of a texture with tightly packed pixels
+    // Pixels must have the channels stored by the texture
+    // Intended for textures changing every frame, e.g., video or UI
+    // Texels are staged in the frame's region of the staging ring
+    // and copied on the GPU before the next frame is drawn, the 
+    // texture keeps its image and descriptors
+    // If mipmaps is set, only the mip texels covering the region are 
+    // regenerated, otherwise the lower levels are left as they were
+    void update_texture(Texture texture, TextureRect rect, 
+                        const unsigned char pixels[], bool mipmaps = true) {
+        TextureData &data = *textures_.at(texture);
+        uint32_t width = data.get_width();
+        uint32_t height = data.get_height();
+        if(rect.width > width || rect.x > width - rect.width || 
+           rect.height > height || rect.y > height - rect.height) {
+            throw std::runtime_error("Texture update is out of bounds.");
+        }
+        if(stream_sources_.count(texture)) {
+            throw std::runtime_error("Streamed textures cannot be updated.");
+        }
+        size_t row_size = rect.width * data.get_channels();
+        if(row_size > update_size_) {
+            throw std::runtime_error("Texture update rows exceed the staging ring.");
+        }
+        if(!rect.width || !rect.height) {
+            return;
+        }
+        vk::CommandBuffer command_buffer = get_update_commands();
+        data.begin_update(command_buffer, mipmaps);
+
+        // Copy the region in bands of rows
+        stage_elements(
+            pixels,
+            row_size,
+            rect.height,
+            [&](vk::CommandBuffer command_buffer, size_t offset, uint32_t row, uint32_t rows) {
+                data.record_copy(
+                    command_buffer,
+                    update_staging_->get_handle(),
+                    offset,
+                    {rect.x, rect.y + row, rect.width, rows}
+                );
+            }
+        );
+        command_buffer = get_update_commands();
+        data.end_update(command_buffer, rect, mipmaps);
+    }
+
+    // Generate mip levels of new textures in a single compute dispatch 
+    // each, instead of a chain of blits on the graphics queue
+    // If the device has a dedicated compute queue, generation runs there
+    // Textures whose format cannot be written by the compute shader 
+    // still use blits
+    void set_compute_mipmaps(bool compute) {
+        compute_mipmaps_ = compute;
+    }
+
+    bool get_compute_mipmaps() {
+        return compute_mipmaps_;
+    }
+
+    // Wait until the mips still generating on the async compute queue
+    // are ready
+    void wait_compute_mipmaps() {
+        finish_compute_mipmaps();
+    }
+
+    // Get the channels stored per texel of a texture
+    // Grey images are stored with 1 channel when the device supports
+    // it, all others with 4
+    int get_texture_channels(Texture texture) {
+        return textures_.at(texture)->get_channels();
+    }
+
+    // Change how a texture is sampled, e.g., nearest filtering and
+    // clamping for pixel art
+    void set_texture_sampler(Texture texture, const SamplerSettings &sampler) {
+        texture_samplers_.at(texture) = sampler;
+        queue_texture_write(texture);
+    }
+
+    // Get the accumulated timings of all texture loads
+    TextureLoadStats &get_texture_load_stats() {
+        return texture_stats_;
+    }
+
+    // Load a sprite into the atlas
+    Sprite load_sprite(std::string filename) {
+        return load_sprites({filename})[0];
+    }
+
+    // Load a batch of sprites, decoding them in parallel
+    std::vector<Sprite> load_sprites(std::vector<std::string> filenames) {
+        std::vector<ImageData> images = decode_images(
+            *workers_, 
+            filenames, 
+            texture_stats_
+        );
+        std::vector<Sprite> sprites;
+        for(auto &image : images) {
+            std::vector<unsigned char> pixels(image.width * image.height * 4);
+            expand_to_rgba(
+                image.pixels.get(), 
+                &pixels[0], 
+                image.width * image.height, 
+                image.channels
+            );
+            sprites.push_back(
+                load_sprite(&pixels[0], image.width, image.height)
+            );
+        }
+        return sprites;
+    }
+
+    // Pack RGBA pixels into an atlas page
+    // The page is uploaded lazily before the next frame is drawn,
+    // so loading many sprites at once only costs a single upload
+    Sprite load_sprite(unsigned char pixels[], int width, int height) {
         if(!pixels) {
             throw std::runtime_error("Could not load image.");
         }
-        staging_buffer_->clear(0);
-        staging_buffer_->copy(0, pixels, image_size);
 
-        uint32_t mip_levels = std::floor(std::log2(std::max(width, height))) + 1;
-        textures_.push_back(
-            std::make_unique<TextureData>(
-                width, 
-                height,
-                mip_levels,
-                logical_.get(), 
-                *physical_,
-                *image_memory_,
-                *staging_buffer_,
-                graphics_pool_.get(),
-                graphics_queue_
-            )
+        // Images too large for the atlas get their own texture
+        Sprite sprite;
+        if(!atlas_->is_packable(width, height)) {
+            sprite.texture = load_texture(pixels, width, height);
+            return sprite;
+        }
+        if(atlas_->pack(pixels, width, height, sprite)) {
+            return sprite;
+        }
+
+        // All pages are full, reserve a texture for a new one
+        // Pages are clamped since repeating across sprites is meaningless
+        uint32_t page_size = atlas_->get_page_size();
+        std::vector<unsigned char> blank(page_size * page_size * 4, 0);
+
+        SamplerSettings sampler;
+        sampler.address_mode = vk::SamplerAddressMode::eClampToEdge;
+        Texture page = add_texture(
+            create_texture(&blank[0], page_size, page_size, 1),
+            sampler
         );
-        staging_buffer_->clear(0);
-        reset_descriptor_sets();
-        return textures_.size() - 1;
+        queue_texture_write(page);
+        
+        atlas_->add_page(page);
+        atlas_->pack(pixels, width, height, sprite);
+        return sprite;
     }
     
     // Unload a texture
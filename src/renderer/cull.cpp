@@ -0,0 +1,119 @@
+#include "cull.h"
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define RENDER_CULL_SSE
+#endif
+
+Frustum extract_frustum(const glm::mat4 &view_projection) {
+    // Rows of the matrix, which is stored by column
+    glm::vec4 rows[4];
+    for(int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(
+            view_projection[0][i],
+            view_projection[1][i],
+            view_projection[2][i],
+            view_projection[3][i]
+        );
+    }
+
+    Frustum frustum;
+    frustum.planes[0] = rows[3] + rows[0]; // Left
+    frustum.planes[1] = rows[3] - rows[0]; // Right
+    frustum.planes[2] = rows[3] + rows[1]; // Bottom
+    frustum.planes[3] = rows[3] - rows[1]; // Top
+    frustum.planes[4] = rows[2];           // Near
+    frustum.planes[5] = rows[3] - rows[2]; // Far
+
+    // Normalize so that distances to the planes compare with radii
+    for(auto &plane : frustum.planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return frustum;
+}
+
+FrustumCuller::FrustumCuller(ThreadPool &workers) :
+    workers_(workers) {}
+
+void FrustumCuller::resize(uint32_t capacity) {
+    // Pad to whole groups of four
+    capacity = (capacity + 3) & ~3u;
+    x_.resize(capacity, 0);
+    y_.resize(capacity, 0);
+    z_.resize(capacity, 0);
+    radius_.resize(capacity, 0);
+    visible_.resize(capacity, 0);
+}
+
+void FrustumCuller::set_sphere(uint32_t slot, const glm::vec3 &center, float radius) {
+    x_[slot] = center.x;
+    y_[slot] = center.y;
+    z_[slot] = center.z;
+    radius_[slot] = radius;
+}
+
+void FrustumCuller::copy_sphere(uint32_t src, uint32_t dst) {
+    x_[dst] = x_[src];
+    y_[dst] = y_[src];
+    z_[dst] = z_[src];
+    radius_[dst] = radius_[src];
+}
+
+void FrustumCuller::cull_range(const Frustum &frustum, uint32_t begin, uint32_t end) {
+#ifdef RENDER_CULL_SSE
+    for(uint32_t i = begin; i < end; i += 4) {
+        __m128 x = _mm_loadu_ps(&x_[i]);
+        __m128 y = _mm_loadu_ps(&y_[i]);
+        __m128 z = _mm_loadu_ps(&z_[i]);
+        __m128 radius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&radius_[i]));
+
+        // A sphere is outside once it is behind any plane by more
+        // than its radius
+        __m128 inside = _mm_cmpeq_ps(x, x);
+        for(auto &plane : frustum.planes) {
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(
+                    _mm_mul_ps(x, _mm_set1_ps(plane.x)),
+                    _mm_mul_ps(y, _mm_set1_ps(plane.y))
+                ),
+                _mm_add_ps(
+                    _mm_mul_ps(z, _mm_set1_ps(plane.z)),
+                    _mm_set1_ps(plane.w)
+                )
+            );
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, radius));
+        }
+        int mask = _mm_movemask_ps(inside);
+        visible_[i] = mask & 1;
+        visible_[i + 1] = (mask >> 1) & 1;
+        visible_[i + 2] = (mask >> 2) & 1;
+        visible_[i + 3] = (mask >> 3) & 1;
+    }
+#else
+    for(uint32_t i = begin; i < end; i++) {
+        bool inside = true;
+        for(auto &plane : frustum.planes) {
+            float distance = x_[i] * plane.x + y_[i] * plane.y + z_[i] * plane.z + plane.w;
+            inside = inside && distance >= -radius_[i];
+        }
+        visible_[i] = inside;
+    }
+#endif
+}
+
+void FrustumCuller::cull(const Frustum &frustum, uint32_t count) {
+    count = (count + 3) & ~3u;
+    uint32_t tasks = std::max(1u, std::min(
+        workers_.get_size(),
+        (count + CULL_CHUNK_SIZE - 1) / CULL_CHUNK_SIZE
+    ));
+    uint32_t chunk = ((count / tasks + 3) & ~3u);
+    for(uint32_t task = 0; task < tasks; task++) {
+        uint32_t begin = std::min(count, task * chunk);
+        uint32_t end = task + 1 == tasks ? count : std::min(count, begin + chunk);
+        workers_.submit([this, &frustum, begin, end]() {
+            cull_range(frustum, begin, end);
+        });
+    }
+    workers_.wait();
+}
@@ -0,0 +1,72 @@
+#ifndef RENDER_CULL_H_
+#define RENDER_CULL_H_
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+#include "threads.h"
+
+// Fewest spheres tested by a single worker task
+constexpr uint32_t CULL_CHUNK_SIZE = 4096;
+
+// Results of the last frame's culling
+struct CullStats {
+    size_t instances = 0;         // Instances tested
+    size_t visible = 0;           // Instances drawn
+    size_t triangles = 0;         // Triangles of the instances tested
+    size_t visible_triangles = 0; // Triangles of the instances drawn
+    size_t disoccluded = 0;       // Instances drawn by the second occlusion pass
+    double cull_ms = 0;           // Negative if the device cannot time it
+};
+
+// Planes of a view frustum, pointing inwards
+// Each plane is (a, b, c, d) with ax + by + cz + d >= 0 inside
+struct Frustum {
+    glm::vec4 planes[6];
+};
+
+// Extract the frustum of a view-projection matrix with a zero to one
+// depth range
+Frustum extract_frustum(const glm::mat4 &view_projection);
+
+// Tests bounding spheres of instances against a view frustum
+// Spheres are stored as a structure of arrays, so that four of them
+// are tested against a plane at once with SSE, and the slots are
+// split across the worker threads
+class FrustumCuller {
+    ThreadPool &workers_;
+
+    std::vector<float> x_;
+    std::vector<float> y_;
+    std::vector<float> z_;
+    std::vector<float> radius_;
+    std::vector<uint8_t> visible_;
+
+    // Test the spheres of a range of slots, begin must be a multiple of 4
+    void cull_range(const Frustum &frustum, uint32_t begin, uint32_t end);
+
+public:
+    FrustumCuller(ThreadPool &workers);
+
+    // Set the number of slots, keeping the spheres of existing ones
+    void resize(uint32_t capacity);
+
+    // Set the world space bounding sphere of a slot
+    void set_sphere(uint32_t slot, const glm::vec3 &center, float radius);
+
+    // Copy the bounding sphere of a slot to another
+    void copy_sphere(uint32_t src, uint32_t dst);
+
+    // Test the spheres of the first count slots against a frustum
+    void cull(const Frustum &frustum, uint32_t count);
+
+    // Did a slot's sphere intersect the frustum in the last test?
+    bool is_visible(uint32_t slot) {
+        return visible_[slot];
+    }
+};
+
+#endif
@@ -0,0 +1,269 @@
+#include "geometry.h"
+
+RangeAllocator::RangeAllocator(uint32_t capacity) {
+    capacity_ = 0;
+    grow(capacity);
+}
+
+bool RangeAllocator::allocate(uint32_t count, uint32_t &offset) {
+    if(!count) {
+        offset = 0;
+        return true;
+    }
+    for(auto it = free_.begin(); it != free_.end(); it++) {
+        if(it->second < count) {
+            continue;
+        }
+        offset = it->first;
+        uint32_t remaining = it->second - count;
+        free_.erase(it);
+        if(remaining) {
+            free_[offset + count] = remaining;
+        }
+        return true;
+    }
+    return false;
+}
+
+void RangeAllocator::free(uint32_t offset, uint32_t count) {
+    if(!count) {
+        return;
+    }
+    auto next = free_.lower_bound(offset);
+
+    // Merge with the following free range
+    if(next != free_.end() && offset + count == next->first) {
+        count += next->second;
+        next = free_.erase(next);
+    }
+
+    // Merge with the preceding free range
+    if(next != free_.begin()) {
+        auto prev = std::prev(next);
+        if(prev->first + prev->second == offset) {
+            prev->second += count;
+            return;
+        }
+    }
+    free_[offset] = count;
+}
+
+void RangeAllocator::grow(uint32_t capacity) {
+    if(capacity > capacity_) {
+        uint32_t offset = capacity_;
+        capacity_ = capacity;
+        free(offset, capacity - offset);
+    }
+}
+
+uint32_t RangeAllocator::get_capacity() {
+    return capacity_;
+}
+
+GeometryBuffer::GeometryBuffer(vk::Device &logical,
+                               PhysicalDevice &physical,
+                               uint32_t vertex_capacity,
+                               uint32_t index_capacity) :
+    physical_(physical),
+    vertices_(vertex_capacity),
+    indices_(index_capacity) {
+    logical_ = logical;
+    create_buffer(
+        vertex_capacity * sizeof(Vertex),
+        vk::BufferUsageFlagBits::eVertexBuffer,
+        vertex_buffer_,
+        vertex_memory_
+    );
+    create_buffer(
+        index_capacity * sizeof(uint32_t),
+        vk::BufferUsageFlagBits::eIndexBuffer,
+        index_buffer_,
+        index_memory_
+    );
+}
+
+void GeometryBuffer::create_buffer(vk::DeviceSize size,
+                                   vk::BufferUsageFlags usage,
+                                   vk::UniqueBuffer &buffer,
+                                   vk::UniqueDeviceMemory &memory) {
+    vk::BufferCreateInfo buffer_info;
+    buffer_info.size = size;
+    buffer_info.usage = usage |
+                        vk::BufferUsageFlagBits::eTransferSrc |
+                        vk::BufferUsageFlagBits::eTransferDst;
+    buffer = logical_.createBufferUnique(buffer_info);
+
+    auto requirements = logical_.getBufferMemoryRequirements(buffer.get());
+    auto &device_spec = physical_.get_memory();
+    int memory_type = -1;
+    for(uint32_t i = 0; i < device_spec.memoryTypeCount; i++) {
+        if((requirements.memoryTypeBits & (1 << i)) &&
+           (device_spec.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal)) {
+            memory_type = i;
+            break;
+        }
+    }
+    if(memory_type < 0) {
+        throw std::runtime_error("Vulkan failed to create geometry buffer.");
+    }
+
+    vk::MemoryAllocateInfo mem_alloc_info;
+    mem_alloc_info.allocationSize = requirements.size;
+    mem_alloc_info.memoryTypeIndex = memory_type;
+    memory = logical_.allocateMemoryUnique(mem_alloc_info);
+    logical_.bindBufferMemory(buffer.get(), memory.get(), 0);
+}
+
+bool GeometryBuffer::allocate(uint32_t vertex_count, uint32_t index_count,
+                              GeometryRange &range) {
+    range.vertex_count = vertex_count;
+    range.index_count = index_count;
+    if(!vertices_.allocate(vertex_count, range.first_vertex)) {
+        return false;
+    }
+    if(!indices_.allocate(index_count, range.first_index)) {
+        vertices_.free(range.first_vertex, vertex_count);
+        return false;
+    }
+    return true;
+}
+
+void GeometryBuffer::free(const GeometryRange &range) {
+    vertices_.free(range.first_vertex, range.vertex_count);
+    indices_.free(range.first_index, range.index_count);
+}
+
+void GeometryBuffer::grow(vk::CommandBuffer &command_buffer,
+                          uint32_t vertex_count,
+                          uint32_t index_count) {
+    // Double the capacity, or more if the mesh still would not fit
+    uint32_t vertex_capacity = std::max(
+        vertices_.get_capacity() * 2,
+        vertices_.get_capacity() + vertex_count
+    );
+    uint32_t index_capacity = std::max(
+        indices_.get_capacity() * 2,
+        indices_.get_capacity() + index_count
+    );
+
+    vk::UniqueBuffer vertex_buffer;
+    vk::UniqueDeviceMemory vertex_memory;
+    create_buffer(
+        vertex_capacity * sizeof(Vertex),
+        vk::BufferUsageFlagBits::eVertexBuffer,
+        vertex_buffer,
+        vertex_memory
+    );
+    vk::UniqueBuffer index_buffer;
+    vk::UniqueDeviceMemory index_memory;
+    create_buffer(
+        index_capacity * sizeof(uint32_t),
+        vk::BufferUsageFlagBits::eIndexBuffer,
+        index_buffer,
+        index_memory
+    );
+
+    // Copy the old contents after any pending uploads into them, then
+    // make them visible to draws
+    vk::MemoryBarrier barrier;
+    barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
+    command_buffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::DependencyFlags(),
+        barrier, nullptr, nullptr
+    );
+    command_buffer.copyBuffer(
+        vertex_buffer_.get(),
+        vertex_buffer.get(),
+        vk::BufferCopy(0, 0, vertices_.get_capacity() * sizeof(Vertex))
+    );
+    command_buffer.copyBuffer(
+        index_buffer_.get(),
+        index_buffer.get(),
+        vk::BufferCopy(0, 0, indices_.get_capacity() * sizeof(uint32_t))
+    );
+    end_upload(command_buffer);
+
+    retired_buffers_.push_back(std::move(vertex_buffer_));
+    retired_buffers_.push_back(std::move(index_buffer_));
+    retired_memory_.push_back(std::move(vertex_memory_));
+    retired_memory_.push_back(std::move(index_memory_));
+    vertex_buffer_ = std::move(vertex_buffer);
+    vertex_memory_ = std::move(vertex_memory);
+    index_buffer_ = std::move(index_buffer);
+    index_memory_ = std::move(index_memory);
+
+    vertices_.grow(vertex_capacity);
+    indices_.grow(index_capacity);
+}
+
+void GeometryBuffer::release() {
+    retired_buffers_.clear();
+    retired_memory_.clear();
+}
+
+void GeometryBuffer::begin_upload(vk::CommandBuffer &command_buffer) {
+    command_buffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eVertexInput,
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::DependencyFlags(),
+        nullptr, nullptr, nullptr
+    );
+}
+
+void GeometryBuffer::record_vertex_copy(vk::CommandBuffer &command_buffer,
+                                        vk::Buffer staging,
+                                        vk::DeviceSize offset,
+                                        const GeometryRange &range,
+                                        uint32_t first,
+                                        uint32_t count) {
+    command_buffer.copyBuffer(
+        staging,
+        vertex_buffer_.get(),
+        vk::BufferCopy(
+            offset,
+            (range.first_vertex + first) * sizeof(Vertex),
+            count * sizeof(Vertex)
+        )
+    );
+}
+
+void GeometryBuffer::record_index_copy(vk::CommandBuffer &command_buffer,
+                                       vk::Buffer staging,
+                                       vk::DeviceSize offset,
+                                       const GeometryRange &range,
+                                       uint32_t first,
+                                       uint32_t count) {
+    command_buffer.copyBuffer(
+        staging,
+        index_buffer_.get(),
+        vk::BufferCopy(
+            offset,
+            (range.first_index + first) * sizeof(uint32_t),
+            count * sizeof(uint32_t)
+        )
+    );
+}
+
+void GeometryBuffer::end_upload(vk::CommandBuffer &command_buffer) {
+    vk::MemoryBarrier barrier;
+    barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    barrier.dstAccessMask = vk::AccessFlagBits::eVertexAttributeRead |
+                            vk::AccessFlagBits::eIndexRead;
+    command_buffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eVertexInput,
+        vk::DependencyFlags(),
+        barrier, nullptr, nullptr
+    );
+}
+
+vk::Buffer GeometryBuffer::get_vertex_buffer() {
+    return vertex_buffer_.get();
+}
+
+vk::Buffer GeometryBuffer::get_index_buffer() {
+    return index_buffer_.get();
+}
@@ -0,0 +1,126 @@
+#ifndef RENDER_GEOMETRY_H_
+#define RENDER_GEOMETRY_H_
+#define VULKAN_HPP_TYPESAFE_CONVERSION
+
+#include <vulkan/vulkan.hpp>
+
+#include <map>
+#include <vector>
+#include <stdexcept>
+
+#include "physical.h"
+#include "vertex.h"
+
+// Allocates ranges of elements from a fixed capacity
+// Freed ranges are merged with their free neighbors
+class RangeAllocator {
+    // Offsets of the free ranges mapped to their lengths
+    std::map<uint32_t, uint32_t> free_;
+    uint32_t capacity_;
+
+public:
+    RangeAllocator(uint32_t capacity);
+
+    // Allocate the first free range that fits count elements
+    // Returns false if none fits
+    bool allocate(uint32_t count, uint32_t &offset);
+
+    // Free a previously allocated range
+    void free(uint32_t offset, uint32_t count);
+
+    // Extend the capacity, the new elements are free
+    void grow(uint32_t capacity);
+
+    // Get the number of elements
+    uint32_t get_capacity();
+};
+
+// Location of a mesh in the geometry buffer, in elements
+struct GeometryRange {
+    uint32_t first_vertex = 0;
+    uint32_t vertex_count = 0;
+    uint32_t first_index = 0;
+    uint32_t index_count = 0;
+};
+
+// Device local vertex and index buffers holding the meshes of all models
+// Meshes start at whole elements, so they can be drawn from a single
+// binding of each buffer with vertexOffset and firstIndex
+class GeometryBuffer {
+    vk::Device logical_;
+    PhysicalDevice &physical_;
+
+    vk::UniqueBuffer vertex_buffer_;
+    vk::UniqueDeviceMemory vertex_memory_;
+    vk::UniqueBuffer index_buffer_;
+    vk::UniqueDeviceMemory index_memory_;
+
+    RangeAllocator vertices_;
+    RangeAllocator indices_;
+
+    // Buffers replaced by growing, kept until their copies have finished
+    std::vector<vk::UniqueBuffer> retired_buffers_;
+    std::vector<vk::UniqueDeviceMemory> retired_memory_;
+
+    // Create a device local buffer
+    void create_buffer(vk::DeviceSize size,
+                       vk::BufferUsageFlags usage,
+                       vk::UniqueBuffer &buffer,
+                       vk::UniqueDeviceMemory &memory);
+
+public:
+    GeometryBuffer(vk::Device &logical,
+                   PhysicalDevice &physical,
+                   uint32_t vertex_capacity,
+                   uint32_t index_capacity);
+
+    // Allocate the ranges of a mesh
+    // Returns false if either buffer is too full
+    bool allocate(uint32_t vertex_count, uint32_t index_count, GeometryRange &range);
+
+    // Free the ranges of a mesh
+    void free(const GeometryRange &range);
+
+    // Grow the buffers so that a mesh of the given size fits, recording
+    // the copy of the old contents
+    // The old buffers must not be in use by any pending commands
+    void grow(vk::CommandBuffer &command_buffer,
+              uint32_t vertex_count,
+              uint32_t index_count);
+
+    // Free the buffers replaced by growing, once the copies have finished
+    void release();
+
+    // Record the barrier ordering uploads after earlier draws, which
+    // may still read a freed range
+    void begin_upload(vk::CommandBuffer &command_buffer);
+
+    // Record copying vertices from a staging buffer into a mesh's range,
+    // starting at its first-th vertex
+    void record_vertex_copy(vk::CommandBuffer &command_buffer,
+                            vk::Buffer staging,
+                            vk::DeviceSize offset,
+                            const GeometryRange &range,
+                            uint32_t first,
+                            uint32_t count);
+
+    // Record copying indices from a staging buffer into a mesh's range,
+    // starting at its first-th index
+    void record_index_copy(vk::CommandBuffer &command_buffer,
+                           vk::Buffer staging,
+                           vk::DeviceSize offset,
+                           const GeometryRange &range,
+                           uint32_t first,
+                           uint32_t count);
+
+    // Record the barrier making uploads visible to later draws
+    void end_upload(vk::CommandBuffer &command_buffer);
+
+    // Get the handle to the vertex buffer
+    vk::Buffer get_vertex_buffer();
+
+    // Get the handle to the index buffer
+    vk::Buffer get_index_buffer();
+};
+
+#endif
@@ -0,0 +1,236 @@
+#include "gpucull.h"
+
+GpuCuller::GpuCuller(vk::Device &logical,
+                     PhysicalDevice &physical,
+                     PipelineCache &cache,
+                     std::string shader) : physical_(physical),
+                                           cache_(cache) {
+    logical_ = logical;
+    timestamps_ = physical_.get_limits().timestampComputeAndGraphics;
+    create_layout();
+    create_pipeline(shader);
+}
+
+void GpuCuller::create_layout() {
+    std::vector<vk::DescriptorSetLayoutBinding> bindings(7);
+    for(uint32_t i = 0; i < bindings.size(); i++) {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = vk::DescriptorType::eStorageBuffer;
+        bindings[i].stageFlags = vk::ShaderStageFlagBits::eCompute;
+    }
+    bindings[0].descriptorType = vk::DescriptorType::eUniformBuffer;
+    bindings[6].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+
+    vk::DescriptorSetLayoutCreateInfo descriptor_layout_info;
+    descriptor_layout_info.bindingCount = bindings.size();
+    descriptor_layout_info.pBindings = &bindings[0];
+    descriptor_layout_ = logical_.createDescriptorSetLayoutUnique(
+        descriptor_layout_info
+    );
+
+    vk::PushConstantRange push_constant_range;
+    push_constant_range.stageFlags = vk::ShaderStageFlagBits::eCompute;
+    push_constant_range.offset = 0;
+    push_constant_range.size = sizeof(CullData);
+
+    vk::PipelineLayoutCreateInfo layout_info;
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = &descriptor_layout_.get();
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &push_constant_range;
+    layout_ = logical_.createPipelineLayoutUnique(layout_info);
+}
+
+void GpuCuller::create_pipeline(std::string filename) {
+    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+    if(!file.is_open()) {
+        throw std::runtime_error("Failed to load shader: " + filename);
+    }
+
+    size_t size = file.tellg();
+    std::vector<char> bytes(size);
+
+    file.seekg(0);
+    file.read(&bytes[0], size);
+    file.close();
+
+    vk::ShaderModuleCreateInfo shader_info;
+    shader_info.codeSize = bytes.size();
+    shader_info.pCode = reinterpret_cast<uint32_t *>(&bytes[0]);
+    vk::UniqueShaderModule shader_module = logical_.createShaderModuleUnique(
+        shader_info
+    );
+
+    vk::ComputePipelineCreateInfo pipeline_info;
+    pipeline_info.stage.stage = vk::ShaderStageFlagBits::eCompute;
+    pipeline_info.stage.module = shader_module.get();
+    pipeline_info.stage.pName = "main";
+    pipeline_info.layout = layout_.get();
+    pipeline_ = cache_.create_compute_pipeline(pipeline_info);
+}
+
+void GpuCuller::set_buffers(const std::vector<GpuCullBuffers> &buffers) {
+    uint32_t sets = buffers.size() * 2;
+    descriptor_sets_.clear();
+    buffers_.resize(buffers.size());
+
+    std::vector<vk::DescriptorPoolSize> pool_sizes = {
+        {vk::DescriptorType::eUniformBuffer, sets},
+        {vk::DescriptorType::eStorageBuffer, sets * 5},
+        {vk::DescriptorType::eCombinedImageSampler, sets}
+    };
+    vk::DescriptorPoolCreateInfo pool_info;
+    pool_info.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
+    pool_info.maxSets = sets;
+    pool_info.poolSizeCount = pool_sizes.size();
+    pool_info.pPoolSizes = &pool_sizes[0];
+    descriptor_pool_ = logical_.createDescriptorPoolUnique(pool_info);
+
+    std::vector<vk::DescriptorSetLayout> layouts(sets, descriptor_layout_.get());
+    vk::DescriptorSetAllocateInfo descriptor_alloc_info;
+    descriptor_alloc_info.descriptorPool = descriptor_pool_.get();
+    descriptor_alloc_info.descriptorSetCount = sets;
+    descriptor_alloc_info.pSetLayouts = &layouts[0];
+    descriptor_sets_ = logical_.allocateDescriptorSetsUnique(descriptor_alloc_info);
+
+    timed_.assign(sets, false);
+    if(timestamps_) {
+        vk::QueryPoolCreateInfo query_info;
+        query_info.queryType = vk::QueryType::eTimestamp;
+        query_info.queryCount = sets * 2;
+        queries_ = logical_.createQueryPoolUnique(query_info);
+    }
+
+    for(uint32_t image = 0; image < buffers.size(); image++) {
+        set_image_buffers(image, buffers[image]);
+    }
+}
+
+void GpuCuller::set_image_buffers(uint32_t image, const GpuCullBuffers &buffers) {
+    buffers_[image] = buffers;
+
+    // The passes only differ in the records they append to
+    for(uint32_t set = image * 2; set < image * 2 + 2; set++) {
+        const vk::DescriptorBufferInfo *infos[] = {
+            &buffers.uniforms,
+            &buffers.objects,
+            &buffers.records,
+            set % 2 ? &buffers.disoccluded : &buffers.culled,
+            &buffers.instances,
+            &buffers.visibility
+        };
+        std::vector<vk::WriteDescriptorSet> writes(7);
+        for(uint32_t binding = 0; binding < 6; binding++) {
+            writes[binding].dstSet = descriptor_sets_[set].get();
+            writes[binding].dstBinding = binding;
+            writes[binding].dstArrayElement = 0;
+            writes[binding].descriptorCount = 1;
+            writes[binding].descriptorType = vk::DescriptorType::eStorageBuffer;
+            writes[binding].pBufferInfo = infos[binding];
+        }
+        writes[0].descriptorType = vk::DescriptorType::eUniformBuffer;
+
+        writes[6].dstSet = descriptor_sets_[set].get();
+        writes[6].dstBinding = 6;
+        writes[6].dstArrayElement = 0;
+        writes[6].descriptorCount = 1;
+        writes[6].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+        writes[6].pImageInfo = &buffers.pyramid;
+        logical_.updateDescriptorSets(writes, nullptr);
+    }
+}
+
+void GpuCuller::record_cull(vk::CommandBuffer command_buffer,
+                            uint32_t image,
+                            CullPass pass,
+                            bool occlusion,
+                            uint32_t max_records) {
+    const GpuCullBuffers &buffers = buffers_[image];
+    const vk::DescriptorBufferInfo &culled = pass == CullPass::Visible ? 
+                                             buffers.culled :
+                                             buffers.disoccluded;
+    CullData cull = {
+        static_cast<uint32_t>(pass),
+        occlusion
+    };
+    uint32_t set = image * 2 + cull.pass;
+    if(timestamps_) {
+        command_buffer.resetQueryPool(queries_.get(), set * 2, 2);
+        command_buffer.writeTimestamp(
+            vk::PipelineStageFlagBits::eTopOfPipe,
+            queries_.get(),
+            set * 2
+        );
+        timed_[set] = true;
+    }
+
+    // Reset the counts of the compacted records
+    command_buffer.fillBuffer(
+        culled.buffer,
+        culled.offset,
+        sizeof(CulledHeader),
+        0
+    );
+    vk::MemoryBarrier reset_barrier;
+    reset_barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    reset_barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead |
+                                  vk::AccessFlagBits::eShaderWrite;
+    command_buffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags(),
+        reset_barrier, nullptr, nullptr
+    );
+
+    command_buffer.bindPipeline(
+        vk::PipelineBindPoint::eCompute,
+        pipeline_.get()
+    );
+    command_buffer.bindDescriptorSets(
+        vk::PipelineBindPoint::eCompute,
+        layout_.get(),
+        0, descriptor_sets_[set].get(), nullptr
+    );
+    command_buffer.pushConstants(
+        layout_.get(),
+        vk::ShaderStageFlagBits::eCompute,
+        0,
+        sizeof(cull),
+        &cull
+    );
+    command_buffer.dispatch(
+        std::max(1u, std::min(max_records, GPUCULL_MAX_WORKGROUPS)), 1, 1
+    );
+    if(timestamps_) {
+        command_buffer.writeTimestamp(
+            vk::PipelineStageFlagBits::eComputeShader,
+            queries_.get(),
+            set * 2 + 1
+        );
+    }
+}
+
+double GpuCuller::get_cull_ms(uint32_t image, CullPass pass) {
+    if(!timestamps_) {
+        return -1;
+    }
+    uint32_t set = image * 2 + static_cast<uint32_t>(pass);
+    uint64_t timestamps[2];
+    if(!timed_[set] ||
+       logical_.getQueryPoolResults(
+           queries_.get(),
+           set * 2,
+           2,
+           sizeof(timestamps),
+           timestamps,
+           sizeof(uint64_t),
+           vk::QueryResultFlagBits::e64
+       ) != vk::Result::eSuccess) {
+        return 0;
+    }
+
+    // Ticks are timestampPeriod nanoseconds each
+    double period = physical_.get_limits().timestampPeriod;
+    return (timestamps[1] - timestamps[0]) * period / 1000000.0;
+}
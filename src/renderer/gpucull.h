@@ -0,0 +1,115 @@
+#ifndef RENDER_GPUCULL_H_
+#define RENDER_GPUCULL_H_
+#define VULKAN_HPP_TYPESAFE_CONVERSION
+
+#include <vulkan/vulkan.hpp>
+
+#include <vector>
+#include <fstream>
+#include <algorithm>
+
+#include "physical.h"
+#include "pipecache.h"
+
+// Workgroups dispatched per culling pass at most, each loops over
+// the draw records past this count
+constexpr uint32_t GPUCULL_MAX_WORKGROUPS = 4096;
+
+// Header of the compacted draw records, padded to the record stride
+// The draw count is read by drawIndexedIndirectCount
+struct CulledHeader {
+    uint32_t draw_count;
+    uint32_t visible_count;
+    uint32_t triangle_count;
+    uint32_t reserved[2];
+};
+
+// Passes of occlusion culling
+// The first draws what was visible against the last frame's depth
+// pyramid, the second what turns out visible against this frame's
+enum class CullPass {
+    Visible = 0,
+    Disoccluded = 1
+};
+
+// Buffers read and written by the culling pass of a swapchain image
+struct GpuCullBuffers {
+    vk::DescriptorBufferInfo uniforms;    // Frustum planes
+    vk::DescriptorBufferInfo objects;     // Per-instance bounding spheres
+    vk::DescriptorBufferInfo records;     // Count, then a record per draw group
+    vk::DescriptorBufferInfo culled;      // CulledHeader, then the visible records
+    vk::DescriptorBufferInfo instances;   // Object data slot per instance index
+    vk::DescriptorBufferInfo disoccluded; // CulledHeader, then the second pass' records
+    vk::DescriptorBufferInfo visibility;  // Result of the first pass per slot
+    vk::DescriptorImageInfo pyramid;      // Depth pyramid
+};
+
+// Culls instances against the view frustum in a compute shader
+// Each workgroup takes a draw record, compacts its visible instances
+// to the start of the record's instance range, and appends the record
+// with the visible count, so the draws need no per-instance CPU work
+class GpuCuller {
+    struct CullData {
+        uint32_t pass;
+        uint32_t occlusion;
+    };
+
+    vk::Device logical_;
+    PhysicalDevice &physical_;
+    PipelineCache &cache_;
+
+    vk::UniqueDescriptorSetLayout descriptor_layout_;
+    vk::UniquePipelineLayout layout_;
+    vk::UniquePipeline pipeline_;
+
+    // A descriptor set per pass of each image
+    vk::UniqueDescriptorPool descriptor_pool_;
+    std::vector<vk::UniqueDescriptorSet> descriptor_sets_;
+    std::vector<GpuCullBuffers> buffers_;
+
+    // A pair of timestamps around each pass of each image, and whether
+    // the pass was ever recorded so its results can be read
+    vk::UniqueQueryPool queries_;
+    std::vector<bool> timed_;
+    bool timestamps_;
+
+    // Create the layout of the culling buffers
+    void create_layout();
+
+    // Create the compute pipeline from the compiled shader
+    void create_pipeline(std::string filename);
+
+public:
+    GpuCuller(vk::Device &logical,
+              PhysicalDevice &physical,
+              PipelineCache &cache,
+              std::string shader);
+
+    // Point the descriptor set of each swapchain image at its buffers
+    // Reallocates every set, so no frame may be in flight
+    void set_buffers(const std::vector<GpuCullBuffers> &buffers);
+
+    // Point the descriptor sets of a swapchain image at its recreated
+    // buffers
+    // Its frame must have finished, and its commands be recorded again
+    void set_image_buffers(uint32_t image, const GpuCullBuffers &buffers);
+
+    // Record a culling pass of an image, outside of a render pass
+    // Writes the culled buffer from the transfer and compute stages,
+    // and the instance indices and visibility from the compute stage,
+    // the barriers around it are left to the caller
+    // With occlusion, the first pass also tests against the depth
+    // pyramid, leaving the occluded instances for the second
+    void record_cull(vk::CommandBuffer command_buffer,
+                     uint32_t image,
+                     CullPass pass,
+                     bool occlusion,
+                     uint32_t max_records);
+
+    // Get the GPU time of an image's last culling pass
+    // Its frame must have finished, negative if timestamps are not
+    // supported
+    double get_cull_ms(uint32_t image, CullPass pass);
+};
+
+#endif
@@ -0,0 +1,733 @@
+#include "graph.h"
+
+// Accesses that make a barrier necessary after them
+constexpr vk::AccessFlags GRAPH_WRITE_ACCESS = vk::AccessFlagBits::eShaderWrite |
+                                               vk::AccessFlagBits::eColorAttachmentWrite |
+                                               vk::AccessFlagBits::eDepthStencilAttachmentWrite |
+                                               vk::AccessFlagBits::eTransferWrite |
+                                               vk::AccessFlagBits::eHostWrite |
+                                               vk::AccessFlagBits::eMemoryWrite;
+
+// Get the aspects a barrier must cover for an image's format
+vk::ImageAspectFlags get_barrier_aspect(const GraphImageInfo &info) {
+    vk::ImageAspectFlags aspect = info.aspect;
+    if(aspect & vk::ImageAspectFlagBits::eDepth) {
+        if(info.format == vk::Format::eD16UnormS8Uint ||
+           info.format == vk::Format::eD24UnormS8Uint ||
+           info.format == vk::Format::eD32SfloatS8Uint) {
+            aspect |= vk::ImageAspectFlagBits::eStencil;
+        }
+    }
+    return aspect;
+}
+
+RenderGraph::RenderGraph(vk::Device &logical, PhysicalDevice &physical) : physical_(physical) {
+    logical_ = logical;
+    transient_size_ = 0;
+    aliased_size_ = 0;
+    frames_ = 0;
+    compiled_ = false;
+}
+
+GraphResource RenderGraph::create_image(const std::string &name, const GraphImageInfo &info) {
+    Resource resource;
+    resource.name = name;
+    resource.image = true;
+    resource.imported = false;
+    resource.info = info;
+    resources_.push_back(std::move(resource));
+    return resources_.size() - 1;
+}
+
+GraphResource RenderGraph::import_image(const std::string &name,
+                                        const GraphImageInfo &info,
+                                        const std::vector<vk::Image> &images,
+                                        const std::vector<vk::ImageView> &views,
+                                        vk::ImageLayout initial_layout,
+                                        vk::ImageLayout final_layout) {
+    Resource resource;
+    resource.name = name;
+    resource.image = true;
+    resource.imported = true;
+    resource.info = info;
+    resource.images = images;
+    resource.views = views;
+    resource.initial_layout = initial_layout;
+    resource.final.layout = final_layout;
+    resources_.push_back(std::move(resource));
+    return resources_.size() - 1;
+}
+
+GraphResource RenderGraph::import_buffer(const std::string &name,
+                                         vk::PipelineStageFlags final_stages,
+                                         vk::AccessFlags final_access) {
+    Resource resource;
+    resource.name = name;
+    resource.image = false;
+    resource.imported = true;
+    resource.final.stages = final_stages;
+    resource.final.access = final_access;
+    resources_.push_back(std::move(resource));
+    return resources_.size() - 1;
+}
+
+void RenderGraph::set_output(GraphResource resource) {
+    resources_[resource].output = true;
+}
+
+GraphPass RenderGraph::add_pass(const std::string &name,
+                                vk::PipelineBindPoint bind_point,
+                                GraphRecordFunction record) {
+    Pass pass;
+    pass.name = name;
+    pass.bind_point = bind_point;
+    pass.record = record;
+    passes_.push_back(std::move(pass));
+    return passes_.size() - 1;
+}
+
+void RenderGraph::use(GraphPass pass,
+                      GraphResource resource,
+                      GraphUsage usage,
+                      vk::PipelineStageFlags stages) {
+    if(!stages) {
+        if(passes_[pass].bind_point == vk::PipelineBindPoint::eCompute) {
+            stages = vk::PipelineStageFlagBits::eComputeShader;
+        }
+        else {
+            stages = vk::PipelineStageFlagBits::eVertexShader |
+                     vk::PipelineStageFlagBits::eFragmentShader;
+        }
+    }
+    if(usage == GraphUsage::StorageRead || usage == GraphUsage::StorageWrite) {
+        resources_[resource].general = true;
+    }
+    passes_[pass].uses.push_back({resource, usage, stages});
+}
+
+void RenderGraph::clear(GraphPass pass, GraphResource resource, vk::ClearValue value) {
+    passes_[pass].clears.emplace_back(resource, value);
+}
+
+void RenderGraph::set_secondary(GraphPass pass) {
+    passes_[pass].secondary = true;
+}
+
+bool RenderGraph::is_cleared(const Pass &pass, GraphResource resource) {
+    for(auto &clear : pass.clears) {
+        if(clear.first == resource) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool RenderGraph::is_write(const Use &use) {
+    return use.usage == GraphUsage::ColorAttachment ||
+           use.usage == GraphUsage::DepthAttachment ||
+           use.usage == GraphUsage::ResolveAttachment ||
+           use.usage == GraphUsage::StorageWrite;
+}
+
+bool RenderGraph::is_read(const Pass &pass, const Use &use) {
+    switch(use.usage) {
+    case GraphUsage::ColorAttachment:
+    case GraphUsage::DepthAttachment:
+        return !is_cleared(pass, use.resource);
+    case GraphUsage::ResolveAttachment:
+        return false;
+    default:
+        return true;
+    }
+}
+
+bool RenderGraph::is_persistent(const Resource &resource) {
+    return resource.imported &&
+           (!resource.image || resource.initial_layout != vk::ImageLayout::eUndefined);
+}
+
+RenderGraph::Access RenderGraph::get_access(const Pass &pass, const Use &use) {
+    const Resource &resource = resources_[use.resource];
+    Access access;
+    switch(use.usage) {
+    case GraphUsage::ColorAttachment:
+        access.stages = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+        access.access = vk::AccessFlagBits::eColorAttachmentWrite;
+        if(!is_cleared(pass, use.resource)) {
+            access.access |= vk::AccessFlagBits::eColorAttachmentRead;
+        }
+        access.layout = vk::ImageLayout::eColorAttachmentOptimal;
+        break;
+    case GraphUsage::DepthAttachment:
+        access.stages = vk::PipelineStageFlagBits::eEarlyFragmentTests |
+                        vk::PipelineStageFlagBits::eLateFragmentTests;
+        access.access = vk::AccessFlagBits::eDepthStencilAttachmentRead |
+                        vk::AccessFlagBits::eDepthStencilAttachmentWrite;
+        access.layout = vk::ImageLayout::eDepthStencilAttachmentOptimal;
+        break;
+    case GraphUsage::ResolveAttachment:
+        access.stages = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+        access.access = vk::AccessFlagBits::eColorAttachmentWrite;
+        access.layout = vk::ImageLayout::eColorAttachmentOptimal;
+        break;
+    case GraphUsage::Sampled:
+        access.stages = use.stages;
+        access.access = vk::AccessFlagBits::eShaderRead;
+        access.layout = resource.general ? vk::ImageLayout::eGeneral :
+                                           vk::ImageLayout::eShaderReadOnlyOptimal;
+        break;
+    case GraphUsage::StorageRead:
+        access.stages = use.stages;
+        access.access = vk::AccessFlagBits::eShaderRead;
+        access.layout = vk::ImageLayout::eGeneral;
+        break;
+    case GraphUsage::StorageWrite:
+        access.stages = use.stages;
+        access.access = vk::AccessFlagBits::eShaderRead |
+                        vk::AccessFlagBits::eShaderWrite;
+        access.layout = vk::ImageLayout::eGeneral;
+        break;
+    case GraphUsage::IndirectRead:
+        access.stages = vk::PipelineStageFlagBits::eDrawIndirect;
+        access.access = vk::AccessFlagBits::eIndirectCommandRead;
+        break;
+    }
+    if(!resource.image) {
+        access.layout = vk::ImageLayout::eUndefined;
+    }
+    return access;
+}
+
+void RenderGraph::cull_passes() {
+    std::vector<bool> needed(resources_.size(), false);
+    for(GraphResource resource = 0; resource < resources_.size(); resource++) {
+        needed[resource] = resources_[resource].output;
+    }
+
+    // Walk back from the outputs, keeping the passes that write what
+    // a kept pass reads
+    for(int index = passes_.size() - 1; index >= 0; index--) {
+        Pass &pass = passes_[index];
+        pass.live = false;
+        for(auto &use : pass.uses) {
+            if(is_write(use) && needed[use.resource]) {
+                pass.live = true;
+            }
+        }
+        if(!pass.live) {
+            continue;
+        }
+        for(auto &use : pass.uses) {
+            if(is_read(pass, use)) {
+                needed[use.resource] = true;
+            }
+        }
+    }
+}
+
+void RenderGraph::find_lifetimes() {
+    std::vector<Access> last(resources_.size());
+    for(GraphPass index = 0; index < passes_.size(); index++) {
+        Pass &pass = passes_[index];
+        if(!pass.live) {
+            continue;
+        }
+        for(auto &use : pass.uses) {
+            Resource &resource = resources_[use.resource];
+            if(resource.first_pass < 0) {
+                resource.first_pass = index;
+            }
+            resource.last_pass = index;
+            last[use.resource] = get_access(pass, use);
+        }
+    }
+
+    // Each frame waits for the previous one's last use of a resource,
+    // or its final access if it has one
+    for(GraphResource index = 0; index < resources_.size(); index++) {
+        Resource &resource = resources_[index];
+        resource.start = last[index];
+        if(resource.final.stages) {
+            resource.start.stages = resource.final.stages;
+            resource.start.access = resource.final.access;
+        }
+        resource.start.layout = resource.imported ? resource.initial_layout :
+                                                    vk::ImageLayout::eUndefined;
+    }
+}
+
+void RenderGraph::create_transients() {
+    std::vector<GraphResource> transients;
+    for(GraphResource index = 0; index < resources_.size(); index++) {
+        Resource &resource = resources_[index];
+        if(resource.imported || resource.first_pass < 0) {
+            continue;
+        }
+
+        // Usage follows from what the live passes do with it
+        vk::ImageUsageFlags usage = resource.info.usage;
+        for(auto &pass : passes_) {
+            if(!pass.live) {
+                continue;
+            }
+            for(auto &use : pass.uses) {
+                if(use.resource != index) {
+                    continue;
+                }
+                switch(use.usage) {
+                case GraphUsage::ColorAttachment:
+                case GraphUsage::ResolveAttachment:
+                    usage |= vk::ImageUsageFlagBits::eColorAttachment;
+                    break;
+                case GraphUsage::DepthAttachment:
+                    usage |= vk::ImageUsageFlagBits::eDepthStencilAttachment;
+                    break;
+                case GraphUsage::Sampled:
+                    usage |= vk::ImageUsageFlagBits::eSampled;
+                    break;
+                default:
+                    usage |= vk::ImageUsageFlagBits::eStorage;
+                    break;
+                }
+            }
+        }
+        resource.transient = ::create_image(
+            logical_,
+            resource.info.extent.width,
+            resource.info.extent.height,
+            resource.info.levels,
+            resource.info.format,
+            vk::ImageTiling::eOptimal,
+            usage,
+            resource.info.samples
+        );
+        resource.requirements = logical_.getImageMemoryRequirements(
+            resource.transient.get()
+        );
+        transients.push_back(index);
+    }
+
+    // Place the largest images first, each in the first slot of its
+    // memory type whose images are all used at other times
+    std::sort(transients.begin(), transients.end(), [&](GraphResource a, GraphResource b) {
+        return resources_[a].requirements.size > resources_[b].requirements.size;
+    });
+    auto &memory_properties = physical_.get_memory();
+    std::vector<AliasSlot> slots;
+    vk::DeviceSize requested = 0;
+    for(GraphResource index : transients) {
+        Resource &resource = resources_[index];
+        int memory_type = -1;
+        for(uint32_t i = 0; i < memory_properties.memoryTypeCount; i++) {
+            if((resource.requirements.memoryTypeBits & (1 << i)) &&
+               (memory_properties.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal)) {
+                memory_type = i;
+                break;
+            }
+        }
+        if(memory_type < 0) {
+            throw std::runtime_error("Vulkan failed to allocate memory for a transient image.");
+        }
+        requested += resource.requirements.size;
+
+        AliasSlot *slot = nullptr;
+        for(auto &candidate : slots) {
+            if(candidate.memory_type != memory_type) {
+                continue;
+            }
+            bool disjoint = true;
+            for(GraphResource other : candidate.resources) {
+                if(resource.first_pass <= resources_[other].last_pass &&
+                   resources_[other].first_pass <= resource.last_pass) {
+                    disjoint = false;
+                }
+            }
+            if(disjoint) {
+                slot = &candidate;
+                break;
+            }
+        }
+        if(!slot) {
+            slots.emplace_back();
+            slot = &slots.back();
+            slot->memory_type = memory_type;
+        }
+        slot->size = std::max(slot->size, resource.requirements.size);
+        slot->alignment = std::max(slot->alignment, resource.requirements.alignment);
+        slot->resources.push_back(index);
+    }
+
+    // A single allocation per memory type holds all of its slots
+    memory_.clear();
+    transient_size_ = 0;
+    for(uint32_t memory_type = 0; memory_type < memory_properties.memoryTypeCount; memory_type++) {
+        vk::DeviceSize size = 0;
+        for(auto &slot : slots) {
+            if(slot.memory_type == memory_type) {
+                slot.offset = (size + slot.alignment - 1) / slot.alignment * slot.alignment;
+                size = slot.offset + slot.size;
+            }
+        }
+        if(!size) {
+            continue;
+        }
+        vk::MemoryAllocateInfo alloc_info;
+        alloc_info.allocationSize = size;
+        alloc_info.memoryTypeIndex = memory_type;
+        memory_.push_back(logical_.allocateMemoryUnique(alloc_info));
+        transient_size_ += size;
+
+        for(auto &slot : slots) {
+            if(slot.memory_type != memory_type) {
+                continue;
+            }
+
+            // Images taking over a slot wait for the last use of the
+            // one before them, the first for the previous frame's last
+            std::sort(slot.resources.begin(), slot.resources.end(), [&](GraphResource a, GraphResource b) {
+                return resources_[a].first_pass < resources_[b].first_pass;
+            });
+            std::vector<Access> ends;
+            for(GraphResource index : slot.resources) {
+                ends.push_back(resources_[index].start);
+            }
+            for(uint32_t i = 0; i < slot.resources.size(); i++) {
+                Resource &resource = resources_[slot.resources[i]];
+                Access previous = ends[(i + ends.size() - 1) % ends.size()];
+                resource.start.stages = previous.stages;
+                resource.start.access = previous.access;
+
+                logical_.bindImageMemory(
+                    resource.transient.get(),
+                    memory_.back().get(),
+                    slot.offset
+                );
+                vk::Image image = resource.transient.get();
+                resource.transient_view = create_view(
+                    logical_,
+                    image,
+                    resource.info.format,
+                    resource.info.aspect,
+                    resource.info.levels
+                );
+            }
+        }
+    }
+    aliased_size_ = requested - std::min(requested, transient_size_);
+}
+
+void RenderGraph::create_render_pass(GraphPass index) {
+    Pass &pass = passes_[index];
+    std::vector<vk::AttachmentDescription> attachments;
+    std::vector<vk::AttachmentReference> color_refs;
+    std::vector<vk::AttachmentReference> resolve_refs;
+    vk::AttachmentReference depth_ref;
+    bool has_depth = false;
+    std::vector<GraphResource> attached;
+
+    for(auto &use : pass.uses) {
+        if(use.usage != GraphUsage::ColorAttachment &&
+           use.usage != GraphUsage::DepthAttachment &&
+           use.usage != GraphUsage::ResolveAttachment) {
+            continue;
+        }
+        Resource &resource = resources_[use.resource];
+        Access access = get_access(pass, use);
+
+        // Keep the contents that an earlier pass or frame left, and
+        // those a later pass or frame needs
+        bool written = is_persistent(resource) || resource.first_pass < index;
+        bool needed = is_persistent(resource) || resource.output || resource.last_pass > index;
+
+        vk::AttachmentDescription attachment;
+        attachment.format = resource.info.format;
+        attachment.samples = resource.info.samples;
+        if(is_cleared(pass, use.resource)) {
+            attachment.loadOp = vk::AttachmentLoadOp::eClear;
+        }
+        else {
+            attachment.loadOp = written ? vk::AttachmentLoadOp::eLoad :
+                                          vk::AttachmentLoadOp::eDontCare;
+        }
+        attachment.storeOp = needed ? vk::AttachmentStoreOp::eStore :
+                                      vk::AttachmentStoreOp::eDontCare;
+        attachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
+        attachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
+
+        // Layouts are changed by the graph's barriers, not the pass
+        attachment.initialLayout = access.layout;
+        attachment.finalLayout = access.layout;
+
+        vk::AttachmentReference ref;
+        ref.attachment = attachments.size();
+        ref.layout = access.layout;
+        if(use.usage == GraphUsage::ColorAttachment) {
+            color_refs.push_back(ref);
+        }
+        else if(use.usage == GraphUsage::ResolveAttachment) {
+            resolve_refs.push_back(ref);
+        }
+        else {
+            depth_ref = ref;
+            has_depth = true;
+        }
+        attachments.push_back(attachment);
+        attached.push_back(use.resource);
+        pass.attachments.push_back({
+            use.usage,
+            attachment.format,
+            attachment.samples
+        });
+
+        vk::ClearValue clear_value;
+        for(auto &clear : pass.clears) {
+            if(clear.first == use.resource) {
+                clear_value = clear.second;
+            }
+        }
+        pass.clear_values.push_back(clear_value);
+        pass.extent = resource.info.extent;
+    }
+    if(!resolve_refs.empty() && resolve_refs.size() != color_refs.size()) {
+        throw std::runtime_error("Render graph pass " + pass.name + " must resolve every color attachment.");
+    }
+
+    vk::SubpassDescription subpass;
+    subpass.pipelineBindPoint = vk::PipelineBindPoint::eGraphics;
+    subpass.colorAttachmentCount = color_refs.size();
+    subpass.pColorAttachments = color_refs.data();
+    subpass.pResolveAttachments = resolve_refs.empty() ? nullptr : resolve_refs.data();
+    subpass.pDepthStencilAttachment = has_depth ? &depth_ref : nullptr;
+
+    vk::RenderPassCreateInfo render_pass_info;
+    render_pass_info.attachmentCount = attachments.size();
+    render_pass_info.pAttachments = attachments.data();
+    render_pass_info.subpassCount = 1;
+    render_pass_info.pSubpasses = &subpass;
+    pass.render_pass = logical_.createRenderPassUnique(render_pass_info);
+
+    for(uint32_t frame = 0; frame < frames_; frame++) {
+        std::vector<vk::ImageView> views;
+        for(GraphResource resource : attached) {
+            views.push_back(get_view(resource, frame));
+        }
+        vk::FramebufferCreateInfo framebuffer_info;
+        framebuffer_info.renderPass = pass.render_pass.get();
+        framebuffer_info.attachmentCount = views.size();
+        framebuffer_info.pAttachments = views.data();
+        framebuffer_info.width = pass.extent.width;
+        framebuffer_info.height = pass.extent.height;
+        framebuffer_info.layers = 1;
+        pass.framebuffers.push_back(
+            logical_.createFramebufferUnique(framebuffer_info)
+        );
+    }
+}
+
+void RenderGraph::compile(uint32_t frames) {
+    if(compiled_) {
+        throw std::runtime_error("Render graph is already compiled.");
+    }
+    frames_ = frames;
+    cull_passes();
+    find_lifetimes();
+    create_transients();
+    for(GraphPass index = 0; index < passes_.size(); index++) {
+        if(passes_[index].live && passes_[index].bind_point == vk::PipelineBindPoint::eGraphics) {
+            create_render_pass(index);
+        }
+    }
+    compiled_ = true;
+}
+
+void RenderGraph::add_barrier(GraphResource index,
+                              uint32_t frame,
+                              Access &state,
+                              const Access &next,
+                              vk::PipelineStageFlags &src_stages,
+                              vk::PipelineStageFlags &dst_stages,
+                              vk::MemoryBarrier &memory_barrier,
+                              std::vector<vk::ImageMemoryBarrier> &image_barriers) {
+    Resource &resource = resources_[index];
+    bool hazard = (state.access & GRAPH_WRITE_ACCESS) || (next.access & GRAPH_WRITE_ACCESS);
+    bool transition = resource.image && state.layout != next.layout;
+    if(!hazard && !transition) {
+        // Reads after reads only gather the stages a write must wait for
+        state.stages |= next.stages;
+        state.access |= next.access;
+        return;
+    }
+
+    // Without an earlier use, chain onto whatever came before the graph
+    src_stages |= state.stages ? state.stages : next.stages;
+    dst_stages |= next.stages;
+    if(resource.image) {
+        vk::ImageMemoryBarrier barrier;
+        barrier.srcAccessMask = state.access & GRAPH_WRITE_ACCESS;
+        barrier.dstAccessMask = next.access;
+        barrier.oldLayout = state.layout;
+        barrier.newLayout = next.layout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = get_image(index, frame);
+        barrier.subresourceRange.aspectMask = get_barrier_aspect(resource.info);
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = resource.info.levels;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+        image_barriers.push_back(barrier);
+    }
+    else if(state.access & GRAPH_WRITE_ACCESS) {
+        memory_barrier.srcAccessMask |= state.access & GRAPH_WRITE_ACCESS;
+        memory_barrier.dstAccessMask |= next.access;
+    }
+    state = next;
+}
+
+void RenderGraph::execute(vk::CommandBuffer command_buffer, uint32_t frame) {
+    std::vector<Access> states(resources_.size());
+    for(GraphResource index = 0; index < resources_.size(); index++) {
+        states[index] = resources_[index].start;
+    }
+
+    for(auto &pass : passes_) {
+        if(!pass.live) {
+            continue;
+        }
+        vk::PipelineStageFlags src_stages;
+        vk::PipelineStageFlags dst_stages;
+        vk::MemoryBarrier memory_barrier;
+        std::vector<vk::ImageMemoryBarrier> image_barriers;
+        for(auto &use : pass.uses) {
+            add_barrier(
+                use.resource,
+                frame,
+                states[use.resource],
+                get_access(pass, use),
+                src_stages,
+                dst_stages,
+                memory_barrier,
+                image_barriers
+            );
+        }
+        if(dst_stages) {
+            command_buffer.pipelineBarrier(
+                src_stages,
+                dst_stages,
+                vk::DependencyFlags(),
+                memory_barrier,
+                nullptr,
+                image_barriers
+            );
+        }
+
+        if(pass.bind_point == vk::PipelineBindPoint::eGraphics) {
+            vk::RenderPassBeginInfo begin_info;
+            begin_info.renderPass = pass.render_pass.get();
+            begin_info.framebuffer = pass.framebuffers[frame].get();
+            begin_info.renderArea.offset.x = 0;
+            begin_info.renderArea.offset.y = 0;
+            begin_info.renderArea.extent = pass.extent;
+            begin_info.clearValueCount = pass.clear_values.size();
+            begin_info.pClearValues = pass.clear_values.data();
+            command_buffer.beginRenderPass(
+                begin_info,
+                pass.secondary ? vk::SubpassContents::eSecondaryCommandBuffers :
+                                 vk::SubpassContents::eInline
+            );
+            pass.record(command_buffer, frame);
+            command_buffer.endRenderPass();
+        }
+        else {
+            pass.record(command_buffer, frame);
+        }
+    }
+
+    // Hand the imported resources back in their final state
+    vk::PipelineStageFlags src_stages;
+    vk::PipelineStageFlags dst_stages;
+    vk::MemoryBarrier memory_barrier;
+    std::vector<vk::ImageMemoryBarrier> image_barriers;
+    for(GraphResource index = 0; index < resources_.size(); index++) {
+        Resource &resource = resources_[index];
+        if(!resource.imported || resource.first_pass < 0) {
+            continue;
+        }
+        bool relayout = resource.image &&
+                        resource.final.layout != vk::ImageLayout::eUndefined &&
+                        resource.final.layout != states[index].layout;
+        if(!relayout && !resource.final.stages) {
+            continue;
+        }
+        Access end = resource.final;
+        if(!end.stages) {
+            end.stages = vk::PipelineStageFlagBits::eBottomOfPipe;
+        }
+        if(!resource.image) {
+            end.layout = vk::ImageLayout::eUndefined;
+        }
+        else if(end.layout == vk::ImageLayout::eUndefined) {
+            end.layout = states[index].layout;
+        }
+        add_barrier(
+            index,
+            frame,
+            states[index],
+            end,
+            src_stages,
+            dst_stages,
+            memory_barrier,
+            image_barriers
+        );
+    }
+    if(dst_stages) {
+        command_buffer.pipelineBarrier(
+            src_stages,
+            dst_stages,
+            vk::DependencyFlags(),
+            memory_barrier,
+            nullptr,
+            image_barriers
+        );
+    }
+}
+
+bool RenderGraph::is_live(GraphPass pass) {
+    return passes_[pass].live;
+}
+
+vk::RenderPass RenderGraph::get_render_pass(GraphPass pass) {
+    return passes_[pass].render_pass.get();
+}
+
+const std::vector<GraphAttachment> &RenderGraph::get_attachments(GraphPass pass) {
+    return passes_[pass].attachments;
+}
+
+vk::Framebuffer RenderGraph::get_framebuffer(GraphPass pass, uint32_t frame) {
+    return passes_[pass].framebuffers[frame].get();
+}
+
+vk::Image RenderGraph::get_image(GraphResource resource, uint32_t frame) {
+    Resource &data = resources_[resource];
+    if(!data.imported) {
+        return data.transient.get();
+    }
+    return data.images[frame % data.images.size()];
+}
+
+vk::ImageView RenderGraph::get_view(GraphResource resource, uint32_t frame) {
+    Resource &data = resources_[resource];
+    if(!data.imported) {
+        return data.transient_view.get();
+    }
+    return data.views[frame % data.views.size()];
+}
+
+vk::DeviceSize RenderGraph::get_transient_size() {
+    return transient_size_;
+}
+
+vk::DeviceSize RenderGraph::get_aliased_size() {
+    return aliased_size_;
+}
@@ -0,0 +1,265 @@
+#ifndef RENDER_GRAPH_H_
+#define RENDER_GRAPH_H_
+#define VULKAN_HPP_TYPESAFE_CONVERSION
+
+#include <vulkan/vulkan.hpp>
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <algorithm>
+
+#include "image.h"
+#include "physical.h"
+
+// Handles to the resources and passes of a render graph
+using GraphResource = int;
+using GraphPass = int;
+
+// How a pass uses a resource
+enum class GraphUsage {
+    ColorAttachment,   // Color attachment of a graphics pass
+    DepthAttachment,   // Depth attachment of a graphics pass
+    ResolveAttachment, // Resolve target of the pass' color attachment
+    Sampled,           // Image read through a sampler
+    StorageRead,       // Storage image or buffer read by shaders
+    StorageWrite,      // Storage image or buffer written by shaders
+    IndirectRead       // Buffer of indirect draw parameters
+};
+
+// Description of an image in a render graph
+struct GraphImageInfo {
+    vk::Format format = vk::Format::eUndefined;
+    vk::Extent2D extent;
+    vk::SampleCountFlagBits samples = vk::SampleCountFlagBits::e1;
+    vk::ImageAspectFlags aspect = vk::ImageAspectFlagBits::eColor;
+    uint32_t levels = 1;
+
+    // Added to the usage derived from the passes
+    vk::ImageUsageFlags usage = {};
+};
+
+// Attachment of a graphics pass, as far as pipelines are concerned
+// Render passes whose attachments all match are compatible, so the
+// same pipelines can be used with either
+struct GraphAttachment {
+    GraphUsage usage;
+    vk::Format format;
+    vk::SampleCountFlagBits samples;
+
+    bool operator==(const GraphAttachment &other) const {
+        return usage == other.usage &&
+               format == other.format &&
+               samples == other.samples;
+    }
+};
+
+// Records the commands of a pass for a frame
+using GraphRecordFunction = std::function<void(vk::CommandBuffer, uint32_t)>;
+
+// Frame graph of render and compute passes
+// Passes declare the resources they use, and compiling the graph
+// derives everything in between: passes whose results are never used
+// are culled, render passes and framebuffers are created with the load
+// and store ops the uses call for, and transient images whose
+// lifetimes do not overlap share memory
+// Executing it records each live pass after the barriers and layout
+// transitions its uses need
+// A graph is declared then compiled once, and rebuilt when its shape
+// changes
+class RenderGraph {
+    // Pipeline state a resource is accessed in
+    struct Access {
+        vk::PipelineStageFlags stages;
+        vk::AccessFlags access;
+        vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+    };
+
+    struct Use {
+        GraphResource resource;
+        GraphUsage usage;
+        vk::PipelineStageFlags stages;
+    };
+
+    struct Resource {
+        std::string name;
+        bool image;
+        bool imported;
+        bool output = false;
+        GraphImageInfo info;
+
+        // Imported images and views, per frame or one for all frames
+        std::vector<vk::Image> images;
+        std::vector<vk::ImageView> views;
+        vk::ImageLayout initial_layout = vk::ImageLayout::eUndefined;
+        Access final;
+
+        // Images created by the graph
+        vk::UniqueImage transient;
+        vk::UniqueImageView transient_view;
+        vk::MemoryRequirements requirements;
+
+        // First and last live passes using the resource
+        int first_pass = -1;
+        int last_pass = -1;
+
+        // Sampled in the general layout, as it is also a storage image
+        bool general = false;
+
+        // State left by the previous frame
+        Access start;
+    };
+
+    struct Pass {
+        std::string name;
+        vk::PipelineBindPoint bind_point;
+        GraphRecordFunction record;
+        std::vector<Use> uses;
+        std::vector<std::pair<GraphResource, vk::ClearValue>> clears;
+        bool secondary = false;
+        bool live = false;
+
+        vk::UniqueRenderPass render_pass;
+        std::vector<vk::UniqueFramebuffer> framebuffers;
+        std::vector<vk::ClearValue> clear_values;
+        std::vector<GraphAttachment> attachments;
+        vk::Extent2D extent;
+    };
+
+    // Memory shared by transient images with disjoint lifetimes
+    struct AliasSlot {
+        uint32_t memory_type;
+        vk::DeviceSize size = 0;
+        vk::DeviceSize alignment = 1;
+        vk::DeviceSize offset = 0;
+        std::vector<GraphResource> resources;
+    };
+
+    vk::Device logical_;
+    PhysicalDevice &physical_;
+
+    std::vector<Resource> resources_;
+    std::vector<Pass> passes_;
+    std::vector<vk::UniqueDeviceMemory> memory_;
+    vk::DeviceSize transient_size_;
+    vk::DeviceSize aliased_size_;
+    uint32_t frames_;
+    bool compiled_;
+
+    // Get the state a use accesses its resource in
+    Access get_access(const Pass &pass, const Use &use);
+
+    // Does a pass clear an attachment when it begins?
+    bool is_cleared(const Pass &pass, GraphResource resource);
+
+    // Does a use write its resource?
+    bool is_write(const Use &use);
+
+    // Does a use read what earlier passes wrote to its resource?
+    bool is_read(const Pass &pass, const Use &use);
+
+    // Does a resource keep its contents from before the frame?
+    bool is_persistent(const Resource &resource);
+
+    // Mark the passes that contribute to an output as live
+    void cull_passes();
+
+    // Find the live passes each resource is used by, and the state
+    // each frame starts from
+    void find_lifetimes();
+
+    // Create the transient images, aliasing their memory
+    void create_transients();
+
+    // Create the render pass and framebuffers of a graphics pass
+    void create_render_pass(GraphPass index);
+
+    // Add the barrier a resource needs to go from its state to a use's
+    void add_barrier(GraphResource resource,
+                     uint32_t frame,
+                     Access &state,
+                     const Access &next,
+                     vk::PipelineStageFlags &src_stages,
+                     vk::PipelineStageFlags &dst_stages,
+                     vk::MemoryBarrier &memory_barrier,
+                     std::vector<vk::ImageMemoryBarrier> &image_barriers);
+
+public:
+    RenderGraph(vk::Device &logical, PhysicalDevice &physical);
+
+    // Declare an image created and owned by the graph
+    // Its contents only live within a frame
+    GraphResource create_image(const std::string &name, const GraphImageInfo &info);
+
+    // Declare an image owned elsewhere, one per frame or one shared
+    // The graph transitions it to its final layout at the end of a frame,
+    // and expects it back in its initial layout at the start
+    GraphResource import_image(const std::string &name,
+                               const GraphImageInfo &info,
+                               const std::vector<vk::Image> &images,
+                               const std::vector<vk::ImageView> &views,
+                               vk::ImageLayout initial_layout,
+                               vk::ImageLayout final_layout);
+
+    // Declare a buffer owned elsewhere, tracked for its barriers
+    // The final access makes its contents available after the frame
+    GraphResource import_buffer(const std::string &name,
+                                vk::PipelineStageFlags final_stages = {},
+                                vk::AccessFlags final_access = {});
+
+    // Mark a resource as a result of the frame, keeping the passes
+    // that write it
+    void set_output(GraphResource resource);
+
+    // Add a pass, recorded in the order passes are added
+    GraphPass add_pass(const std::string &name,
+                       vk::PipelineBindPoint bind_point,
+                       GraphRecordFunction record);
+
+    // Declare a pass' use of a resource
+    // Shader stages default to compute for compute passes, and vertex
+    // and fragment for graphics passes
+    void use(GraphPass pass,
+             GraphResource resource,
+             GraphUsage usage,
+             vk::PipelineStageFlags stages = {});
+
+    // Clear an attachment of a graphics pass when it begins
+    void clear(GraphPass pass, GraphResource resource, vk::ClearValue value);
+
+    // Draw a graphics pass from secondary command buffers
+    void set_secondary(GraphPass pass);
+
+    // Cull the passes, create the resources, render passes and
+    // framebuffers for a number of frames
+    void compile(uint32_t frames);
+
+    // Record the live passes of a frame with their barriers
+    void execute(vk::CommandBuffer command_buffer, uint32_t frame);
+
+    // Was a pass kept after culling?
+    bool is_live(GraphPass pass);
+
+    // Get the render pass of a graphics pass
+    vk::RenderPass get_render_pass(GraphPass pass);
+
+    // Get the attachments of a graphics pass, in render pass order
+    const std::vector<GraphAttachment> &get_attachments(GraphPass pass);
+
+    // Get the framebuffer of a graphics pass for a frame
+    vk::Framebuffer get_framebuffer(GraphPass pass, uint32_t frame);
+
+    // Get the image of a resource for a frame
+    vk::Image get_image(GraphResource resource, uint32_t frame);
+
+    // Get the view of an image for a frame
+    vk::ImageView get_view(GraphResource resource, uint32_t frame);
+
+    // Get the bytes of memory bound to transient images
+    vk::DeviceSize get_transient_size();
+
+    // Get the bytes of transient images saved by aliasing
+    vk::DeviceSize get_aliased_size();
+};
+
+#endif
@@ -0,0 +1,318 @@
+#include "hiz.h"
+
+DepthPyramid::DepthPyramid(vk::Device &logical,
+                           PhysicalDevice &physical,
+                           PipelineCache &cache,
+                           ImageMemoryAllocator &memory,
+                           std::string shader) : physical_(physical),
+                                                 cache_(cache),
+                                                 memory_(memory) {
+    logical_ = logical;
+    levels_ = 0;
+    samples_ = 1;
+
+    // Nearest filtering, levels are picked explicitly by the shaders
+    vk::SamplerCreateInfo sampler_info;
+    sampler_info.magFilter = vk::Filter::eNearest;
+    sampler_info.minFilter = vk::Filter::eNearest;
+    sampler_info.mipmapMode = vk::SamplerMipmapMode::eNearest;
+    sampler_info.addressModeU = vk::SamplerAddressMode::eClampToEdge;
+    sampler_info.addressModeV = vk::SamplerAddressMode::eClampToEdge;
+    sampler_info.addressModeW = vk::SamplerAddressMode::eClampToEdge;
+    sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+    sampler_ = logical_.createSamplerUnique(sampler_info);
+
+    create_layout();
+    create_pipeline(shader);
+}
+
+void DepthPyramid::create_layout() {
+    vk::DescriptorSetLayoutBinding depth_binding;
+    depth_binding.binding = 0;
+    depth_binding.descriptorCount = 1;
+    depth_binding.descriptorType = vk::DescriptorType::eCombinedImageSampler;
+    depth_binding.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+    vk::DescriptorSetLayoutBinding src_binding;
+    src_binding.binding = 1;
+    src_binding.descriptorCount = 1;
+    src_binding.descriptorType = vk::DescriptorType::eStorageImage;
+    src_binding.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+    vk::DescriptorSetLayoutBinding dst_binding;
+    dst_binding.binding = 2;
+    dst_binding.descriptorCount = 1;
+    dst_binding.descriptorType = vk::DescriptorType::eStorageImage;
+    dst_binding.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+    std::vector<vk::DescriptorSetLayoutBinding> bindings = {
+        depth_binding,
+        src_binding,
+        dst_binding
+    };
+    vk::DescriptorSetLayoutCreateInfo descriptor_layout_info;
+    descriptor_layout_info.bindingCount = bindings.size();
+    descriptor_layout_info.pBindings = &bindings[0];
+    descriptor_layout_ = logical_.createDescriptorSetLayoutUnique(
+        descriptor_layout_info
+    );
+
+    vk::PushConstantRange push_constant_range;
+    push_constant_range.stageFlags = vk::ShaderStageFlagBits::eCompute;
+    push_constant_range.offset = 0;
+    push_constant_range.size = sizeof(ReduceData);
+
+    vk::PipelineLayoutCreateInfo layout_info;
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = &descriptor_layout_.get();
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &push_constant_range;
+    layout_ = logical_.createPipelineLayoutUnique(layout_info);
+}
+
+void DepthPyramid::create_pipeline(std::string filename) {
+    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+    if(!file.is_open()) {
+        throw std::runtime_error("Failed to load shader: " + filename);
+    }
+
+    size_t size = file.tellg();
+    std::vector<char> bytes(size);
+
+    file.seekg(0);
+    file.read(&bytes[0], size);
+    file.close();
+
+    vk::ShaderModuleCreateInfo shader_info;
+    shader_info.codeSize = bytes.size();
+    shader_info.pCode = reinterpret_cast<uint32_t *>(&bytes[0]);
+    vk::UniqueShaderModule shader_module = logical_.createShaderModuleUnique(
+        shader_info
+    );
+
+    vk::ComputePipelineCreateInfo pipeline_info;
+    pipeline_info.stage.stage = vk::ShaderStageFlagBits::eCompute;
+    pipeline_info.stage.module = shader_module.get();
+    pipeline_info.stage.pName = "main";
+    pipeline_info.layout = layout_.get();
+    pipeline_ = cache_.create_compute_pipeline(pipeline_info);
+}
+
+vk::Extent2D DepthPyramid::get_level_extent(uint32_t level) {
+    return vk::Extent2D(
+        std::max(1u, extent_.width >> level),
+        std::max(1u, extent_.height >> level)
+    );
+}
+
+void DepthPyramid::resize(vk::Extent2D extent, vk::SampleCountFlagBits samples) {
+    depth_extent_ = extent;
+    samples_ = static_cast<uint32_t>(samples);
+
+    // Largest power of two that fits in the depth buffer
+    extent_ = vk::Extent2D(1, 1);
+    while(extent_.width * 2 <= extent.width) extent_.width *= 2;
+    while(extent_.height * 2 <= extent.height) extent_.height *= 2;
+    levels_ = 1;
+    while((std::max(extent_.width, extent_.height) >> levels_) > 0) {
+        levels_++;
+    }
+
+    descriptor_sets_.clear();
+    level_views_.clear();
+    view_.reset();
+    if(image_) {
+        memory_.remove_image(memory_handle_);
+    }
+    image_ = create_image(
+        logical_,
+        extent_.width,
+        extent_.height,
+        levels_,
+        vk::Format::eR32Sfloat,
+        vk::ImageTiling::eOptimal,
+        vk::ImageUsageFlagBits::eStorage |
+        vk::ImageUsageFlagBits::eSampled |
+        vk::ImageUsageFlagBits::eTransferDst,
+        vk::SampleCountFlagBits::e1
+    );
+    memory_handle_ = memory_.allocate_memory(image_.get());
+    view_ = create_view(
+        logical_,
+        image_.get(),
+        vk::Format::eR32Sfloat,
+        vk::ImageAspectFlagBits::eColor,
+        levels_
+    );
+
+    for(uint32_t level = 0; level < levels_; level++) {
+        vk::ImageViewCreateInfo view_info;
+        view_info.image = image_.get();
+        view_info.viewType = vk::ImageViewType::e2D;
+        view_info.format = vk::Format::eR32Sfloat;
+        view_info.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+        view_info.subresourceRange.baseMipLevel = level;
+        view_info.subresourceRange.levelCount = 1;
+        view_info.subresourceRange.baseArrayLayer = 0;
+        view_info.subresourceRange.layerCount = 1;
+        level_views_.push_back(logical_.createImageViewUnique(view_info));
+    }
+
+    std::vector<vk::DescriptorPoolSize> pool_sizes = {
+        {vk::DescriptorType::eCombinedImageSampler, levels_},
+        {vk::DescriptorType::eStorageImage, levels_ * 2}
+    };
+    vk::DescriptorPoolCreateInfo pool_info;
+    pool_info.flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet;
+    pool_info.maxSets = levels_;
+    pool_info.poolSizeCount = pool_sizes.size();
+    pool_info.pPoolSizes = &pool_sizes[0];
+    descriptor_pool_ = logical_.createDescriptorPoolUnique(pool_info);
+
+    std::vector<vk::DescriptorSetLayout> layouts(levels_, descriptor_layout_.get());
+    vk::DescriptorSetAllocateInfo descriptor_alloc_info;
+    descriptor_alloc_info.descriptorPool = descriptor_pool_.get();
+    descriptor_alloc_info.descriptorSetCount = levels_;
+    descriptor_alloc_info.pSetLayouts = &layouts[0];
+    descriptor_sets_ = logical_.allocateDescriptorSetsUnique(descriptor_alloc_info);
+}
+
+void DepthPyramid::set_depth(vk::ImageView depth_view) {
+    // Level 0 reads the depth buffer, the source binding is unused
+    for(uint32_t level = 0; level < levels_; level++) {
+        vk::DescriptorImageInfo depth_info;
+        depth_info.sampler = sampler_.get();
+        depth_info.imageView = depth_view;
+        depth_info.imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+
+        vk::DescriptorImageInfo src_info;
+        src_info.imageView = level_views_[level ? level - 1 : 0].get();
+        src_info.imageLayout = vk::ImageLayout::eGeneral;
+
+        vk::DescriptorImageInfo dst_info;
+        dst_info.imageView = level_views_[level].get();
+        dst_info.imageLayout = vk::ImageLayout::eGeneral;
+
+        const vk::DescriptorImageInfo *infos[] = {
+            &depth_info,
+            &src_info,
+            &dst_info
+        };
+        std::vector<vk::WriteDescriptorSet> writes(3);
+        for(uint32_t binding = 0; binding < writes.size(); binding++) {
+            writes[binding].dstSet = descriptor_sets_[level].get();
+            writes[binding].dstBinding = binding;
+            writes[binding].dstArrayElement = 0;
+            writes[binding].descriptorCount = 1;
+            writes[binding].descriptorType = vk::DescriptorType::eStorageImage;
+            writes[binding].pImageInfo = infos[binding];
+        }
+        writes[0].descriptorType = vk::DescriptorType::eCombinedImageSampler;
+        logical_.updateDescriptorSets(writes, nullptr);
+    }
+}
+
+void DepthPyramid::record_clear(vk::CommandBuffer command_buffer) {
+    vk::ImageSubresourceRange range;
+    range.aspectMask = vk::ImageAspectFlagBits::eColor;
+    range.baseMipLevel = 0;
+    range.levelCount = levels_;
+    range.baseArrayLayer = 0;
+    range.layerCount = 1;
+
+    vk::ImageMemoryBarrier barrier;
+    barrier.srcAccessMask = {};
+    barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
+    barrier.oldLayout = vk::ImageLayout::eUndefined;
+    barrier.newLayout = vk::ImageLayout::eGeneral;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image_.get();
+    barrier.subresourceRange = range;
+    command_buffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTopOfPipe,
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::DependencyFlags(),
+        nullptr, nullptr,
+        barrier
+    );
+
+    vk::ClearColorValue far;
+    far.setFloat32({1, 1, 1, 1});
+    command_buffer.clearColorImage(
+        image_.get(),
+        vk::ImageLayout::eGeneral,
+        far,
+        range
+    );
+
+    barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
+    barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+    barrier.oldLayout = vk::ImageLayout::eGeneral;
+    command_buffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::DependencyFlags(),
+        nullptr, nullptr,
+        barrier
+    );
+}
+
+void DepthPyramid::record_build(vk::CommandBuffer command_buffer) {
+    command_buffer.bindPipeline(
+        vk::PipelineBindPoint::eCompute,
+        pipeline_.get()
+    );
+    for(uint32_t level = 0; level < levels_; level++) {
+        vk::Extent2D src = level ? get_level_extent(level - 1) : depth_extent_;
+        vk::Extent2D dst = get_level_extent(level);
+        ReduceData reduce = {
+            static_cast<int32_t>(src.width),
+            static_cast<int32_t>(src.height),
+            static_cast<int32_t>(dst.width),
+            static_cast<int32_t>(dst.height),
+            static_cast<int32_t>(level),
+            static_cast<int32_t>(samples_)
+        };
+        command_buffer.bindDescriptorSets(
+            vk::PipelineBindPoint::eCompute,
+            layout_.get(),
+            0, descriptor_sets_[level].get(), nullptr
+        );
+        command_buffer.pushConstants(
+            layout_.get(),
+            vk::ShaderStageFlagBits::eCompute,
+            0,
+            sizeof(reduce),
+            &reduce
+        );
+        command_buffer.dispatch((dst.width + 7) / 8, (dst.height + 7) / 8, 1);
+
+        // Each level reads the one written before it
+        vk::MemoryBarrier level_barrier;
+        level_barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+        level_barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
+        command_buffer.pipelineBarrier(
+            vk::PipelineStageFlagBits::eComputeShader,
+            vk::PipelineStageFlagBits::eComputeShader,
+            vk::DependencyFlags(),
+            level_barrier, nullptr, nullptr
+        );
+    }
+}
+
+vk::DescriptorImageInfo DepthPyramid::get_descriptor() {
+    vk::DescriptorImageInfo info;
+    info.sampler = sampler_.get();
+    info.imageView = view_.get();
+    info.imageLayout = vk::ImageLayout::eGeneral;
+    return info;
+}
+
+vk::Image DepthPyramid::get_image() {
+    return image_.get();
+}
+
+uint32_t DepthPyramid::get_levels() {
+    return levels_;
+}
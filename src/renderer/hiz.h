@@ -0,0 +1,97 @@
+#ifndef RENDER_HIZ_H_
+#define RENDER_HIZ_H_
+#define VULKAN_HPP_TYPESAFE_CONVERSION
+
+#include <vulkan/vulkan.hpp>
+
+#include <vector>
+#include <fstream>
+#include <algorithm>
+
+#include "image.h"
+#include "physical.h"
+#include "pipecache.h"
+
+// Hierarchical depth buffer for occlusion culling
+// Each texel of a level holds the farthest depth of the texels it
+// covers in the level below, so a single fetch tells whether anything
+// drawn over an area could be in front of a given depth
+// Level 0 has the power of two size below the depth buffer's
+class DepthPyramid {
+    struct ReduceData {
+        int32_t src_width;
+        int32_t src_height;
+        int32_t dst_width;
+        int32_t dst_height;
+        int32_t level;
+        int32_t samples;
+    };
+
+    vk::Device logical_;
+    PhysicalDevice &physical_;
+    PipelineCache &cache_;
+    ImageMemoryAllocator &memory_;
+
+    vk::UniqueDescriptorSetLayout descriptor_layout_;
+    vk::UniquePipelineLayout layout_;
+    vk::UniquePipeline pipeline_;
+    vk::UniqueSampler sampler_;
+
+    vk::UniqueImage image_;
+    ImageMemoryHandle memory_handle_;
+    vk::UniqueImageView view_;
+    std::vector<vk::UniqueImageView> level_views_;
+
+    // A descriptor set per level, reading the one below
+    vk::UniqueDescriptorPool descriptor_pool_;
+    std::vector<vk::UniqueDescriptorSet> descriptor_sets_;
+
+    vk::Extent2D depth_extent_;
+    vk::Extent2D extent_;
+    uint32_t levels_;
+    uint32_t samples_;
+
+    // Create the layout of the depth buffer and pyramid levels
+    void create_layout();
+
+    // Create the compute pipeline from the compiled shader
+    void create_pipeline(std::string filename);
+
+    // Get the size of a level
+    vk::Extent2D get_level_extent(uint32_t level);
+
+public:
+    DepthPyramid(vk::Device &logical,
+                 PhysicalDevice &physical,
+                 PipelineCache &cache,
+                 ImageMemoryAllocator &memory,
+                 std::string shader);
+
+    // Recreate the pyramid for a depth buffer's size and samples
+    void resize(vk::Extent2D extent, vk::SampleCountFlagBits samples);
+
+    // Point the first level at the depth buffer it is built from
+    // Must be called again whenever the depth buffer is recreated
+    // The depth buffer must have been created with sampled usage
+    void set_depth(vk::ImageView depth_view);
+
+    // Record clearing all levels to the far plane, so that nothing is
+    // occluded until the first build
+    void record_clear(vk::CommandBuffer command_buffer);
+
+    // Record building all levels from the depth buffer
+    // The depth buffer must be readable in the shader read-only layout,
+    // and the levels writable in the general layout
+    void record_build(vk::CommandBuffer command_buffer);
+
+    // Get the pyramid image, kept in the general layout
+    vk::Image get_image();
+
+    // Get the number of levels
+    uint32_t get_levels();
+
+    // Get the descriptor to sample all levels in compute shaders
+    vk::DescriptorImageInfo get_descriptor();
+};
+
+#endif
@@ -7,8 +7,10 @@ vk::UniqueImage create_image(vk::Device &logical,
                              vk::Format format,
                              vk::ImageTiling tiling, 
                              vk::Flags<vk::ImageUsageFlagBits> usage,
-                             vk::SampleCountFlagBits samples) {
+                             vk::SampleCountFlagBits samples,
+                             vk::ImageCreateFlags flags) {
     vk::ImageCreateInfo image_info;
+    image_info.flags = flags;
     image_info.imageType = vk::ImageType::e2D;
     image_info.format = format;
 
@@ -31,14 +33,17 @@ vk::UniqueImageView create_view(vk::Device &logical,
                                 vk::Image &image,
                                 vk::Format format, 
                                 vk::Flags<vk::ImageAspectFlagBits> aspect_mask, 
-                                uint32_t mip_levels) {
+                                uint32_t mip_levels,
+                                vk::ComponentMapping components,
+                                uint32_t base_level) {
     vk::ImageViewCreateInfo view_info;
     view_info.image = image;
     view_info.viewType = vk::ImageViewType::e2D;
     view_info.format = format;
+    view_info.components = components;
 
     view_info.subresourceRange.aspectMask = aspect_mask;
-    view_info.subresourceRange.baseMipLevel = 0;
+    view_info.subresourceRange.baseMipLevel = base_level;
     view_info.subresourceRange.levelCount = mip_levels;
     view_info.subresourceRange.baseArrayLayer = 0;
     view_info.subresourceRange.layerCount = 1;
@@ -18,14 +18,19 @@ vk::UniqueImage create_image(vk::Device &logical,
                              vk::Format format,
                              vk::ImageTiling tiling, 
                              vk::Flags<vk::ImageUsageFlagBits> usage,
-                             vk::SampleCountFlagBits samples);
+                             vk::SampleCountFlagBits samples,
+                             vk::ImageCreateFlags flags = {});
 
 // Create a unique image view
+// Components can be swizzled to remap the channels read by shaders
+// The view covers mip_levels levels starting at base_level
 vk::UniqueImageView create_view(vk::Device &logical,
                                 vk::Image &image,
                                 vk::Format format, 
                                 vk::Flags<vk::ImageAspectFlagBits> aspect_mask, 
-                                uint32_t mip_levels);
+                                uint32_t mip_levels,
+                                vk::ComponentMapping components = {},
+                                uint32_t base_level = 0);
 
 // Describes image memory requirements
 struct MemoryMeta {
@@ -0,0 +1,245 @@
+#define STB_IMAGE_IMPLEMENTATION
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #define STBI_NEON
+    #include <arm_neon.h>
+#endif
+#include "loader.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define LOADER_SSSE3
+    #include <tmmintrin.h>
+#endif
+
+// Get the milliseconds elapsed since a time point
+static double elapsed_ms(std::chrono::high_resolution_clock::time_point start) {
+    auto now = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(now - start).count();
+}
+
+// Read an entire file into memory
+static std::vector<unsigned char> read_file(const std::string &filename) {
+    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+    if(!file.is_open()) {
+        throw std::runtime_error("Could not load image: " + filename);
+    }
+
+    size_t size = file.tellg();
+    std::vector<unsigned char> bytes(size);
+
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(bytes.data()), size);
+    return bytes;
+}
+
+ImageData decode_image(const unsigned char *bytes, size_t length) {
+    bool jpeg = length >= 2 && bytes[0] == 0xFF && bytes[1] == 0xD8;
+
+    ImageData image;
+    image.pixels.reset(stbi_load_from_memory(
+        bytes, length,
+        &image.width, &image.height, &image.channels,
+        jpeg ? STBI_rgb_alpha : STBI_default
+    ));
+    if(jpeg) {
+        image.channels = 4;
+    }
+    return image;
+}
+
+std::vector<ImageData> decode_images(ThreadPool &pool,
+                                     const std::vector<std::string> &filenames,
+                                     TextureLoadStats &stats) {
+    std::vector<ImageData> images(filenames.size());
+    std::vector<std::string> errors(filenames.size());
+
+    // Per-file phase timings, summed once all workers are done
+    std::vector<double> io_ms(filenames.size(), 0);
+    std::vector<double> decode_ms(filenames.size(), 0);
+
+    // Workers pull the next file from a shared counter so that
+    // a few large images do not leave the other threads idle
+    std::atomic<size_t> next(0);
+    unsigned worker_count = std::min<size_t>(pool.get_size(), filenames.size());
+    for(unsigned w = 0; w < worker_count; w++) {
+        pool.submit([&]() {
+            for(size_t i = next++; i < filenames.size(); i = next++) {
+                try {
+                    auto start = std::chrono::high_resolution_clock::now();
+                    std::vector<unsigned char> bytes = read_file(filenames[i]);
+                    io_ms[i] = elapsed_ms(start);
+
+                    start = std::chrono::high_resolution_clock::now();
+                    ImageData &image = images[i];
+                    image = decode_image(bytes.data(), bytes.size());
+                    decode_ms[i] = elapsed_ms(start);
+                    if(!image.pixels) {
+                        errors[i] = "Could not load image: " + filenames[i];
+                    }
+                }
+                catch(std::exception &err) {
+                    errors[i] = err.what();
+                }
+            }
+        });
+    }
+    pool.wait();
+
+    for(size_t i = 0; i < filenames.size(); i++) {
+        if(!errors[i].empty()) {
+            throw std::runtime_error(errors[i]);
+        }
+        stats.io_ms += io_ms[i];
+        stats.decode_ms += decode_ms[i];
+    }
+    stats.count += filenames.size();
+    return images;
+}
+
+// Scalar fallback, also used for the tail of the SIMD loops
+static void expand_scalar(const unsigned char *src, 
+                          unsigned char *dst, 
+                          size_t count, 
+                          int channels) {
+    for(size_t i = 0; i < count; i++) {
+        switch(channels) {
+        case 1:
+            dst[0] = dst[1] = dst[2] = src[0];
+            dst[3] = 255;
+            break;
+        case 2:
+            dst[0] = dst[1] = dst[2] = src[0];
+            dst[3] = src[1];
+            break;
+        case 3:
+            dst[0] = src[0];
+            dst[1] = src[1];
+            dst[2] = src[2];
+            dst[3] = 255;
+            break;
+        }
+        src += channels;
+        dst += 4;
+    }
+}
+
+#ifdef LOADER_SSSE3
+// Expand 16 pixels per iteration with byte shuffles
+// Returns the number of pixels processed
+__attribute__((target("ssse3")))
+static size_t expand_ssse3(const unsigned char *src, 
+                           unsigned char *dst, 
+                           size_t count, 
+                           int channels) {
+    const __m128i alpha = _mm_set1_epi32(0xFF000000);
+    size_t i = 0;
+    if(channels == 3) {
+        const __m128i mask = _mm_setr_epi8(
+            0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1
+        );
+        for(; i + 16 <= count; i += 16) {
+            const __m128i *in = reinterpret_cast<const __m128i *>(src + i * 3);
+            __m128i *out = reinterpret_cast<__m128i *>(dst + i * 4);
+            __m128i a = _mm_loadu_si128(in);
+            __m128i b = _mm_loadu_si128(in + 1);
+            __m128i c = _mm_loadu_si128(in + 2);
+            
+            // Each register holds 4 pixels (12 bytes) at its base
+            __m128i p0 = a;
+            __m128i p1 = _mm_alignr_epi8(b, a, 12);
+            __m128i p2 = _mm_alignr_epi8(c, b, 8);
+            __m128i p3 = _mm_srli_si128(c, 4);
+            _mm_storeu_si128(out, _mm_or_si128(_mm_shuffle_epi8(p0, mask), alpha));
+            _mm_storeu_si128(out + 1, _mm_or_si128(_mm_shuffle_epi8(p1, mask), alpha));
+            _mm_storeu_si128(out + 2, _mm_or_si128(_mm_shuffle_epi8(p2, mask), alpha));
+            _mm_storeu_si128(out + 3, _mm_or_si128(_mm_shuffle_epi8(p3, mask), alpha));
+        }
+    }
+    else if(channels == 1) {
+        const __m128i masks[4] = {
+            _mm_setr_epi8(0, 0, 0, -1, 1, 1, 1, -1, 2, 2, 2, -1, 3, 3, 3, -1),
+            _mm_setr_epi8(4, 4, 4, -1, 5, 5, 5, -1, 6, 6, 6, -1, 7, 7, 7, -1),
+            _mm_setr_epi8(8, 8, 8, -1, 9, 9, 9, -1, 10, 10, 10, -1, 11, 11, 11, -1),
+            _mm_setr_epi8(12, 12, 12, -1, 13, 13, 13, -1, 14, 14, 14, -1, 15, 15, 15, -1)
+        };
+        for(; i + 16 <= count; i += 16) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+            __m128i *out = reinterpret_cast<__m128i *>(dst + i * 4);
+            for(int j = 0; j < 4; j++) {
+                _mm_storeu_si128(out + j, _mm_or_si128(_mm_shuffle_epi8(a, masks[j]), alpha));
+            }
+        }
+    }
+    else if(channels == 2) {
+        const __m128i masks[2] = {
+            _mm_setr_epi8(0, 0, 0, 1, 2, 2, 2, 3, 4, 4, 4, 5, 6, 6, 6, 7),
+            _mm_setr_epi8(8, 8, 8, 9, 10, 10, 10, 11, 12, 12, 12, 13, 14, 14, 14, 15)
+        };
+        for(; i + 8 <= count; i += 8) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 2));
+            __m128i *out = reinterpret_cast<__m128i *>(dst + i * 4);
+            _mm_storeu_si128(out, _mm_shuffle_epi8(a, masks[0]));
+            _mm_storeu_si128(out + 1, _mm_shuffle_epi8(a, masks[1]));
+        }
+    }
+    return i;
+}
+#endif
+
+#ifdef STBI_NEON
+// Expand 16 pixels per iteration with interleaved loads and stores
+// Returns the number of pixels processed
+static size_t expand_neon(const unsigned char *src, 
+                          unsigned char *dst, 
+                          size_t count, 
+                          int channels) {
+    const uint8x16_t alpha = vdupq_n_u8(255);
+    size_t i = 0;
+    for(; i + 16 <= count; i += 16) {
+        uint8x16x4_t out;
+        if(channels == 3) {
+            uint8x16x3_t in = vld3q_u8(src + i * 3);
+            out.val[0] = in.val[0];
+            out.val[1] = in.val[1];
+            out.val[2] = in.val[2];
+            out.val[3] = alpha;
+        }
+        else if(channels == 2) {
+            uint8x16x2_t in = vld2q_u8(src + i * 2);
+            out.val[0] = out.val[1] = out.val[2] = in.val[0];
+            out.val[3] = in.val[1];
+        }
+        else {
+            uint8x16_t in = vld1q_u8(src + i);
+            out.val[0] = out.val[1] = out.val[2] = in;
+            out.val[3] = alpha;
+        }
+        vst4q_u8(dst + i * 4, out);
+    }
+    return i;
+}
+#endif
+
+void expand_to_rgba(const unsigned char *src, 
+                    unsigned char *dst, 
+                    size_t count, 
+                    int channels) {
+    if(channels == 4) {
+        std::memcpy(dst, src, count * 4);
+        return;
+    }
+    size_t done = 0;
+#if defined(LOADER_SSSE3)
+    static bool ssse3 = __builtin_cpu_supports("ssse3");
+    if(ssse3) {
+        done = expand_ssse3(src, dst, count, channels);
+    }
+#elif defined(STBI_NEON)
+    done = expand_neon(src, dst, count, channels);
+#endif
+    expand_scalar(
+        src + done * channels, 
+        dst + done * 4, 
+        count - done, 
+        channels
+    );
+}
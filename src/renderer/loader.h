@@ -0,0 +1,56 @@
+#ifndef RENDER_LOADER_H_
+#define RENDER_LOADER_H_
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <chrono>
+#include <fstream>
+#include <atomic>
+#include <stdexcept>
+#include <cstring>
+
+#include "assets/stb_image.h"
+#include "threads.h"
+
+// Decoded texel data of an image file
+// Images keep the channel count they were decoded with and are 
+// only expanded to RGBA when copied into the staging buffer, unless
+// the texture stores grey texels as they are
+struct ImageData {
+    std::unique_ptr<unsigned char, void (*)(void *)> pixels = {
+        nullptr, stbi_image_free
+    };
+    int width = 0;
+    int height = 0;
+    int channels = 4;
+};
+
+// Time spent in each phase of loading a batch of textures
+// I/O and decode times are summed over all worker threads
+struct TextureLoadStats {
+    int count = 0;
+    double io_ms = 0;
+    double decode_ms = 0;
+    double upload_ms = 0;
+};
+
+// Decode an image file held in memory
+// JPEGs are decoded straight to RGBA since stb_image fuses the alpha 
+// channel into its SIMD color conversion, other formats keep their 
+// native channel count
+ImageData decode_image(const unsigned char *bytes, size_t length);
+
+// Read and decode a batch of image files on the worker pool
+std::vector<ImageData> decode_images(ThreadPool &pool,
+                                     const std::vector<std::string> &filenames,
+                                     TextureLoadStats &stats);
+
+// Expand 1 (grey), 2 (grey, alpha), 3 (RGB) or 4 channel pixels to RGBA
+// This produces the same texels as decoding with STBI_rgb_alpha
+void expand_to_rgba(const unsigned char *src, 
+                    unsigned char *dst, 
+                    size_t count, 
+                    int channels);
+
+#endif
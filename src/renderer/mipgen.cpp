@@ -0,0 +1,365 @@
+#include "mipgen.h"
+
+MipGenerator::MipGenerator(vk::Device &logical,
+                           PhysicalDevice &physical,
+                           PipelineCache &cache,
+                           RenderBuffer &counters,
+                           uint32_t graphics_family,
+                           uint32_t compute_family,
+                           std::string shader) : physical_(physical),
+                                                 cache_(cache),
+                                                 counters_(counters) {
+    logical_ = logical;
+    graphics_family_ = graphics_family;
+    compute_family_ = compute_family;
+    dispatches_ = 0;
+
+    // Counters start at zero, and the last workgroup of each
+    // dispatch resets its counter when it is done
+    counters_.clear(0);
+    size_t offset = counters_.reserve(0, MIPGEN_COUNTERS * sizeof(uint32_t));
+    std::memset(
+        counters_.get_mapped() + counters_.get_offset(0) + offset,
+        0,
+        MIPGEN_COUNTERS * sizeof(uint32_t)
+    );
+
+    create_layout();
+    create_pipeline(shader);
+}
+
+void MipGenerator::create_layout() {
+    vk::DescriptorSetLayoutBinding mips_binding;
+    mips_binding.binding = 0;
+    mips_binding.descriptorCount = MIPGEN_MAX_LEVELS;
+    mips_binding.descriptorType = vk::DescriptorType::eStorageImage;
+    mips_binding.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+    vk::DescriptorSetLayoutBinding counters_binding;
+    counters_binding.binding = 1;
+    counters_binding.descriptorCount = 1;
+    counters_binding.descriptorType = vk::DescriptorType::eStorageBuffer;
+    counters_binding.stageFlags = vk::ShaderStageFlagBits::eCompute;
+
+    std::vector<vk::DescriptorSetLayoutBinding> bindings = {
+        mips_binding,
+        counters_binding
+    };
+    vk::DescriptorSetLayoutCreateInfo descriptor_layout_info;
+    descriptor_layout_info.bindingCount = bindings.size();
+    descriptor_layout_info.pBindings = &bindings[0];
+    descriptor_layout_ = logical_.createDescriptorSetLayoutUnique(
+        descriptor_layout_info
+    );
+
+    vk::PushConstantRange push_constant_range;
+    push_constant_range.stageFlags = vk::ShaderStageFlagBits::eCompute;
+    push_constant_range.offset = 0;
+    push_constant_range.size = sizeof(MipData);
+
+    vk::PipelineLayoutCreateInfo layout_info;
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = &descriptor_layout_.get();
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &push_constant_range;
+    layout_ = logical_.createPipelineLayoutUnique(layout_info);
+}
+
+void MipGenerator::create_pipeline(std::string filename) {
+    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+    if(!file.is_open()) {
+        throw std::runtime_error("Failed to load shader: " + filename);
+    }
+
+    size_t size = file.tellg();
+    std::vector<char> bytes(size);
+
+    file.seekg(0);
+    file.read(&bytes[0], size);
+    file.close();
+
+    vk::ShaderModuleCreateInfo shader_info;
+    shader_info.codeSize = bytes.size();
+    shader_info.pCode = reinterpret_cast<uint32_t *>(&bytes[0]);
+    vk::UniqueShaderModule shader_module = logical_.createShaderModuleUnique(
+        shader_info
+    );
+
+    vk::ComputePipelineCreateInfo pipeline_info;
+    pipeline_info.stage.stage = vk::ShaderStageFlagBits::eCompute;
+    pipeline_info.stage.module = shader_module.get();
+    pipeline_info.stage.pName = "main";
+    pipeline_info.layout = layout_.get();
+    pipeline_ = cache_.create_compute_pipeline(pipeline_info);
+}
+
+vk::DescriptorSet MipGenerator::allocate_descriptor_set() {
+    vk::DescriptorSetAllocateInfo descriptor_alloc_info;
+    descriptor_alloc_info.descriptorSetCount = 1;
+    descriptor_alloc_info.pSetLayouts = &descriptor_layout_.get();
+    if(!descriptor_pools_.empty()) {
+        descriptor_alloc_info.descriptorPool = descriptor_pools_.back().get();
+        try {
+            return logical_.allocateDescriptorSets(descriptor_alloc_info)[0];
+        }
+        catch(vk::OutOfPoolMemoryError &err) {
+            // Fall through to a new pool
+        }
+    }
+
+    uint32_t sets = 64;
+    std::vector<vk::DescriptorPoolSize> pool_sizes = {
+        {vk::DescriptorType::eStorageImage, sets * MIPGEN_MAX_LEVELS},
+        {vk::DescriptorType::eStorageBuffer, sets}
+    };
+    vk::DescriptorPoolCreateInfo pool_info;
+    pool_info.maxSets = sets;
+    pool_info.poolSizeCount = pool_sizes.size();
+    pool_info.pPoolSizes = &pool_sizes[0];
+    descriptor_pools_.push_back(
+        logical_.createDescriptorPoolUnique(pool_info)
+    );
+
+    descriptor_alloc_info.descriptorPool = descriptor_pools_.back().get();
+    return logical_.allocateDescriptorSets(descriptor_alloc_info)[0];
+}
+
+void MipGenerator::record_barrier(vk::CommandBuffer &command_buffer,
+                                  TextureData &texture,
+                                  vk::ImageLayout from,
+                                  vk::ImageLayout to,
+                                  vk::PipelineStageFlags src_stage,
+                                  vk::PipelineStageFlags dst_stage,
+                                  vk::AccessFlags src_access,
+                                  vk::AccessFlags dst_access,
+                                  uint32_t src_family,
+                                  uint32_t dst_family) {
+    vk::ImageMemoryBarrier barrier;
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = dst_access;
+    barrier.oldLayout = from;
+    barrier.newLayout = to;
+    barrier.srcQueueFamilyIndex = src_family;
+    barrier.dstQueueFamilyIndex = dst_family;
+    barrier.image = texture.get_image();
+
+    barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = texture.get_mip_levels();
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    command_buffer.pipelineBarrier(
+        src_stage,
+        dst_stage,
+        vk::DependencyFlags(),
+        nullptr, nullptr,
+        barrier
+    );
+}
+
+bool MipGenerator::is_supported(vk::Format format, uint32_t levels) {
+    if(format != vk::Format::eR8G8B8A8Srgb || levels > MIPGEN_MAX_LEVELS) {
+        return false;
+    }
+    auto properties = physical_.get_format_properties(vk::Format::eR8G8B8A8Unorm);
+    auto &features = physical_.get_features();
+    return (properties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eStorageImage) &&
+           features.shaderStorageImageArrayDynamicIndexing;
+}
+
+bool MipGenerator::is_async() {
+    return graphics_family_ != compute_family_;
+}
+
+void MipGenerator::record_release(vk::CommandBuffer &command_buffer,
+                                  TextureData &texture) {
+    // Without a queue family transfer this is a plain transition
+    uint32_t src_family = VK_QUEUE_FAMILY_IGNORED;
+    uint32_t dst_family = VK_QUEUE_FAMILY_IGNORED;
+    vk::PipelineStageFlags dst_stage = vk::PipelineStageFlagBits::eComputeShader;
+    vk::AccessFlags dst_access = vk::AccessFlagBits::eShaderRead |
+                                 vk::AccessFlagBits::eShaderWrite;
+    if(is_async()) {
+        src_family = graphics_family_;
+        dst_family = compute_family_;
+        dst_stage = vk::PipelineStageFlagBits::eBottomOfPipe;
+        dst_access = {};
+    }
+    record_barrier(
+        command_buffer,
+        texture,
+        vk::ImageLayout::eTransferDstOptimal,
+        vk::ImageLayout::eGeneral,
+        vk::PipelineStageFlagBits::eTransfer,
+        dst_stage,
+        vk::AccessFlagBits::eTransferWrite,
+        dst_access,
+        src_family,
+        dst_family
+    );
+}
+
+void MipGenerator::record_generate(vk::CommandBuffer &command_buffer,
+                                   TextureData &texture) {
+    uint32_t levels = texture.get_mip_levels();
+    if(is_async()) {
+        // Acquire the texture released by the graphics queue
+        record_barrier(
+            command_buffer,
+            texture,
+            vk::ImageLayout::eTransferDstOptimal,
+            vk::ImageLayout::eGeneral,
+            vk::PipelineStageFlagBits::eTopOfPipe,
+            vk::PipelineStageFlagBits::eComputeShader,
+            {},
+            vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite,
+            graphics_family_,
+            compute_family_
+        );
+    }
+
+    // Counters are only reused after all earlier dispatches are done
+    if(dispatches_ && dispatches_ % MIPGEN_COUNTERS == 0) {
+        vk::MemoryBarrier barrier;
+        barrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
+        barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead |
+                                vk::AccessFlagBits::eShaderWrite;
+        command_buffer.pipelineBarrier(
+            vk::PipelineStageFlagBits::eComputeShader,
+            vk::PipelineStageFlagBits::eComputeShader,
+            vk::DependencyFlags(),
+            barrier, nullptr, nullptr
+        );
+    }
+    uint32_t counter = dispatches_ % MIPGEN_COUNTERS;
+    dispatches_++;
+
+    // Storage views of each level alias the sRGB texels as UNORM
+    std::vector<vk::DescriptorImageInfo> image_infos;
+    for(uint32_t level = 0; level < levels; level++) {
+        vk::ImageViewCreateInfo view_info;
+        view_info.image = texture.get_image();
+        view_info.viewType = vk::ImageViewType::e2D;
+        view_info.format = vk::Format::eR8G8B8A8Unorm;
+        view_info.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
+        view_info.subresourceRange.baseMipLevel = level;
+        view_info.subresourceRange.levelCount = 1;
+        view_info.subresourceRange.baseArrayLayer = 0;
+        view_info.subresourceRange.layerCount = 1;
+
+        vk::ImageViewUsageCreateInfo usage_info;
+        usage_info.usage = vk::ImageUsageFlagBits::eStorage;
+        view_info.pNext = &usage_info;
+        views_.push_back(logical_.createImageViewUnique(view_info));
+
+        vk::DescriptorImageInfo image_info;
+        image_info.imageView = views_.back().get();
+        image_info.imageLayout = vk::ImageLayout::eGeneral;
+        image_infos.push_back(image_info);
+    }
+    while(image_infos.size() < MIPGEN_MAX_LEVELS) {
+        image_infos.push_back(image_infos.back());
+    }
+
+    vk::DescriptorBufferInfo counters_info;
+    counters_info.buffer = counters_.get_handle();
+    counters_info.offset = counters_.get_offset(0);
+    counters_info.range = MIPGEN_COUNTERS * sizeof(uint32_t);
+
+    vk::DescriptorSet descriptor_set = allocate_descriptor_set();
+    vk::WriteDescriptorSet mips_write;
+    mips_write.dstSet = descriptor_set;
+    mips_write.dstBinding = 0;
+    mips_write.dstArrayElement = 0;
+    mips_write.descriptorCount = MIPGEN_MAX_LEVELS;
+    mips_write.descriptorType = vk::DescriptorType::eStorageImage;
+    mips_write.pImageInfo = &image_infos[0];
+
+    vk::WriteDescriptorSet counters_write;
+    counters_write.dstSet = descriptor_set;
+    counters_write.dstBinding = 1;
+    counters_write.dstArrayElement = 0;
+    counters_write.descriptorCount = 1;
+    counters_write.descriptorType = vk::DescriptorType::eStorageBuffer;
+    counters_write.pBufferInfo = &counters_info;
+
+    std::vector<vk::WriteDescriptorSet> descriptor_writes = {
+        mips_write,
+        counters_write
+    };
+    logical_.updateDescriptorSets(descriptor_writes, nullptr);
+
+    // One workgroup per 64x64 tile of the base level
+    MipData mip_data = {
+        static_cast<int32_t>(texture.get_width()),
+        static_cast<int32_t>(texture.get_height()),
+        static_cast<int32_t>(levels),
+        static_cast<int32_t>(counter)
+    };
+    command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline_.get());
+    command_buffer.bindDescriptorSets(
+        vk::PipelineBindPoint::eCompute, layout_.get(),
+        0, descriptor_set, nullptr
+    );
+    command_buffer.pushConstants(
+        layout_.get(),
+        vk::ShaderStageFlagBits::eCompute,
+        0,
+        sizeof(mip_data),
+        &mip_data
+    );
+    command_buffer.dispatch(
+        (texture.get_width() + 63) / 64,
+        (texture.get_height() + 63) / 64,
+        1
+    );
+
+    // Release the texture for sampling
+    uint32_t src_family = VK_QUEUE_FAMILY_IGNORED;
+    uint32_t dst_family = VK_QUEUE_FAMILY_IGNORED;
+    vk::PipelineStageFlags dst_stage = vk::PipelineStageFlagBits::eFragmentShader;
+    vk::AccessFlags dst_access = vk::AccessFlagBits::eShaderRead;
+    if(is_async()) {
+        src_family = compute_family_;
+        dst_family = graphics_family_;
+        dst_stage = vk::PipelineStageFlagBits::eBottomOfPipe;
+        dst_access = {};
+    }
+    record_barrier(
+        command_buffer,
+        texture,
+        vk::ImageLayout::eGeneral,
+        vk::ImageLayout::eShaderReadOnlyOptimal,
+        vk::PipelineStageFlagBits::eComputeShader,
+        dst_stage,
+        vk::AccessFlagBits::eShaderWrite,
+        dst_access,
+        src_family,
+        dst_family
+    );
+}
+
+void MipGenerator::record_acquire(vk::CommandBuffer &command_buffer,
+                                  TextureData &texture) {
+    if(!is_async()) {
+        return;
+    }
+    record_barrier(
+        command_buffer,
+        texture,
+        vk::ImageLayout::eGeneral,
+        vk::ImageLayout::eShaderReadOnlyOptimal,
+        vk::PipelineStageFlagBits::eTopOfPipe,
+        vk::PipelineStageFlagBits::eFragmentShader,
+        {},
+        vk::AccessFlagBits::eShaderRead,
+        compute_family_,
+        graphics_family_
+    );
+}
+
+void MipGenerator::reset() {
+    descriptor_pools_.clear();
+    views_.clear();
+}
@@ -0,0 +1,106 @@
+#ifndef RENDER_MIPGEN_H_
+#define RENDER_MIPGEN_H_
+#define VULKAN_HPP_TYPESAFE_CONVERSION
+
+#include <vulkan/vulkan.hpp>
+
+#include <vector>
+#include <fstream>
+
+#include "texture.h"
+#include "buffer.h"
+#include "physical.h"
+#include "pipecache.h"
+
+// Maximum number of mip levels the compute shader can write
+constexpr uint32_t MIPGEN_MAX_LEVELS = 15;
+
+// Number of dispatch counters before they are reused
+constexpr uint32_t MIPGEN_COUNTERS = 1024;
+
+// Generates all mip levels of a texture in a single compute dispatch,
+// instead of a chain of blits separated by barriers
+// If the device has a dedicated compute queue family, generation can
+// run there while the graphics queue keeps rendering
+class MipGenerator {
+    struct MipData {
+        int32_t width;
+        int32_t height;
+        int32_t levels;
+        int32_t counter;
+    };
+
+    vk::Device logical_;
+    PhysicalDevice &physical_;
+    PipelineCache &cache_;
+
+    uint32_t graphics_family_;
+    uint32_t compute_family_;
+
+    vk::UniqueDescriptorSetLayout descriptor_layout_;
+    vk::UniquePipelineLayout layout_;
+    vk::UniquePipeline pipeline_;
+
+    // Per-dispatch resources, kept until the batch has finished
+    std::vector<vk::UniqueDescriptorPool> descriptor_pools_;
+    std::vector<vk::UniqueImageView> views_;
+    uint32_t dispatches_;
+
+    // Workgroup counters for building the last levels
+    RenderBuffer &counters_;
+
+    // Create the layout of the storage images and counters
+    void create_layout();
+
+    // Create the compute pipeline from the compiled shader
+    void create_pipeline(std::string filename);
+
+    // Allocate a descriptor set, adding a pool if the others are full
+    vk::DescriptorSet allocate_descriptor_set();
+
+    // Record an image barrier over all levels of a texture
+    void record_barrier(vk::CommandBuffer &command_buffer,
+                        TextureData &texture,
+                        vk::ImageLayout from,
+                        vk::ImageLayout to,
+                        vk::PipelineStageFlags src_stage,
+                        vk::PipelineStageFlags dst_stage,
+                        vk::AccessFlags src_access,
+                        vk::AccessFlags dst_access,
+                        uint32_t src_family,
+                        uint32_t dst_family);
+
+public:
+    MipGenerator(vk::Device &logical,
+                 PhysicalDevice &physical,
+                 PipelineCache &cache,
+                 RenderBuffer &counters,
+                 uint32_t graphics_family,
+                 uint32_t compute_family,
+                 std::string shader);
+
+    // Check if the device can generate a number of mip levels of a
+    // format in a compute shader
+    bool is_supported(vk::Format format, uint32_t levels);
+
+    // Does generation run on a different queue family than graphics?
+    bool is_async();
+
+    // Record the hand over of a texture after its base level has been
+    // copied, on the graphics queue
+    void record_release(vk::CommandBuffer &command_buffer, TextureData &texture);
+
+    // Record the mip generation of a texture, on the compute queue
+    // The texture is left readable by fragment shaders
+    void record_generate(vk::CommandBuffer &command_buffer, TextureData &texture);
+
+    // Record taking a texture back after its mips have been generated,
+    // on the graphics queue
+    void record_acquire(vk::CommandBuffer &command_buffer, TextureData &texture);
+
+    // Free the per-dispatch resources
+    // All recorded generation must have finished executing
+    void reset();
+};
+
+#endif
@@ -0,0 +1,203 @@
+#include "pack.h"
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+uint32_t get_mip_levels(uint32_t width, uint32_t height) {
+    return std::floor(std::log2(std::max(width, height))) + 1;
+}
+
+size_t get_mip_offset(uint32_t width, uint32_t height, uint32_t level) {
+    size_t offset = 0;
+    for(uint32_t i = 0; i < level; i++) {
+        offset += static_cast<size_t>(width) * height * 4;
+        if(width > 1) width /= 2;
+        if(height > 1) height /= 2;
+    }
+    return offset;
+}
+
+// Lookup table for decoding sRGB encoded values
+// Built once on first use, which is thread safe for a local static
+static float srgb_to_linear(unsigned char value) {
+    static const std::array<float, 256> table = []() {
+        std::array<float, 256> table;
+        for(int i = 0; i < 256; i++) {
+            float c = i / 255.0f;
+            table[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return table;
+    }();
+    return table[value];
+}
+
+static unsigned char linear_to_srgb(float value) {
+    float c = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+    return static_cast<unsigned char>(std::min(std::max(c, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+std::vector<unsigned char> generate_mip_chain(const unsigned char *pixels,
+                                              uint32_t width,
+                                              uint32_t height) {
+    uint32_t mip_levels = get_mip_levels(width, height);
+    std::vector<unsigned char> chain(
+        get_mip_offset(width, height, mip_levels)
+    );
+    std::memcpy(&chain[0], pixels, static_cast<size_t>(width) * height * 4);
+
+    uint32_t src_width = width;
+    uint32_t src_height = height;
+    for(uint32_t level = 1; level < mip_levels; level++) {
+        const unsigned char *src = &chain[get_mip_offset(width, height, level - 1)];
+        unsigned char *dst = &chain[get_mip_offset(width, height, level)];
+        uint32_t dst_width = src_width > 1 ? src_width / 2 : 1;
+        uint32_t dst_height = src_height > 1 ? src_height / 2 : 1;
+
+        // Average each 2x2 block of the previous level
+        for(uint32_t y = 0; y < dst_height; y++) {
+            for(uint32_t x = 0; x < dst_width; x++) {
+                uint32_t x0 = std::min(x * 2, src_width - 1);
+                uint32_t x1 = std::min(x * 2 + 1, src_width - 1);
+                uint32_t y0 = std::min(y * 2, src_height - 1);
+                uint32_t y1 = std::min(y * 2 + 1, src_height - 1);
+                const unsigned char *texels[4] = {
+                    src + (y0 * src_width + x0) * 4,
+                    src + (y0 * src_width + x1) * 4,
+                    src + (y1 * src_width + x0) * 4,
+                    src + (y1 * src_width + x1) * 4
+                };
+
+                unsigned char *out = dst + (y * dst_width + x) * 4;
+                for(int c = 0; c < 3; c++) {
+                    float sum = 0;
+                    for(auto texel : texels) {
+                        sum += srgb_to_linear(texel[c]);
+                    }
+                    out[c] = linear_to_srgb(sum / 4);
+                }
+                int alpha = 0;
+                for(auto texel : texels) {
+                    alpha += texel[3];
+                }
+                out[3] = (alpha + 2) / 4;
+            }
+        }
+        src_width = dst_width;
+        src_height = dst_height;
+    }
+    return chain;
+}
+
+TexturePack::TexturePack(const std::string &filename) {
+    map(filename);
+    read_index(filename);
+}
+
+TexturePack::~TexturePack() {
+#ifdef _WIN32
+    UnmapViewOfFile(data_);
+    CloseHandle(mapping_);
+    CloseHandle(file_);
+#else
+    munmap(const_cast<unsigned char *>(data_), size_);
+    close(file_);
+#endif
+}
+
+void TexturePack::map(const std::string &filename) {
+#ifdef _WIN32
+    file_ = CreateFileA(
+        filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr
+    );
+    if(file_ == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Could not open texture pack: " + filename);
+    }
+    LARGE_INTEGER size;
+    GetFileSizeEx(file_, &size);
+    size_ = size.QuadPart;
+
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(!mapping_) {
+        CloseHandle(file_);
+        throw std::runtime_error("Could not map texture pack: " + filename);
+    }
+    data_ = static_cast<const unsigned char *>(
+        MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0)
+    );
+#else
+    file_ = open(filename.c_str(), O_RDONLY);
+    if(file_ < 0) {
+        throw std::runtime_error("Could not open texture pack: " + filename);
+    }
+    struct stat info;
+    fstat(file_, &info);
+    size_ = info.st_size;
+
+    void *data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file_, 0);
+    if(data == MAP_FAILED) {
+        close(file_);
+        throw std::runtime_error("Could not map texture pack: " + filename);
+    }
+    data_ = static_cast<const unsigned char *>(data);
+#endif
+}
+
+void TexturePack::read_index(const std::string &filename) {
+    PackHeader header;
+    if(size_ < sizeof(header)) {
+        throw std::runtime_error("Invalid texture pack: " + filename);
+    }
+    std::memcpy(&header, data_, sizeof(header));
+    if(std::memcmp(header.magic, PACK_MAGIC, 4) || 
+       header.version != PACK_VERSION ||
+       sizeof(header) + header.entry_count * sizeof(PackEntry) > size_) {
+        throw std::runtime_error("Invalid texture pack: " + filename);
+    }
+
+    entries_.resize(header.entry_count);
+    std::memcpy(
+        entries_.data(), 
+        data_ + sizeof(header), 
+        header.entry_count * sizeof(PackEntry)
+    );
+    for(size_t i = 0; i < entries_.size(); i++) {
+        PackEntry &entry = entries_[i];
+        entry.name[sizeof(entry.name) - 1] = 0;
+
+        // The mip chain must be exactly as large as its dimensions say,
+        // and lie within the file
+        if(!entry.width || !entry.height || 
+           !entry.mip_levels || 
+           entry.mip_levels > get_mip_levels(entry.width, entry.height) ||
+           entry.size != get_mip_offset(entry.width, entry.height, entry.mip_levels) ||
+           entry.offset > size_ || 
+           entry.size > size_ - entry.offset) {
+            throw std::runtime_error("Invalid texture pack: " + filename);
+        }
+        names_[entry.name] = i;
+    }
+}
+
+const std::vector<PackEntry> &TexturePack::get_entries() {
+    return entries_;
+}
+
+int TexturePack::find(const std::string &name) {
+    auto it = names_.find(name);
+    if(it == names_.end()) {
+        return -1;
+    }
+    return it->second;
+}
+
+const unsigned char *TexturePack::get_texels(int entry, uint32_t level) {
+    PackEntry &data = entries_[entry];
+    return data_ + data.offset + get_mip_offset(data.width, data.height, level);
+}
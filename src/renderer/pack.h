@@ -0,0 +1,87 @@
+#ifndef RENDER_PACK_H_
+#define RENDER_PACK_H_
+
+#include <vector>
+#include <array>
+#include <string>
+#include <unordered_map>
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+
+// Texture packs store GPU-ready texel data with their full mip chains
+// so that loading them requires no decoding or mipmap generation
+//
+// Layout:
+// * PackHeader
+// * PackEntry[entry_count]
+// * Texel data, each entry's mip levels stored back to back as RGBA
+const char PACK_MAGIC[4] = {'T', 'P', 'A', 'K'};
+const uint32_t PACK_VERSION = 1;
+
+struct PackHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t reserved;
+};
+
+struct PackEntry {
+    char name[256];       // Path of the source image
+    uint32_t width;
+    uint32_t height;
+    uint32_t mip_levels;
+    uint32_t reserved;
+    uint64_t offset;      // Offset of mip level 0 from the start of the file
+    uint64_t size;        // Size of the entire mip chain
+};
+
+// Get the length of the full mip chain of an image
+uint32_t get_mip_levels(uint32_t width, uint32_t height);
+
+// Get the offset of a mip level within a packed RGBA mip chain
+size_t get_mip_offset(uint32_t width, uint32_t height, uint32_t level);
+
+// Generate a full RGBA mip chain from the base level
+// Texels are averaged in linear space to match blitting an sRGB image
+std::vector<unsigned char> generate_mip_chain(const unsigned char *pixels,
+                                              uint32_t width,
+                                              uint32_t height);
+
+// A read-only memory mapping of a texture pack file
+class TexturePack {
+    const unsigned char *data_;
+    size_t size_;
+
+#ifdef _WIN32
+    void *file_;
+    void *mapping_;
+#else
+    int file_;
+#endif
+
+    std::vector<PackEntry> entries_;
+    std::unordered_map<std::string, int> names_;
+
+    // Map the file into memory
+    void map(const std::string &filename);
+
+    // Validate the header and read the index
+    void read_index(const std::string &filename);
+
+public:
+    TexturePack(const std::string &filename);
+    ~TexturePack();
+
+    // Get all entries of the pack
+    const std::vector<PackEntry> &get_entries();
+
+    // Find the index of an entry by name, returns -1 if not found
+    int find(const std::string &name);
+
+    // Get the mapped texel data of an entry's mip level
+    const unsigned char *get_texels(int entry, uint32_t level = 0);
+};
+
+#endif
@@ -73,6 +73,18 @@ void PhysicalDevice::get_command_queues() {
     if(!queues_.transfer.count) {
         queues_.transfer = queues_.present;
     }
+
+    // Compute work can run alongside graphics on a dedicated family
+    queues_.compute = queues_.graphics;
+    for(i = 0; i < families.size(); i++) {
+        auto flags = families[i].queueFlags;
+        if((flags & vk::QueueFlagBits::eCompute) && 
+           !(flags & vk::QueueFlagBits::eGraphics)) {
+            queues_.compute.index = i;
+            queues_.compute.count = families[i].queueCount;
+            break;
+        }
+    }
 }
 
 vk::PhysicalDevice &PhysicalDevice::get_handle() {
@@ -108,6 +120,14 @@ vk::PhysicalDeviceLimits &PhysicalDevice::get_limits() {
     return properties_.limits;
 }
 
+vk::PhysicalDeviceProperties &PhysicalDevice::get_properties() {
+    return properties_;
+}
+
+vk::PhysicalDeviceFeatures &PhysicalDevice::get_features() {
+    return features_;
+}
+
 vk::FormatProperties PhysicalDevice::get_format_properties(vk::Format format) {
     return handle_.getFormatProperties(format);
 }
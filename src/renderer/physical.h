@@ -15,6 +15,7 @@ struct AvailableQueues {
     QueueFamily graphics; // Graphics commands
     QueueFamily present;  // Presentation commands
     QueueFamily transfer; // Buffer transfer commands
+    QueueFamily compute;  // Async compute commands
 };
 
 struct SwapchainSupport {
@@ -70,9 +71,15 @@ public:
     // Get the memory properties of the device
     vk::PhysicalDeviceMemoryProperties &get_memory();
 
+    // Get the features supported by the device
+    vk::PhysicalDeviceFeatures &get_features();
+
     // Get the limit constants of the device
     vk::PhysicalDeviceLimits &get_limits();
 
+    // Get the identity and driver version of the device
+    vk::PhysicalDeviceProperties &get_properties();
+
     // Get the image format properties of the device
     vk::FormatProperties get_format_properties(vk::Format format);
 
@@ -0,0 +1,157 @@
+#include "pipecache.h"
+
+// Hash the cache data to catch files truncated or corrupted on disk
+uint64_t hash_cache_data(const char *data, size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    for(size_t i = 0; i < size; i++) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+PipelineCache::PipelineCache(vk::Device &logical,
+                             PhysicalDevice &physical,
+                             std::string filename) : physical_(physical) {
+    logical_ = logical;
+    filename_ = filename;
+
+    std::vector<char> data = load();
+    vk::PipelineCacheCreateInfo cache_info;
+    cache_info.initialDataSize = data.size();
+    cache_info.pInitialData = data.empty() ? nullptr : &data[0];
+    cache_ = logical_.createPipelineCacheUnique(cache_info);
+    stats_.warm = !data.empty();
+    stats_.loaded_size = data.size();
+}
+
+PipelineCacheHeader PipelineCache::get_header(const std::vector<char> &data) {
+    auto &properties = physical_.get_properties();
+    PipelineCacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, PIPELINE_CACHE_MAGIC, 4);
+    header.version = PIPELINE_CACHE_VERSION;
+    header.vendor_id = properties.vendorID;
+    header.device_id = properties.deviceID;
+    header.driver_version = properties.driverVersion;
+    std::memcpy(header.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+    header.data_size = data.size();
+    header.checksum = hash_cache_data(data.data(), data.size());
+    return header;
+}
+
+std::vector<char> PipelineCache::load() {
+    std::ifstream file(filename_, std::ios::ate | std::ios::binary);
+    if(!file.is_open()) {
+        return {};
+    }
+    size_t size = file.tellg();
+    PipelineCacheHeader header;
+    if(size < sizeof(header)) {
+        return {};
+    }
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(&header), sizeof(header));
+    if(header.data_size != size - sizeof(header)) {
+        return {};
+    }
+    std::vector<char> data(header.data_size);
+    if(!data.empty()) {
+        file.read(&data[0], data.size());
+    }
+    if(!file) {
+        return {};
+    }
+
+    // The device, its driver and the data must all match
+    PipelineCacheHeader expected = get_header(data);
+    if(std::memcmp(header.magic, expected.magic, 4) ||
+       header.version != expected.version ||
+       header.vendor_id != expected.vendor_id ||
+       header.device_id != expected.device_id ||
+       header.driver_version != expected.driver_version ||
+       std::memcmp(header.uuid, expected.uuid, VK_UUID_SIZE) ||
+       header.checksum != expected.checksum) {
+        return {};
+    }
+
+    // So must the driver's own header
+    // headerSize, headerVersion, vendorID, deviceID, pipelineCacheUUID
+    uint32_t vk_header[4];
+    if(data.size() < sizeof(vk_header) + VK_UUID_SIZE) {
+        return {};
+    }
+    std::memcpy(vk_header, &data[0], sizeof(vk_header));
+    if(vk_header[1] != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+       vk_header[2] != expected.vendor_id ||
+       vk_header[3] != expected.device_id ||
+       std::memcmp(&data[sizeof(vk_header)], expected.uuid, VK_UUID_SIZE)) {
+        return {};
+    }
+    return data;
+}
+
+void PipelineCache::save() {
+    std::vector<uint8_t> cache_data = logical_.getPipelineCacheData(cache_.get());
+    std::vector<char> data(cache_data.begin(), cache_data.end());
+    PipelineCacheHeader header = get_header(data);
+
+    std::string temporary = filename_ + ".tmp";
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    if(!file.is_open()) {
+        throw std::runtime_error("Could not write pipeline cache: " + temporary);
+    }
+    file.write(reinterpret_cast<char *>(&header), sizeof(header));
+    file.write(data.data(), data.size());
+    file.close();
+    if(!file) {
+        throw std::runtime_error("Could not write pipeline cache: " + temporary);
+    }
+
+    // Renaming does not replace an existing file everywhere
+    std::remove(filename_.c_str());
+    if(std::rename(temporary.c_str(), filename_.c_str())) {
+        throw std::runtime_error("Could not write pipeline cache: " + filename_);
+    }
+    stats_.saved_size = data.size();
+}
+
+vk::UniquePipeline PipelineCache::create_graphics_pipeline(const vk::GraphicsPipelineCreateInfo &info) {
+    auto start = std::chrono::high_resolution_clock::now();
+    vk::UniquePipeline pipeline = logical_.createGraphicsPipelineUnique(
+        cache_.get(),
+        info
+    ).value;
+    double create_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::high_resolution_clock::now() - start
+    ).count();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.create_ms += create_ms;
+    stats_.pipelines++;
+    return pipeline;
+}
+
+vk::UniquePipeline PipelineCache::create_compute_pipeline(const vk::ComputePipelineCreateInfo &info) {
+    auto start = std::chrono::high_resolution_clock::now();
+    vk::UniquePipeline pipeline = logical_.createComputePipelineUnique(
+        cache_.get(),
+        info
+    ).value;
+    double create_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::high_resolution_clock::now() - start
+    ).count();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.create_ms += create_ms;
+    stats_.pipelines++;
+    return pipeline;
+}
+
+vk::PipelineCache &PipelineCache::get_handle() {
+    return cache_.get();
+}
+
+PipelineCacheStats &PipelineCache::get_stats() {
+    return stats_;
+}
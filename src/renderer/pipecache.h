@@ -0,0 +1,93 @@
+#ifndef RENDER_PIPECACHE_H_
+#define RENDER_PIPECACHE_H_
+#define VULKAN_HPP_TYPESAFE_CONVERSION
+
+#include <vulkan/vulkan.hpp>
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+
+#include "physical.h"
+
+// Pipeline cache files store the driver's cache data behind a header
+// identifying the device and driver that produced it, since drivers
+// may not reject data from another driver version on their own
+//
+// Layout:
+// * PipelineCacheHeader
+// * Cache data from vkGetPipelineCacheData, starting with its own
+//   VkPipelineCacheHeaderVersionOne
+const char PIPELINE_CACHE_MAGIC[4] = {'P', 'C', 'A', 'C'};
+const uint32_t PIPELINE_CACHE_VERSION = 1;
+
+struct PipelineCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t vendor_id;
+    uint32_t device_id;
+    uint32_t driver_version;
+    uint8_t uuid[VK_UUID_SIZE];
+    uint32_t reserved;
+    uint64_t data_size;
+    uint64_t checksum;    // FNV-1a of the cache data
+};
+
+struct PipelineCacheStats {
+    bool warm = false;      // Valid cache data was loaded from disk
+    size_t loaded_size = 0; // Bytes of cache data loaded
+    size_t saved_size = 0;  // Bytes of cache data last saved
+    size_t pipelines = 0;   // Pipelines created through the cache
+    double create_ms = 0;   // Time spent creating them
+};
+
+// Pipeline cache shared by every pipeline of the renderer
+// Loaded from a file when created and written back by save, so that
+// later runs skip compiling the shaders already seen
+// Data from another device or driver is discarded, starting cold
+class PipelineCache {
+    vk::Device logical_;
+    PhysicalDevice &physical_;
+    std::string filename_;
+
+    vk::UniquePipelineCache cache_;
+
+    // Pipelines may be created from several threads at once
+    PipelineCacheStats stats_;
+    std::mutex mutex_;
+
+    // Read the file's cache data if it matches this device and driver
+    std::vector<char> load();
+
+    // Fill a header describing this device and driver
+    PipelineCacheHeader get_header(const std::vector<char> &data);
+
+public:
+    PipelineCache(vk::Device &logical,
+                  PhysicalDevice &physical,
+                  std::string filename);
+
+    // Write the cache data to the file
+    // Goes through a temporary file, so an interrupted save leaves the
+    // previous cache intact
+    void save();
+
+    // Create a graphics pipeline through the cache
+    vk::UniquePipeline create_graphics_pipeline(const vk::GraphicsPipelineCreateInfo &info);
+
+    // Create a compute pipeline through the cache
+    vk::UniquePipeline create_compute_pipeline(const vk::ComputePipelineCreateInfo &info);
+
+    // Get the handle to the cache
+    vk::PipelineCache &get_handle();
+
+    // Get whether the cache started warm and the pipeline creation time
+    PipelineCacheStats &get_stats();
+};
+
+#endif
@@ -1,37 +1,58 @@
 #include "pipeline.h"
 
+bool PipelineSettings::operator==(const PipelineSettings &other) const {
+    return vertex_shader == other.vertex_shader &&
+           fragment_shader == other.fragment_shader &&
+           topology == other.topology &&
+           polygon_mode == other.polygon_mode &&
+           cull_mode == other.cull_mode &&
+           blend == other.blend &&
+           depth_test == other.depth_test &&
+           depth_write == other.depth_write;
+}
+
+size_t std::hash<PipelineSettings>::operator()(PipelineSettings const &settings) const {
+    size_t hash = std::hash<std::string>()(settings.vertex_shader);
+    hash = (hash * 31) ^ std::hash<std::string>()(settings.fragment_shader);
+    hash = (hash << 4) ^ static_cast<size_t>(settings.topology);
+    hash = (hash << 2) ^ static_cast<size_t>(settings.polygon_mode);
+    hash = (hash << 2) ^ static_cast<size_t>(settings.cull_mode);
+    hash = (hash << 1) ^ static_cast<size_t>(settings.blend);
+    hash = (hash << 1) ^ static_cast<size_t>(settings.depth_test);
+    return (hash << 1) ^ static_cast<size_t>(settings.depth_write);
+}
+
 Pipeline::Pipeline(vk::Device &logical,
-                   vk::Extent2D &image_extent,
+                   PipelineCache &cache,
                    vk::DescriptorSetLayout &set_layout,
                    vk::RenderPass &render_pass,
-                   std::string vertex_shader,
-                   std::string fragment_shader,
-                   vk::PrimitiveTopology primitive_topology,
-                   vk::PolygonMode polygon_mode,
+                   const PipelineSettings &settings,
                    vk::SampleCountFlagBits msaa_samples,
-                   size_t push_constants_size) {
+                   size_t push_constants_size) : cache_(cache) {
     logical_ = logical;
     dynamic_states_ = {
+        vk::DynamicState::eViewport,      // Change viewport on resize
+        vk::DynamicState::eScissor,       // Change scissor on resize
         vk::DynamicState::eLineWidth,     // Change width of line drawing
         vk::DynamicState::eBlendConstants // Change blending function
     };
 
     create_shader_stage(
-        vertex_shader, 
+        settings.vertex_shader, 
         vk::ShaderStageFlagBits::eVertex
     );
     create_shader_stage(
-        fragment_shader, 
+        settings.fragment_shader, 
         vk::ShaderStageFlagBits::eFragment
     );
     
     create_vertex_input_state();
-    create_assembly_state(primitive_topology);
-    create_viewport_state(image_extent);
-    create_rasterization_state(polygon_mode);
+    create_assembly_state(settings.topology);
+    create_viewport_state();
+    create_rasterization_state(settings.polygon_mode, settings.cull_mode);
     create_multisampler_state(msaa_samples);
-    create_blender_state();
-    create_depth_stencil_state();
+    create_blender_state(settings.blend);
+    create_depth_stencil_state(settings.depth_test, settings.depth_write);
     create_dynamic_state();
     create_layout(set_layout, push_constants_size);
     
@@ -90,31 +111,16 @@ void Pipeline::create_assembly_state(vk::PrimitiveTopology primitive_topology) {
     assembly_state_info_.primitiveRestartEnable = false;
 }
 
-void Pipeline::create_viewport_state(vk::Extent2D &extent) {
-    // Origin
-    viewport_.x = 0.0f;
-    viewport_.y = 0.0f;
-
-    // Dimensions
-    viewport_.width = static_cast<float>(extent.width);
-    viewport_.height = static_cast<float>(extent.height);
-
-    // Render depth range
-    viewport_.minDepth = 0.0f;
-    viewport_.maxDepth = 1.0f;
-
-    // Subsection of the viewport to be used
-    scissor_.offset.x = 0;
-    scissor_.offset.y = 0;
-    scissor_.extent = extent;
-
+void Pipeline::create_viewport_state() {
+    // Both are dynamic, only their counts are fixed
     viewport_state_info_.viewportCount = 1;
-    viewport_state_info_.pViewports = &viewport_;
+    viewport_state_info_.pViewports = nullptr;
     viewport_state_info_.scissorCount = 1;
-    viewport_state_info_.pScissors = &scissor_;
+    viewport_state_info_.pScissors = nullptr;
 }
 
-void Pipeline::create_rasterization_state(vk::PolygonMode polygon_mode) {
+void Pipeline::create_rasterization_state(vk::PolygonMode polygon_mode,
+                                          vk::CullModeFlagBits cull_mode) {
     rasterization_state_info_.depthClampEnable = false;
     rasterization_state_info_.rasterizerDiscardEnable = false;
 
@@ -126,7 +132,7 @@ void Pipeline::create_rasterization_state(vk::PolygonMode polygon_mode) {
     rasterization_state_info_.lineWidth = 1.0;
 
     // Backface culling?
-    rasterization_state_info_.cullMode = vk::CullModeFlagBits::eBack;
+    rasterization_state_info_.cullMode = cull_mode;
     rasterization_state_info_.frontFace = vk::FrontFace::eCounterClockwise;
     
     // Manipulate the depth values?
@@ -145,9 +151,9 @@ void Pipeline::create_multisampler_state(vk::SampleCountFlagBits msaa_samples) {
     multisampler_state_info_.minSampleShading = 0.5f; 
 }
 
-void Pipeline::create_blender_state() {
+void Pipeline::create_blender_state(bool blend) {
     // TODO: Allow custom blend function? Add, subtract, multiply, etc.
-    blender_attachment_.blendEnable = true;
+    blender_attachment_.blendEnable = blend;
     blender_attachment_.colorWriteMask = 
         vk::ColorComponentFlagBits::eR |
         vk::ColorComponentFlagBits::eG |
@@ -170,9 +176,9 @@ void Pipeline::create_blender_state() {
     blender_state_info_.pAttachments = &blender_attachment_;
 }
 
-void Pipeline::create_depth_stencil_state() {
-    depth_stencil_state_info_.depthTestEnable = true;
-    depth_stencil_state_info_.depthWriteEnable = true;
+void Pipeline::create_depth_stencil_state(bool depth_test, bool depth_write) {
+    depth_stencil_state_info_.depthTestEnable = depth_test;
+    depth_stencil_state_info_.depthWriteEnable = depth_write;
     depth_stencil_state_info_.depthCompareOp = vk::CompareOp::eLess;
     depth_stencil_state_info_.depthBoundsTestEnable = false;
     depth_stencil_state_info_.stencilTestEnable = false;
@@ -227,10 +233,7 @@ void Pipeline::assemble_stages(vk::RenderPass &render_pass) {
     pipeline_info.basePipelineHandle = nullptr;
     pipeline_info.basePipelineIndex = 0;
 
-    pipeline_ = logical_.createGraphicsPipelineUnique(
-        nullptr, // TODO: Pipeline cache 
-        pipeline_info
-    ).value;
+    pipeline_ = cache_.create_graphics_pipeline(pipeline_info);
 }
 
 vk::Pipeline &Pipeline::get_handle() {
@@ -4,12 +4,35 @@
 #include <vulkan/vulkan.hpp>
 
 #include <vector>
+#include <string>
 #include <fstream>
 
 #include "vertex.h"
+#include "pipecache.h"
+
+// Describes the state of a graphics pipeline
+struct PipelineSettings {
+    std::string vertex_shader = "base.vert.spv";
+    std::string fragment_shader = "base.frag.spv";
+    vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList;
+    vk::PolygonMode polygon_mode = vk::PolygonMode::eFill;
+    vk::CullModeFlagBits cull_mode = vk::CullModeFlagBits::eBack;
+    bool blend = true;
+    bool depth_test = true;
+    bool depth_write = true;
+
+    bool operator==(const PipelineSettings &other) const;
+};
+
+// Custom hash function for pipeline settings
+template <>
+struct std::hash<PipelineSettings> {
+    size_t operator()(PipelineSettings const &settings) const;
+};
 
 class Pipeline {
     vk::Device logical_;
+    PipelineCache &cache_;
     vk::UniquePipelineLayout layout_;
     vk::UniquePipeline pipeline_;
     
@@ -18,9 +41,6 @@ class Pipeline {
     vk::VertexInputBindingDescription binding_description_;
     std::vector<vk::VertexInputAttributeDescription> attribute_descriptions_;
     
-    vk::Viewport viewport_;
-    vk::Rect2D scissor_;
-
     vk::PipelineColorBlendAttachmentState blender_attachment_;
 
     std::vector<vk::DynamicState> dynamic_states_;
@@ -47,20 +67,22 @@ class Pipeline {
     void create_assembly_state(vk::PrimitiveTopology primitive_topology);
 
     // Describe the viewport
-    void create_viewport_state(vk::Extent2D &extent);
+    // Its size is set while recording, so resizing keeps the pipeline
+    void create_viewport_state();
 
     // Describe the rasterization process
-    void create_rasterization_state(vk::PolygonMode polygon_mode);
+    void create_rasterization_state(vk::PolygonMode polygon_mode,
+                                    vk::CullModeFlagBits cull_mode);
 
     // Describe the multisampling process
     void create_multisampler_state(vk::SampleCountFlagBits msaa_samples);
 
     // Describe the color blender
     // TODO: Can be customized to allow different blend modes
-    void create_blender_state();
+    void create_blender_state(bool blend);
     
     // Describe the depth stencil
-    void create_depth_stencil_state();
+    void create_depth_stencil_state(bool depth_test, bool depth_write);
 
     // Specify all dynamic states that can be manipulated
     // from the command buffer
@@ -75,13 +97,10 @@ class Pipeline {
 
 public:
     Pipeline(vk::Device &logical,
-             vk::Extent2D &image_extent,
+             PipelineCache &cache,
              vk::DescriptorSetLayout &set_layout,
              vk::RenderPass &render_pass,
-             std::string vertex_shader,
-             std::string fragment_shader,
-             vk::PrimitiveTopology primitive_topology,
-             vk::PolygonMode polygon_mode,
+             const PipelineSettings &settings,
              vk::SampleCountFlagBits msaa_samples,
              size_t push_constants_size);
 
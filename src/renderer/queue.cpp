@@ -0,0 +1,61 @@
+#include "queue.h"
+
+uint64_t make_sort_key(uint32_t pipeline, int texture, float depth) {
+    const uint64_t depth_max = (1ull << SORT_DEPTH_BITS) - 1;
+    float clamped = depth < 0 ? 0 : (depth > 1 ? 1 : depth);
+    uint64_t key = pipeline & ((1u << SORT_PIPELINE_BITS) - 1);
+    key = (key << SORT_TEXTURE_BITS) | (static_cast<uint32_t>(texture) & ((1u << SORT_TEXTURE_BITS) - 1));
+    key = (key << SORT_DEPTH_BITS) | static_cast<uint64_t>(clamped * depth_max);
+    return key;
+}
+
+uint32_t get_sort_pipeline(uint64_t key) {
+    return key >> (SORT_TEXTURE_BITS + SORT_DEPTH_BITS);
+}
+
+void RenderQueue::clear() {
+    items_.clear();
+}
+
+void RenderQueue::push(uint64_t key, int draw) {
+    items_.push_back({key, draw});
+}
+
+void RenderQueue::sort() {
+    // Least significant digit first, one byte per pass
+    // Passes where every key has the same digit are skipped, which is
+    // most of them when few pipelines and textures are in use
+    scratch_.resize(items_.size());
+    for(uint32_t shift = 0; shift < 64; shift += 8) {
+        size_t counts[256] = {0};
+        for(Item &item : items_) {
+            counts[(item.key >> shift) & 0xFF]++;
+        }
+        if(counts[(items_.empty() ? 0 : items_[0].key >> shift) & 0xFF] == items_.size()) {
+            continue;
+        }
+
+        size_t offsets[256];
+        size_t offset = 0;
+        for(int digit = 0; digit < 256; digit++) {
+            offsets[digit] = offset;
+            offset += counts[digit];
+        }
+        for(Item &item : items_) {
+            scratch_[offsets[(item.key >> shift) & 0xFF]++] = item;
+        }
+        items_.swap(scratch_);
+    }
+}
+
+size_t RenderQueue::get_size() {
+    return items_.size();
+}
+
+uint64_t RenderQueue::get_key(size_t i) {
+    return items_[i].key;
+}
+
+int RenderQueue::get_draw(size_t i) {
+    return items_[i].draw;
+}
@@ -0,0 +1,56 @@
+#ifndef RENDER_QUEUE_H_
+#define RENDER_QUEUE_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Sort key layout, most significant first:
+// * Pipeline - 16 bits
+// * Texture  - 24 bits
+// * Depth    - 24 bits
+// Sorting by key groups draws by the state they bind, most expensive
+// to switch first, then orders each group front to back
+constexpr uint32_t SORT_PIPELINE_BITS = 16;
+constexpr uint32_t SORT_TEXTURE_BITS = 24;
+constexpr uint32_t SORT_DEPTH_BITS = 24;
+
+// Build the sort key of a draw
+// Depth is clamped to [0, 1]
+uint64_t make_sort_key(uint32_t pipeline, int texture, float depth);
+
+// Get the pipeline of a sort key
+uint32_t get_sort_pipeline(uint64_t key);
+
+// Draws of a frame in state order
+// Keys are radix sorted, so sorting is linear in the number of draws
+class RenderQueue {
+    struct Item {
+        uint64_t key;
+        int draw;
+    };
+
+    std::vector<Item> items_;
+    std::vector<Item> scratch_;
+
+public:
+    // Remove all draws
+    void clear();
+
+    // Queue a draw with its sort key
+    void push(uint64_t key, int draw);
+
+    // Sort the draws by key, keeping the queued order of equal keys
+    void sort();
+
+    // Get the number of queued draws
+    size_t get_size();
+
+    // Get the sort key of the i-th draw
+    uint64_t get_key(size_t i);
+
+    // Get the i-th draw
+    int get_draw(size_t i);
+};
+
+#endif
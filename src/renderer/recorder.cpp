@@ -0,0 +1,188 @@
+#include "recorder.h"
+
+CommandRecorder::CommandRecorder(vk::Device &logical,
+                                 ThreadPool &workers,
+                                 uint32_t graphics_family,
+                                 uint32_t images) :
+    logical_(logical),
+    workers_(workers) {
+    images_ = images;
+    threads_ = workers_.get_size();
+    dirty_.resize(images_, true);
+
+    for(unsigned i = 0; i < workers_.get_size(); i++) {
+        vk::CommandPoolCreateInfo pool_info;
+        pool_info.flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+        pool_info.queueFamilyIndex = graphics_family;
+        pools_.push_back(logical_.createCommandPoolUnique(pool_info));
+    }
+}
+
+void CommandRecorder::invalidate_batch(size_t batch) {
+    std::fill(batches_[batch].dirty.begin(), batches_[batch].dirty.end(), true);
+    std::fill(dirty_.begin(), dirty_.end(), true);
+}
+
+void CommandRecorder::set_threads(unsigned threads) {
+    threads_ = std::max(1u, std::min(threads, get_max_threads()));
+}
+
+unsigned CommandRecorder::get_max_threads() {
+    return pools_.size();
+}
+
+void CommandRecorder::add_batch() {
+    // Batches are spread over the pools, so that each pool's
+    // batches can be recorded by one thread
+    vk::CommandBufferAllocateInfo alloc_info;
+    alloc_info.commandPool = pools_[batches_.size() % pools_.size()].get();
+    alloc_info.level = vk::CommandBufferLevel::eSecondary;
+    alloc_info.commandBufferCount = images_;
+
+    Batch created;
+    created.commands = logical_.allocateCommandBuffersUnique(alloc_info);
+    created.dirty.resize(images_, true);
+    created.changes.resize(images_);
+    batches_.push_back(std::move(created));
+}
+
+void CommandRecorder::add(int draw) {
+    size_t batch = 0;
+    while(batch < batches_.size() && batches_[batch].draws.size() >= RECORD_BATCH_SIZE) {
+        batch++;
+    }
+    if(batch == batches_.size()) {
+        add_batch();
+    }
+    batches_[batch].draws.push_back(draw);
+    draw_batches_[draw] = batch;
+    invalidate_batch(batch);
+}
+
+void CommandRecorder::remove(int draw) {
+    auto it = draw_batches_.find(draw);
+    if(it == draw_batches_.end()) {
+        return;
+    }
+    std::vector<int> &draws = batches_[it->second].draws;
+    draws.erase(std::find(draws.begin(), draws.end(), draw));
+    invalidate_batch(it->second);
+    draw_batches_.erase(it);
+}
+
+void CommandRecorder::invalidate(int draw) {
+    auto it = draw_batches_.find(draw);
+    if(it != draw_batches_.end()) {
+        invalidate_batch(it->second);
+    }
+}
+
+void CommandRecorder::order(const std::vector<int> &draws) {
+    size_t needed = (draws.size() + RECORD_BATCH_SIZE - 1) / RECORD_BATCH_SIZE;
+    while(batches_.size() < needed) {
+        add_batch();
+    }
+    for(size_t batch = 0; batch < batches_.size(); batch++) {
+        size_t first = std::min(batch * RECORD_BATCH_SIZE, draws.size());
+        size_t last = std::min(first + RECORD_BATCH_SIZE, draws.size());
+        std::vector<int> &current = batches_[batch].draws;
+        if(current.size() == last - first && 
+           std::equal(current.begin(), current.end(), draws.begin() + first)) {
+            continue;
+        }
+        current.assign(draws.begin() + first, draws.begin() + last);
+        for(int draw : current) {
+            draw_batches_[draw] = batch;
+        }
+        invalidate_batch(batch);
+    }
+}
+
+void CommandRecorder::invalidate_all() {
+    for(size_t batch = 0; batch < batches_.size(); batch++) {
+        invalidate_batch(batch);
+    }
+}
+
+void CommandRecorder::invalidate_image(uint32_t image) {
+    for(auto &batch : batches_) {
+        batch.dirty[image] = true;
+    }
+    dirty_[image] = true;
+}
+
+bool CommandRecorder::is_dirty(uint32_t image) {
+    return dirty_[image];
+}
+
+void CommandRecorder::record(uint32_t image,
+                             vk::RenderPass render_pass,
+                             vk::Framebuffer framebuffer,
+                             const RecordFunction &draw) {
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<size_t> dirty;
+    size_t draws = 0;
+    for(size_t batch = 0; batch < batches_.size(); batch++) {
+        if(batches_[batch].dirty[image] && !batches_[batch].draws.empty()) {
+            dirty.push_back(batch);
+            draws += batches_[batch].draws.size();
+        }
+        batches_[batch].dirty[image] = false;
+    }
+
+    // Each task records the batches of the pools assigned to it
+    unsigned tasks = std::min<size_t>(threads_, dirty.size());
+    for(unsigned task = 0; task < tasks; task++) {
+        workers_.submit([this, task, tasks, image, render_pass, framebuffer, &dirty, &draw]() {
+            vk::CommandBufferInheritanceInfo inheritance_info;
+            inheritance_info.renderPass = render_pass;
+            inheritance_info.subpass = 0;
+            inheritance_info.framebuffer = framebuffer;
+
+            vk::CommandBufferBeginInfo begin_info;
+            begin_info.flags = vk::CommandBufferUsageFlagBits::eRenderPassContinue;
+            begin_info.pInheritanceInfo = &inheritance_info;
+
+            for(size_t batch : dirty) {
+                if((batch % pools_.size()) % tasks != task) {
+                    continue;
+                }
+                vk::CommandBuffer command_buffer = batches_[batch].commands[image].get();
+                command_buffer.begin(begin_info);
+                batches_[batch].changes[image] = draw(command_buffer, image, batches_[batch].draws);
+                command_buffer.end();
+            }
+        });
+    }
+    workers_.wait();
+    dirty_[image] = false;
+
+    stats_.draws = draws;
+    stats_.batches = dirty.size();
+    stats_.threads = tasks;
+    stats_.pipelines = 0;
+    stats_.binds = 0;
+    for(auto &batch : batches_) {
+        if(!batch.draws.empty()) {
+            stats_.pipelines += batch.changes[image].pipelines;
+            stats_.binds += batch.changes[image].binds;
+        }
+    }
+    stats_.record_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::high_resolution_clock::now() - start
+    ).count();
+}
+
+std::vector<vk::CommandBuffer> CommandRecorder::get_commands(uint32_t image) {
+    std::vector<vk::CommandBuffer> commands;
+    for(auto &batch : batches_) {
+        if(!batch.draws.empty()) {
+            commands.push_back(batch.commands[image].get());
+        }
+    }
+    return commands;
+}
+
+RecordStats &CommandRecorder::get_stats() {
+    return stats_;
+}
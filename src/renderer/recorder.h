@@ -0,0 +1,130 @@
+#ifndef RENDER_RECORDER_H_
+#define RENDER_RECORDER_H_
+#define VULKAN_HPP_TYPESAFE_CONVERSION
+
+#include <vulkan/vulkan.hpp>
+
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+
+#include "threads.h"
+
+// Most draws recorded into a single secondary command buffer
+constexpr size_t RECORD_BATCH_SIZE = 256;
+
+// State changes recorded into a command buffer
+struct StateChanges {
+    size_t pipelines = 0; // Pipeline binds
+    size_t binds = 0;     // Buffer, descriptor set and push constant binds
+};
+
+// Timings of the last command recording
+struct RecordStats {
+    size_t draws = 0;     // Draws re-recorded
+    size_t batches = 0;   // Secondary buffers re-recorded
+    unsigned threads = 0;
+    double record_ms = 0;
+
+    // State changes of the recorded image's whole frame
+    size_t pipelines = 0;
+    size_t binds = 0;
+};
+
+// Records a batch of draws into a secondary command buffer
+// Returns the state changes it recorded
+using RecordFunction = std::function<
+    StateChanges(vk::CommandBuffer command_buffer, uint32_t image, const std::vector<int> &draws)
+>;
+
+// Caches the draws in batches of secondary command buffers, one per
+// swapchain image, that the primaries execute
+// Changing a draw only dirties its batch, and each image re-records
+// just its dirty batches, split across worker threads
+// Every pool is only ever used by one thread at a time, since a pool
+// cannot be used from several threads at once
+class CommandRecorder {
+    struct Batch {
+        std::vector<int> draws;
+        std::vector<vk::UniqueCommandBuffer> commands;
+        std::vector<bool> dirty;
+        std::vector<StateChanges> changes;
+    };
+
+    vk::Device logical_;
+    ThreadPool &workers_;
+    uint32_t images_;
+
+    std::vector<vk::UniqueCommandPool> pools_;
+    std::vector<Batch> batches_;
+    std::unordered_map<int, size_t> draw_batches_;
+
+    // Images with dirty batches
+    std::vector<bool> dirty_;
+
+    unsigned threads_;
+    RecordStats stats_;
+
+    // Mark a batch as changed for every image
+    void invalidate_batch(size_t batch);
+
+    // Add an empty batch with a command buffer per image
+    void add_batch();
+
+public:
+    CommandRecorder(vk::Device &logical,
+                    ThreadPool &workers,
+                    uint32_t graphics_family,
+                    uint32_t images);
+
+    // Set the number of threads to record with
+    void set_threads(unsigned threads);
+
+    // Get the maximum number of recording threads
+    unsigned get_max_threads();
+
+    // Add a draw to a batch with room left
+    void add(int draw);
+
+    // Remove a draw from its batch
+    void remove(int draw);
+
+    // Mark a draw as changed
+    void invalidate(int draw);
+
+    // Spread the draws over the batches in the given order, filling
+    // each batch before the next, so the order holds across batches
+    // Must list every added draw
+    // Only batches whose draws changed are re-recorded
+    void order(const std::vector<int> &draws);
+
+    // Mark every batch as changed, e.g., after the framebuffers or
+    // descriptor sets are recreated
+    void invalidate_all();
+
+    // Mark every batch of an image as changed, e.g., after its
+    // descriptor set is updated
+    void invalidate_image(uint32_t image);
+
+    // Does an image have batches to re-record?
+    bool is_dirty(uint32_t image);
+
+    // Re-record the dirty batches of an image
+    // The image's previously submitted commands must have finished
+    // The primary must be re-recorded afterwards, since it executes
+    // the batches
+    void record(uint32_t image,
+                vk::RenderPass render_pass,
+                vk::Framebuffer framebuffer,
+                const RecordFunction &draw);
+
+    // Get the secondary buffers of an image's non-empty batches
+    std::vector<vk::CommandBuffer> get_commands(uint32_t image);
+
+    // Get the timings of the last recording
+    RecordStats &get_stats();
+};
+
+#endif
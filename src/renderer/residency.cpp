@@ -0,0 +1,112 @@
+#include "residency.h"
+
+TextureResidency::TextureResidency(size_t budget) {
+    budget_ = budget;
+}
+
+size_t TextureResidency::get_chain_size(Record &record, uint32_t base) {
+    return get_mip_offset(record.width, record.height, record.mip_levels) -
+           get_mip_offset(record.width, record.height, base);
+}
+
+void TextureResidency::set_budget(size_t budget) {
+    budget_ = budget;
+}
+
+size_t TextureResidency::get_budget() {
+    return budget_;
+}
+
+void TextureResidency::add(Texture texture, 
+                           uint32_t width, 
+                           uint32_t height, 
+                           uint32_t mip_levels) {
+    Record record;
+    record.width = width;
+    record.height = height;
+    record.mip_levels = mip_levels;
+    record.resident = 0;
+    record.target = 0;
+    record.screen_size = std::max(width, height);
+    records_[texture] = record;
+}
+
+void TextureResidency::remove(Texture texture) {
+    records_.erase(texture);
+}
+
+bool TextureResidency::is_tracked(Texture texture) {
+    return records_.find(texture) != records_.end();
+}
+
+void TextureResidency::set_screen_size(Texture texture, float pixels) {
+    records_.at(texture).screen_size = pixels;
+}
+
+std::vector<Texture> TextureResidency::update() {
+    // Skip the levels that are larger than needed on screen
+    size_t total = 0;
+    for(auto &pair : records_) {
+        Record &record = pair.second;
+        float ratio = std::max(record.width, record.height) / std::max(record.screen_size, 1.0f);
+        uint32_t base = ratio > 1.0f ? std::floor(std::log2(ratio)) : 0;
+        record.target = std::min(base, record.mip_levels - 1);
+        total += get_chain_size(record, record.target);
+    }
+
+    // Over budget, repeatedly drop the largest top level of any texture
+    while(total > budget_) {
+        Record *largest = nullptr;
+        size_t largest_size = 0;
+        for(auto &pair : records_) {
+            Record &record = pair.second;
+            if(record.target + 1 >= record.mip_levels) {
+                continue;
+            }
+            size_t size = get_chain_size(record, record.target) - 
+                          get_chain_size(record, record.target + 1);
+            if(size > largest_size) {
+                largest = &record;
+                largest_size = size;
+            }
+        }
+        if(!largest) {
+            break;
+        }
+        largest->target++;
+        total -= largest_size;
+    }
+
+    std::vector<Texture> changed;
+    for(auto &pair : records_) {
+        if(pair.second.target != pair.second.resident) {
+            changed.push_back(pair.first);
+        }
+    }
+    return changed;
+}
+
+uint32_t TextureResidency::get_target(Texture texture) {
+    return records_.at(texture).target;
+}
+
+uint32_t TextureResidency::get_resident(Texture texture) {
+    return records_.at(texture).resident;
+}
+
+void TextureResidency::set_resident(Texture texture, uint32_t level) {
+    records_.at(texture).resident = level;
+}
+
+size_t TextureResidency::get_target_size(Texture texture) {
+    Record &record = records_.at(texture);
+    return get_chain_size(record, record.target);
+}
+
+size_t TextureResidency::get_resident_size() {
+    size_t total = 0;
+    for(auto &pair : records_) {
+        total += get_chain_size(pair.second, pair.second.resident);
+    }
+    return total;
+}
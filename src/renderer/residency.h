@@ -0,0 +1,72 @@
+#ifndef RENDER_RESIDENCY_H_
+#define RENDER_RESIDENCY_H_
+
+#include <unordered_map>
+#include <vector>
+#include <cmath>
+
+#include "texture.h"
+#include "pack.h"
+
+// Decides which mip levels of streamable textures should be resident
+// Each texture keeps only the levels its estimated on-screen size needs,
+// and the largest levels are dropped first when over the memory budget
+class TextureResidency {
+    struct Record {
+        uint32_t width;
+        uint32_t height;
+        uint32_t mip_levels;
+        
+        uint32_t resident; // First resident mip level
+        uint32_t target;   // First mip level that should be resident
+        float screen_size; // Estimated size on screen in pixels
+    };
+
+    std::unordered_map<Texture, Record> records_;
+    size_t budget_;
+
+    // Get the size of a texture's mip chain starting at a level
+    size_t get_chain_size(Record &record, uint32_t base);
+
+public:
+    TextureResidency(size_t budget);
+
+    // Set the memory budget in bytes for all streamed textures
+    void set_budget(size_t budget);
+
+    // Get the memory budget
+    size_t get_budget();
+
+    // Track a texture, initially requesting its full mip chain
+    void add(Texture texture, uint32_t width, uint32_t height, uint32_t mip_levels);
+
+    // Stop tracking a texture
+    void remove(Texture texture);
+
+    // Check if a texture is being tracked
+    bool is_tracked(Texture texture);
+
+    // Set the largest on-screen extent a texture is drawn at
+    void set_screen_size(Texture texture, float pixels);
+
+    // Recompute the target levels of all textures
+    // Returns the textures whose resident levels differ from their targets
+    std::vector<Texture> update();
+
+    // Get the first mip level that should be resident
+    uint32_t get_target(Texture texture);
+
+    // Get the first mip level that is currently resident
+    uint32_t get_resident(Texture texture);
+
+    // Record that a texture's levels have been streamed in or out
+    void set_resident(Texture texture, uint32_t level);
+
+    // Get the bytes needed to make a texture's target levels resident
+    size_t get_target_size(Texture texture);
+
+    // Get the total size of all resident levels
+    size_t get_resident_size();
+};
+
+#endif
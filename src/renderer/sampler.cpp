@@ -0,0 +1,61 @@
+#include "sampler.h"
+
+bool SamplerSettings::operator==(const SamplerSettings &other) const {
+    return mag_filter == other.mag_filter &&
+           min_filter == other.min_filter &&
+           mipmap_mode == other.mipmap_mode &&
+           address_mode == other.address_mode &&
+           anisotropy == other.anisotropy &&
+           max_lod == other.max_lod;
+}
+
+size_t std::hash<SamplerSettings>::operator()(SamplerSettings const &settings) const {
+    size_t hash = static_cast<size_t>(settings.mag_filter);
+    hash = (hash << 2) ^ static_cast<size_t>(settings.min_filter);
+    hash = (hash << 2) ^ static_cast<size_t>(settings.mipmap_mode);
+    hash = (hash << 3) ^ static_cast<size_t>(settings.address_mode);
+    hash = (hash << 1) ^ static_cast<size_t>(settings.anisotropy);
+    return (hash << 1) ^ std::hash<float>()(settings.max_lod);
+}
+
+SamplerCache::SamplerCache(vk::Device &logical, 
+                           PhysicalDevice &physical) : physical_(physical) {
+    logical_ = logical;
+}
+
+vk::Sampler SamplerCache::get(const SamplerSettings &settings) {
+    auto it = samplers_.find(settings);
+    if(it != samplers_.end()) {
+        return it->second.get();
+    }
+
+    vk::SamplerCreateInfo sampler_info;
+    sampler_info.magFilter = settings.mag_filter;
+    sampler_info.minFilter = settings.min_filter;
+    sampler_info.mipmapMode = settings.mipmap_mode;
+
+    sampler_info.addressModeU = settings.address_mode;
+    sampler_info.addressModeV = settings.address_mode;
+    sampler_info.addressModeW = settings.address_mode;
+
+    sampler_info.mipLodBias = 0.0f;
+    
+    sampler_info.anisotropyEnable = settings.anisotropy;
+    sampler_info.maxAnisotropy = physical_.get_limits().maxSamplerAnisotropy;
+
+    sampler_info.compareEnable = false;
+    sampler_info.compareOp = vk::CompareOp::eAlways;
+
+    sampler_info.minLod = 0.0f;
+    sampler_info.maxLod = settings.max_lod;
+    
+    sampler_info.borderColor = vk::BorderColor::eIntOpaqueBlack;
+    sampler_info.unnormalizedCoordinates = false;
+
+    samplers_[settings] = logical_.createSamplerUnique(sampler_info);
+    return samplers_[settings].get();
+}
+
+size_t SamplerCache::get_size() {
+    return samplers_.size();
+}
@@ -0,0 +1,47 @@
+#ifndef RENDER_SAMPLER_H_
+#define RENDER_SAMPLER_H_
+#define VULKAN_HPP_TYPESAFE_CONVERSION
+
+#include <vulkan/vulkan.hpp>
+
+#include <unordered_map>
+
+#include "physical.h"
+
+// Describes how a texture is sampled
+struct SamplerSettings {
+    vk::Filter mag_filter = vk::Filter::eLinear;
+    vk::Filter min_filter = vk::Filter::eLinear;
+    vk::SamplerMipmapMode mipmap_mode = vk::SamplerMipmapMode::eLinear;
+    vk::SamplerAddressMode address_mode = vk::SamplerAddressMode::eRepeat;
+    bool anisotropy = true;
+    float max_lod = 0.0f;
+
+    bool operator==(const SamplerSettings &other) const;
+};
+
+// Custom hash function for sampler settings
+template <>
+struct std::hash<SamplerSettings> {
+    size_t operator()(SamplerSettings const &settings) const;
+};
+
+// Deduplicates samplers so that textures sharing the same 
+// sampling state also share a single Vulkan sampler
+class SamplerCache {
+    vk::Device logical_;
+    PhysicalDevice &physical_;
+
+    std::unordered_map<SamplerSettings, vk::UniqueSampler> samplers_;
+
+public:
+    SamplerCache(vk::Device &logical, PhysicalDevice &physical);
+
+    // Get the sampler for a set of settings, creating it if necessary
+    vk::Sampler get(const SamplerSettings &settings);
+
+    // Get the number of unique samplers created
+    size_t get_size();
+};
+
+#endif
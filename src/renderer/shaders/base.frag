@@ -2,7 +2,32 @@
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_EXT_nonuniform_qualifier : enable
 
-layout(binding = 1) uniform sampler2D textureSamplers[];
+// Virtual textures, see virtual.h for how page table entries and
+// feedback page ids are packed
+struct VirtualTexture {
+    uint width;
+    uint height;
+    uint levels;
+    uint table;
+};
+
+layout(std430, binding = 1) readonly buffer VirtualTextures {
+    uint cache;
+    uint slots;
+    uint reserved[2];
+    VirtualTexture textures[256];
+    uint pages[];
+} virtualTextures;
+
+// Compiled without the feedback write for devices whose fragment 
+// shaders cannot store to buffers
+#ifndef NO_FEEDBACK
+layout(std430, binding = 2) buffer Feedback {
+    uint pages[];
+} feedback;
+#endif
+
+layout(binding = 5) uniform sampler2D textureSamplers[];
 
 layout(location = 0) in vec4 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
@@ -10,11 +35,88 @@ layout(location = 2) flat in int textureIndex;
 
 layout(location = 0) out vec4 outColor;
 
+const uint PAGE_SIZE = 120;
+const uint PAGE_BORDER = 4;
+const uint SLOT_SIZE = 128;
+const uint FEEDBACK_SIZE = 4096;
+const uint ENTRY_VALID = 0x80000000u;
+
+// Number of pages along an axis of a mip level
+uint pageCount(uint size, uint level) {
+    return (max(size >> level, 1u) + PAGE_SIZE - 1) / PAGE_SIZE;
+}
+
+// Sample a virtual texture from the page cache
+// The page wanted at the sampled mip level is reported in the feedback
+// buffer, and the closest resident level is sampled in the meantime
+// The derivatives of uv are taken by the caller in uniform control flow
+vec4 sampleVirtual(uint index, vec2 uv, vec2 uvDx, vec2 uvDy) {
+    VirtualTexture vt = virtualTextures.textures[index];
+    uvec2 size = uvec2(vt.width, vt.height);
+
+    // Pick the mip level from the texel footprint of the pixel
+    vec2 dx = uvDx * vec2(size);
+    vec2 dy = uvDy * vec2(size);
+    float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy)));
+    uint level = uint(clamp(floor(lod + 0.5), 0.0, float(vt.levels - 1)));
+
+    // Find the page at that level
+    uv = fract(uv);
+    uvec2 pages = uvec2(pageCount(size.x, level), pageCount(size.y, level));
+    uvec2 page = min(
+        uvec2(uv * vec2(max(size >> level, uvec2(1)))) / PAGE_SIZE,
+        pages - 1
+    );
+    uint offset = vt.table;
+    for(uint i = 0; i < level; i++) {
+        offset += pageCount(size.x, i) * pageCount(size.y, i);
+    }
+    uint entry = virtualTextures.pages[offset + page.y * pages.x + page.x];
+
+    // Report the page from a sparse grid of pixels
+#ifndef NO_FEEDBACK
+    uvec2 pixel = uvec2(gl_FragCoord.xy);
+    if((pixel.x & 3) == 0 && (pixel.y & 3) == 0) {
+        uint slot = ((pixel.x >> 2) * 73856093u ^ (pixel.y >> 2) * 19349663u) % FEEDBACK_SIZE;
+        feedback.pages[slot] = page.x | (page.y << 10) | (level << 20) | (index << 24);
+    }
+#endif
+    if((entry & ENTRY_VALID) == 0) {
+        return vec4(0.0, 0.0, 0.0, 1.0);
+    }
+
+    // Sample the resident page within its slot, the border keeps
+    // filtering from reading neighboring slots
+    uint resident = (entry >> 16) & 0xFF;
+    uvec2 residentPage = page >> (resident - level);
+    vec2 texel = uv * vec2(max(size >> resident, uvec2(1))) - vec2(residentPage * PAGE_SIZE);
+    texel = clamp(texel, vec2(0.5 - PAGE_BORDER), vec2(PAGE_SIZE + PAGE_BORDER - 0.5));
+
+    uvec2 slot = uvec2(entry & 0xFF, (entry >> 8) & 0xFF);
+    vec2 physical = vec2(slot * SLOT_SIZE + PAGE_BORDER) + texel;
+    return textureLod(
+        textureSamplers[nonuniformEXT(virtualTextures.cache)],
+        physical / float(virtualTextures.slots * SLOT_SIZE),
+        0.0
+    );
+}
+
 void main() {
-    vec4 texture = texture(textureSamplers[textureIndex], fragTexCoord);
-    vec4 color = fragColor.rgba * texture.rgba;
+    // Derivatives are undefined in the branches below, since 
+    // neighboring pixels may sample different kinds of textures
+    vec2 uvDx = dFdx(fragTexCoord);
+    vec2 uvDy = dFdy(fragTexCoord);
+
+    vec4 sampled;
+    if(textureIndex < 0) {
+        sampled = sampleVirtual(uint(-textureIndex - 1), fragTexCoord, uvDx, uvDy);
+    }
+    else {
+        sampled = textureGrad(textureSamplers[textureIndex], fragTexCoord, uvDx, uvDy);
+    }
+    vec4 color = fragColor.rgba * sampled.rgba;
 
     // Discard the fragment if it is translucent
     if(color.a < 0.9) discard;
     else outColor = color;
-}
\ No newline at end of file
+}
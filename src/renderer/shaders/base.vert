@@ -3,6 +3,7 @@
 
 layout(binding = 0) uniform UniformBufferObject {
     mat4 transform;
+    vec4 planes[6];
 } ubo;
 layout(push_constant) uniform ObjectData {
     int textureIndex;
@@ -12,6 +13,24 @@ layout(push_constant) uniform ObjectData {
     int height;
 } PushConstant;
 
+// Per-instance data, found through the instance indices
+struct Object {
+    mat4 transform;
+    vec4 sphere;
+    int textureIndex;
+};
+layout(std430, binding = 3) readonly buffer Objects {
+    Object objects[];
+};
+
+// Object data slot of each instance index
+layout(std430, binding = 4) readonly buffer Instances {
+    uint instances[];
+};
+
+// Texture index pushed for indirect draws, which read theirs from objects
+const int TEXTURE_FROM_OBJECT = 0x7FFFFFFF;
+
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec4 inColor;
 layout(location = 2) in vec2 inTexCoord;
@@ -22,8 +41,12 @@ layout(location = 2) out int textureIndex;
 
 // gl_VertexIndex is the current vertex being read by the renderer!
 void main() {
-    gl_Position = ubo.transform * vec4(inPosition, 1.0);
+    Object object = objects[instances[gl_InstanceIndex]];
+    gl_Position = ubo.transform * object.transform * vec4(inPosition, 1.0);
     fragColor = inColor;
     fragTexCoord = inTexCoord;
     textureIndex = PushConstant.textureIndex;
+    if(textureIndex == TEXTURE_FROM_OBJECT) {
+        textureIndex = object.textureIndex;
+    }
 }
\ No newline at end of file
@@ -1,24 +1,58 @@
 #include "texture.h"
 
+vk::Format get_texture_format(int channels) {
+    switch(channels) {
+    case 1:
+        return vk::Format::eR8Srgb;
+    default:
+        return vk::Format::eR8G8B8A8Srgb;
+    }
+}
+
+vk::ComponentMapping get_texture_swizzle(int channels) {
+    switch(channels) {
+    case 1:
+        return {
+            vk::ComponentSwizzle::eR, 
+            vk::ComponentSwizzle::eR, 
+            vk::ComponentSwizzle::eR, 
+            vk::ComponentSwizzle::eOne
+        };
+    default:
+        return {};
+    }
+}
+
 TextureData::TextureData(uint32_t width, 
                          uint32_t height,
                          uint32_t mip_levels,
+                         int channels,
                          vk::Device &logical,
                          PhysicalDevice &physical,
                          ImageMemoryAllocator &allocator,
-                         RenderBuffer &staging_buffer,
-                         vk::CommandPool &command_pool,
-                         vk::Queue &queue) : physical_(physical), 
-                                             allocator_(allocator) {
+                         bool storage) : physical_(physical), 
+                                         allocator_(allocator) {
     logical_ = logical;
     properties_ = vk::MemoryPropertyFlagBits::eDeviceLocal;
 
     width_ = width;
     height_ = height;
     mip_levels_ = mip_levels;
-
-    command_pool_ = command_pool;
-    queue_ = queue;
+    channels_ = channels;
+    format_ = get_texture_format(channels_);
+    storage_ = storage;
+
+    // Storage images are written through views of a compatible UNORM
+    // format, since sRGB formats cannot be stored to
+    vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eTransferSrc |
+                                vk::ImageUsageFlagBits::eTransferDst | 
+                                vk::ImageUsageFlagBits::eSampled;
+    vk::ImageCreateFlags flags;
+    if(storage_) {
+        usage |= vk::ImageUsageFlagBits::eStorage;
+        flags = vk::ImageCreateFlagBits::eMutableFormat | 
+                vk::ImageCreateFlagBits::eExtendedUsage;
+    }
 
     // Create the image
     image_ = create_image(
@@ -26,30 +60,23 @@ TextureData::TextureData(uint32_t width,
         width,
         height,
         mip_levels_,
-        vk::Format::eR8G8B8A8Srgb,
+        format_,
         vk::ImageTiling::eOptimal,
-        vk::ImageUsageFlagBits::eTransferSrc |
-        vk::ImageUsageFlagBits::eTransferDst | 
-        vk::ImageUsageFlagBits::eSampled,
-        vk::SampleCountFlagBits::e1
+        usage,
+        vk::SampleCountFlagBits::e1,
+        flags
     );
     handle_ = allocator_.allocate_memory(image_.get());
-
-    // Load image data
-    transition_layout(
-        vk::ImageLayout::eUndefined, 
-        vk::ImageLayout::eTransferDstOptimal
-    );
-    copy_from_buffer(staging_buffer);
-    generate_mipmaps();
+    size_ = logical_.getImageMemoryRequirements(image_.get()).size;
 
     // Create the image view
     view_ = create_view(
         logical_,
         image_.get(),
-        vk::Format::eR8G8B8A8Srgb,
+        format_,
         vk::ImageAspectFlagBits::eColor,
-        mip_levels_
+        mip_levels_,
+        get_texture_swizzle(channels_)
     );
 }
 
@@ -57,7 +84,132 @@ TextureData::~TextureData() {
     allocator_.remove_image(handle_);
 }
 
-void TextureData::transition_layout(vk::ImageLayout from, vk::ImageLayout to) {
+void TextureData::begin_upload(vk::CommandBuffer &command_buffer) {
+    transition_layout(
+        command_buffer,
+        vk::ImageLayout::eUndefined, 
+        vk::ImageLayout::eTransferDstOptimal
+    );
+}
+
+void TextureData::end_upload(vk::CommandBuffer &command_buffer, bool mipped) {
+    if(mipped) {
+        transition_layout(
+            command_buffer,
+            vk::ImageLayout::eTransferDstOptimal, 
+            vk::ImageLayout::eShaderReadOnlyOptimal
+        );
+    }
+    else {
+        generate_mipmaps(command_buffer, {0, 0, width_, height_});
+    }
+}
+
+void TextureData::begin_update(vk::CommandBuffer &command_buffer, bool mipmaps) {
+    transition_layout(
+        command_buffer,
+        vk::ImageLayout::eShaderReadOnlyOptimal, 
+        vk::ImageLayout::eTransferDstOptimal,
+        0,
+        mipmaps ? mip_levels_ : 1
+    );
+}
+
+void TextureData::record_copy(vk::CommandBuffer &command_buffer,
+                              vk::Buffer &staging_buffer,
+                              size_t offset,
+                              TextureRect rect,
+                              uint32_t level) {
+    vk::BufferImageCopy copy_region;
+    copy_region.bufferOffset = offset;
+    copy_region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+    copy_region.imageSubresource.mipLevel = level;
+    copy_region.imageSubresource.baseArrayLayer = 0;
+    copy_region.imageSubresource.layerCount = 1;
+
+    copy_region.imageOffset.x = rect.x;
+    copy_region.imageOffset.y = rect.y;
+    copy_region.imageExtent.width = rect.width;
+    copy_region.imageExtent.height = rect.height;
+    copy_region.imageExtent.depth = 1;
+
+    command_buffer.copyBufferToImage(
+        staging_buffer,
+        image_.get(), 
+        vk::ImageLayout::eTransferDstOptimal, 
+        copy_region
+    );
+}
+
+void TextureData::end_update(vk::CommandBuffer &command_buffer, 
+                             TextureRect rect,
+                             bool mipmaps) {
+    if(mipmaps) {
+        generate_mipmaps(command_buffer, rect);
+    }
+    else {
+        transition_layout(
+            command_buffer,
+            vk::ImageLayout::eTransferDstOptimal, 
+            vk::ImageLayout::eShaderReadOnlyOptimal,
+            0,
+            1
+        );
+    }
+}
+
+void TextureData::record_copy_levels(vk::CommandBuffer &command_buffer,
+                                     TextureData &source,
+                                     uint32_t source_level,
+                                     uint32_t level,
+                                     uint32_t level_count) {
+    if(!level_count) {
+        return;
+    }
+    source.transition_layout(
+        command_buffer,
+        vk::ImageLayout::eShaderReadOnlyOptimal,
+        vk::ImageLayout::eTransferSrcOptimal,
+        source_level,
+        level_count
+    );
+
+    std::vector<vk::ImageCopy> regions(level_count);
+    for(uint32_t i = 0; i < level_count; i++) {
+        regions[i].srcSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+        regions[i].srcSubresource.mipLevel = source_level + i;
+        regions[i].srcSubresource.baseArrayLayer = 0;
+        regions[i].srcSubresource.layerCount = 1;
+
+        regions[i].dstSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
+        regions[i].dstSubresource.mipLevel = level + i;
+        regions[i].dstSubresource.baseArrayLayer = 0;
+        regions[i].dstSubresource.layerCount = 1;
+
+        regions[i].extent.width = std::max(width_ >> (level + i), 1u);
+        regions[i].extent.height = std::max(height_ >> (level + i), 1u);
+        regions[i].extent.depth = 1;
+    }
+    command_buffer.copyImage(
+        source.image_.get(), vk::ImageLayout::eTransferSrcOptimal,
+        image_.get(), vk::ImageLayout::eTransferDstOptimal,
+        regions
+    );
+
+    source.transition_layout(
+        command_buffer,
+        vk::ImageLayout::eTransferSrcOptimal,
+        vk::ImageLayout::eShaderReadOnlyOptimal,
+        source_level,
+        level_count
+    );
+}
+
+void TextureData::transition_layout(vk::CommandBuffer &command_buffer,
+                                    vk::ImageLayout from, 
+                                    vk::ImageLayout to,
+                                    uint32_t base_level,
+                                    uint32_t level_count) {
     // Define the memory barrier
     vk::ImageMemoryBarrier barrier;
     barrier.srcAccessMask = vk::AccessFlagBits::eNoneKHR;
@@ -69,8 +221,8 @@ void TextureData::transition_layout(vk::ImageLayout from, vk::ImageLayout to) {
     barrier.image = image_.get();
 
     barrier.subresourceRange.aspectMask = vk::ImageAspectFlagBits::eColor;
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = mip_levels_;
+    barrier.subresourceRange.baseMipLevel = base_level;
+    barrier.subresourceRange.levelCount = level_count;
     barrier.subresourceRange.baseArrayLayer = 0;
     barrier.subresourceRange.layerCount = 1;
     
@@ -90,100 +242,64 @@ void TextureData::transition_layout(vk::ImageLayout from, vk::ImageLayout to) {
         src_stage = vk::PipelineStageFlagBits::eTransfer;
         dst_stage = vk::PipelineStageFlagBits::eFragmentShader;
     }
-    else {
-        throw std::runtime_error("Texture loading failed, layout transition is unsupported.");
-    }
+    else if(from == vk::ImageLayout::eShaderReadOnlyOptimal && 
+            to == vk::ImageLayout::eTransferDstOptimal) {
+        // Earlier frames may still be sampling the texture
+        barrier.srcAccessMask = vk::AccessFlagBits::eShaderRead;
+        barrier.dstAccessMask = vk::AccessFlagBits::eTransferWrite;
 
-    // Allocate a new one-time command buffer for the transition
-    vk::CommandBufferAllocateInfo cmd_alloc_info;
-    cmd_alloc_info.commandPool = command_pool_;
-    cmd_alloc_info.level = vk::CommandBufferLevel::ePrimary;
-    cmd_alloc_info.commandBufferCount = 1;
+        src_stage = vk::PipelineStageFlagBits::eFragmentShader;
+        dst_stage = vk::PipelineStageFlagBits::eTransfer;
+    }
+    else if(from == vk::ImageLayout::eShaderReadOnlyOptimal && 
+            to == vk::ImageLayout::eTransferSrcOptimal) {
+        barrier.srcAccessMask = vk::AccessFlagBits::eShaderRead;
+        barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
 
-    vk::UniqueCommandBuffer command_buffer = std::move(
-        logical_.allocateCommandBuffersUnique(cmd_alloc_info)[0]
-    );
+        src_stage = vk::PipelineStageFlagBits::eFragmentShader;
+        dst_stage = vk::PipelineStageFlagBits::eTransfer;
+    }
+    else if(from == vk::ImageLayout::eTransferSrcOptimal && 
+            to == vk::ImageLayout::eShaderReadOnlyOptimal) {
+        barrier.srcAccessMask = vk::AccessFlagBits::eTransferRead;
+        barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
 
-    // Execute the transition commands
-    vk::CommandBufferBeginInfo cmd_begin_info;
-    cmd_begin_info.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
+        src_stage = vk::PipelineStageFlagBits::eTransfer;
+        dst_stage = vk::PipelineStageFlagBits::eFragmentShader;
+    }
+    else {
+        throw std::runtime_error("Texture loading failed, layout transition is unsupported.");
+    }
 
-    command_buffer->begin(cmd_begin_info);
-    command_buffer->pipelineBarrier(
+    command_buffer.pipelineBarrier(
         src_stage,
         dst_stage,
         vk::DependencyFlagBits::eByRegion, // TODO 
         nullptr, nullptr, 
         barrier
     );
-    command_buffer->end();
-
-    // Submit the command to the graphics queue
-    vk::SubmitInfo submit_info;
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = &command_buffer.get();
-
-    queue_.submit(submit_info, nullptr);
-    queue_.waitIdle();
 }
 
-void TextureData::copy_from_buffer(RenderBuffer &buffer) {
-    // Define the image copy region
-    vk::BufferImageCopy copy_region;
-    copy_region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-    copy_region.imageSubresource.mipLevel = 0;
-    copy_region.imageSubresource.baseArrayLayer = 0;
-    copy_region.imageSubresource.layerCount = 1;
-
-    copy_region.imageExtent.width = width_;
-    copy_region.imageExtent.height = height_;
-    copy_region.imageExtent.depth = 1;
-
-    // Allocate a new one-time command buffer for copying buffer data
-    vk::CommandBufferAllocateInfo cmd_alloc_info;
-    cmd_alloc_info.commandPool = command_pool_;
-    cmd_alloc_info.level = vk::CommandBufferLevel::ePrimary;
-    cmd_alloc_info.commandBufferCount = 1;
-    
-    vk::UniqueCommandBuffer command_buffer = std::move(
-        logical_.allocateCommandBuffersUnique(cmd_alloc_info)[0]
-    );
-
-    // Execute commands for copying buffer data
-    vk::CommandBufferBeginInfo cmd_begin_info;
-    cmd_begin_info.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
-
-    command_buffer->begin(cmd_begin_info);
-    command_buffer->copyBufferToImage(
-        buffer.get_handle(),
-        image_.get(), 
-        vk::ImageLayout::eTransferDstOptimal, 
-        1, 
-        &copy_region
-    );
-    command_buffer->end();
-
-    // Submit to the queue
-    vk::SubmitInfo submit_info;
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = &command_buffer.get();
-
-    queue_.submit(submit_info, nullptr);
-    queue_.waitIdle();
-}
-
-void TextureData::generate_mipmaps() {
-    auto format_properties = physical_.get_format_properties(vk::Format::eR8G8B8A8Srgb);
+void TextureData::generate_mipmaps(vk::CommandBuffer &command_buffer, 
+                                   TextureRect rect) {
+    auto format_properties = physical_.get_format_properties(format_);
     auto tiling_features = format_properties.optimalTilingFeatures;
     if(!(tiling_features & vk::FormatFeatureFlagBits::eSampledImageFilterLinear)) {
         // Cannot perform linear filtering to generate mipmaps
         // Just transition straight to shader readable layout
         transition_layout(
+            command_buffer,
             vk::ImageLayout::eTransferDstOptimal, 
             vk::ImageLayout::eShaderReadOnlyOptimal
         );
         return;
     }
+
+    // Region of the previous level, in texel coordinates
+    uint32_t x0 = rect.x;
+    uint32_t y0 = rect.y;
+    uint32_t x1 = rect.x + rect.width;
+    uint32_t y1 = rect.y + rect.height;
     
     vk::ImageMemoryBarrier barrier;
     barrier.srcQueueFamilyIndex = 0;
@@ -196,22 +312,6 @@ void TextureData::generate_mipmaps() {
     barrier.subresourceRange.baseArrayLayer = 0;
     barrier.subresourceRange.layerCount = 1;
 
-    // Allocate a new one-time command buffer for copying buffer data
-    vk::CommandBufferAllocateInfo cmd_alloc_info;
-    cmd_alloc_info.commandPool = command_pool_;
-    cmd_alloc_info.level = vk::CommandBufferLevel::ePrimary;
-    cmd_alloc_info.commandBufferCount = 1;
-    
-    vk::UniqueCommandBuffer command_buffer = std::move(
-        logical_.allocateCommandBuffersUnique(cmd_alloc_info)[0]
-    );
-
-    // Execute commands for blitting the mipped textures
-    vk::CommandBufferBeginInfo cmd_begin_info;
-    cmd_begin_info.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
-
-    command_buffer->begin(cmd_begin_info);
-
     uint32_t mip_width = width_;
     uint32_t mip_height = height_;
     for(uint32_t i = 1; i < mip_levels_; i++) {
@@ -221,7 +321,7 @@ void TextureData::generate_mipmaps() {
         barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
         barrier.dstAccessMask = vk::AccessFlagBits::eTransferRead;
 
-        command_buffer->pipelineBarrier(
+        command_buffer.pipelineBarrier(
             vk::PipelineStageFlagBits::eTransfer,
             vk::PipelineStageFlagBits::eTransfer,
             vk::DependencyFlagBits::eByRegion, 
@@ -229,32 +329,36 @@ void TextureData::generate_mipmaps() {
             barrier
         );
 
+        // Find the texels of the new mip covering the region
+        // Regions reaching the edge span to the edge of the previous
+        // level so that odd sizes are filtered as for the whole image
+        uint32_t next_width = mip_width > 1 ? mip_width / 2 : 1;
+        uint32_t next_height = mip_height > 1 ? mip_height / 2 : 1;
+        uint32_t dst_x0 = x0 / 2;
+        uint32_t dst_y0 = y0 / 2;
+        uint32_t dst_x1 = std::min((x1 + 1) / 2, next_width);
+        uint32_t dst_y1 = std::min((y1 + 1) / 2, next_height);
+        uint32_t src_x1 = dst_x1 == next_width ? mip_width : dst_x1 * 2;
+        uint32_t src_y1 = dst_y1 == next_height ? mip_height : dst_y1 * 2;
+
         // Blit the new mip
         vk::ImageBlit blit;
-        blit.srcOffsets[0] = vk::Offset3D(0, 0, 0);
-        blit.srcOffsets[1] = vk::Offset3D(
-            mip_width, 
-            mip_height, 
-            1
-        );
+        blit.srcOffsets[0] = vk::Offset3D(dst_x0 * 2, dst_y0 * 2, 0);
+        blit.srcOffsets[1] = vk::Offset3D(src_x1, src_y1, 1);
         blit.srcSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
         blit.srcSubresource.mipLevel = i - 1;
         blit.srcSubresource.baseArrayLayer = 0;
         blit.srcSubresource.layerCount = 1;
 
-        blit.dstOffsets[0] = vk::Offset3D(0, 0, 0);
-        blit.dstOffsets[1] = vk::Offset3D(
-            mip_width > 1 ? mip_width / 2 : 1,
-            mip_height > 1 ? mip_height / 2 : 1, 
-            1
-        );
+        blit.dstOffsets[0] = vk::Offset3D(dst_x0, dst_y0, 0);
+        blit.dstOffsets[1] = vk::Offset3D(dst_x1, dst_y1, 1);
         blit.dstSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
         blit.dstSubresource.mipLevel = i;
         blit.dstSubresource.baseArrayLayer = 0;
         blit.dstSubresource.layerCount = 1;
 
 
-        command_buffer->blitImage(
+        command_buffer.blitImage(
             image_.get(), vk::ImageLayout::eTransferSrcOptimal,
             image_.get(), vk::ImageLayout::eTransferDstOptimal,
             blit,
@@ -267,7 +371,7 @@ void TextureData::generate_mipmaps() {
         barrier.srcAccessMask = vk::AccessFlagBits::eTransferRead;
         barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
 
-        command_buffer->pipelineBarrier(
+        command_buffer.pipelineBarrier(
             vk::PipelineStageFlagBits::eTransfer,
             vk::PipelineStageFlagBits::eFragmentShader,
             vk::DependencyFlagBits::eByRegion, 
@@ -275,8 +379,12 @@ void TextureData::generate_mipmaps() {
             barrier
         );
 
-        if(mip_width > 1) mip_width /= 2;
-        if(mip_height > 1) mip_height /= 2;
+        mip_width = next_width;
+        mip_height = next_height;
+        x0 = dst_x0;
+        y0 = dst_y0;
+        x1 = dst_x1;
+        y1 = dst_y1;
     }
 
     // Transition last mip to optimal shader readable layout
@@ -286,22 +394,13 @@ void TextureData::generate_mipmaps() {
     barrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
     barrier.dstAccessMask = vk::AccessFlagBits::eShaderRead;
     
-    command_buffer->pipelineBarrier(
+    command_buffer.pipelineBarrier(
         vk::PipelineStageFlagBits::eTransfer,
         vk::PipelineStageFlagBits::eFragmentShader,
         vk::DependencyFlagBits::eByRegion, 
         nullptr, nullptr, 
         barrier
     );
-    command_buffer->end();
-
-    // Submit to the queue
-    vk::SubmitInfo submit_info;
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = &command_buffer.get();
-
-    queue_.submit(submit_info, nullptr);
-    queue_.waitIdle();
 }
 
 vk::Image &TextureData::get_image() {
@@ -311,3 +410,31 @@ vk::Image &TextureData::get_image() {
 vk::ImageView &TextureData::get_view() {
     return view_.get();
 }
+
+uint32_t TextureData::get_width() {
+    return width_;
+}
+
+uint32_t TextureData::get_height() {
+    return height_;
+}
+
+vk::Format TextureData::get_format() {
+    return format_;
+}
+
+bool TextureData::is_storage() {
+    return storage_;
+}
+
+int TextureData::get_channels() {
+    return channels_;
+}
+
+uint32_t TextureData::get_mip_levels() {
+    return mip_levels_;
+}
+
+vk::DeviceSize TextureData::get_memory_size() {
+    return size_;
+}
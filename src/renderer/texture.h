@@ -7,10 +7,45 @@
 #include "image.h"
 #include "buffer.h"
 #include "physical.h"
+#include "pack.h"
 
 // A unique handle to an existing texture
 using Texture = int;
 
+// Get the image format storing texels with a number of channels
+// Grey (1) texels are kept as R8, anything else is stored as RGBA
+// Grey-alpha is not kept as RG8, since sRGB formats would decode its
+// alpha channel as a color
+vk::Format get_texture_format(int channels);
+
+// Get the view swizzle that presents texels with a number of channels 
+// as RGBA, so shaders sample every texture the same way
+vk::ComponentMapping get_texture_swizzle(int channels);
+
+// Texel data to be uploaded to a new texture
+// Grey pixels are kept as they are if the device supports their
+// format, others are expanded to RGBA when staged
+// Pre-mipped data holds every mip level back to back as RGBA
+// The texture is created from base_level on, the larger levels are
+// left out until it is reallocated with them streamed in
+struct TextureUpload {
+    const unsigned char *pixels;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mip_levels;
+    int channels = 4;
+    bool mipped = false;
+    uint32_t base_level = 0;
+};
+
+// A rectangle of texels within a texture
+struct TextureRect {
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+};
+
 // Texture image data used as a descriptor
 class TextureData {
     vk::Device logical_;
@@ -24,40 +59,106 @@ class TextureData {
     // Image memory
     ImageMemoryAllocator &allocator_;
     ImageMemoryHandle handle_;
+    vk::DeviceSize size_;
 
     uint32_t width_; 
     uint32_t height_;
     uint32_t mip_levels_;
 
-    vk::CommandPool command_pool_;
-    vk::Queue queue_;
+    // Channels stored per texel
+    int channels_;
+    vk::Format format_;
 
-    // Transition the image layout
-    void transition_layout(vk::ImageLayout from, vk::ImageLayout to);
+    // Can mip levels be written by compute shaders?
+    bool storage_;
 
-    // Copy texel data from the buffer
-    void copy_from_buffer(RenderBuffer &buffer);
+    // Record the image layout transition of a range of mip levels
+    void transition_layout(vk::CommandBuffer &command_buffer,
+                           vk::ImageLayout from, 
+                           vk::ImageLayout to,
+                           uint32_t base_level = 0,
+                           uint32_t level_count = VK_REMAINING_MIP_LEVELS);
 
-    // Generate the various mipmap levels for the texture
-    void generate_mipmaps();
+    // Record generating the various mipmap levels for the texture
+    // Only the texels covering a region of the base level are rebuilt
+    void generate_mipmaps(vk::CommandBuffer &command_buffer, 
+                          TextureRect rect);
 
 public:
     TextureData(uint32_t width, 
                 uint32_t height,
                 uint32_t mip_levels,
+                int channels,
                 vk::Device &logical,
                 PhysicalDevice &physical,
                 ImageMemoryAllocator &allocator,
-                RenderBuffer &staging_buffer,
-                vk::CommandPool &command_pool,
-                vk::Queue &queue);
+                bool storage = false);
     ~TextureData();
 
+    // Record the transition before uploading the initial texel data
+    // The copies may be spread over several command buffers, as long
+    // as they are submitted in order to the same queue
+    void begin_upload(vk::CommandBuffer &command_buffer);
+
+    // Record the transition to shader reads after uploading
+    // If the uploaded data is pre-mipped, all levels were copied as-is,
+    // otherwise they are generated from the base level
+    void end_upload(vk::CommandBuffer &command_buffer, bool mipped = false);
+
+    // Record the transition before updating regions of the texture
+    // Mip levels are only made writable if they will be regenerated
+    void begin_update(vk::CommandBuffer &command_buffer, bool mipmaps);
+
+    // Record copying tightly packed texels from a buffer into a 
+    // region of a mip level
+    void record_copy(vk::CommandBuffer &command_buffer,
+                     vk::Buffer &staging_buffer,
+                     size_t offset,
+                     TextureRect rect,
+                     uint32_t level = 0);
+
+    // Record the transition back to shader reads after updating
+    // Mip levels covering the updated region are regenerated
+    void end_update(vk::CommandBuffer &command_buffer, 
+                    TextureRect rect,
+                    bool mipmaps);
+
+    // Record copying whole mip levels of another texture with the same
+    // format into this one, e.g., when a streamed texture is reallocated
+    // This texture's levels must be transitioned for the upload, the 
+    // source's are left for shader reads
+    void record_copy_levels(vk::CommandBuffer &command_buffer,
+                            TextureData &source,
+                            uint32_t source_level,
+                            uint32_t level,
+                            uint32_t level_count);
+
     // Get the image this texture refers to
     vk::Image &get_image();
 
     // Get the image view of this texture
     vk::ImageView &get_view();
+
+    // Get the width of the base level
+    uint32_t get_width();
+
+    // Get the height of the base level
+    uint32_t get_height();
+
+    // Get the format of the texel data
+    vk::Format get_format();
+
+    // Can mip levels be written by compute shaders?
+    bool is_storage();
+
+    // Get the number of channels stored per texel
+    int get_channels();
+
+    // Get the number of mip levels of this texture
+    uint32_t get_mip_levels();
+
+    // Get the bytes of device memory bound to the image
+    vk::DeviceSize get_memory_size();
 };
 
 #endif
\ No newline at end of file
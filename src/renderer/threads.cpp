@@ -0,0 +1,79 @@
+#include "threads.h"
+
+ThreadPool::ThreadPool(unsigned count) {
+    active_ = 0;
+    stopping_ = false;
+    for(unsigned i = 0; i < count; i++) {
+        workers_.emplace_back(&ThreadPool::work, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    available_.notify_all();
+    for(auto &worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::work() {
+    while(true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            available_.wait(lock, [this]() {
+                return stopping_ || !tasks_.empty();
+            });
+            if(stopping_ && tasks_.empty()) {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop();
+            active_++;
+        }
+        // A throwing task must not take down the worker, its error
+        // is handed to the thread waiting on the pool
+        std::exception_ptr error;
+        try {
+            task();
+        }
+        catch(...) {
+            error = std::current_exception();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if(error && !error_) {
+                error_ = error;
+            }
+            active_--;
+        }
+        finished_.notify_all();
+    }
+}
+
+unsigned ThreadPool::get_size() {
+    return workers_.size();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push(std::move(task));
+    }
+    available_.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    finished_.wait(lock, [this]() {
+        return tasks_.empty() && !active_;
+    });
+    if(error_) {
+        std::exception_ptr error = error_;
+        error_ = nullptr;
+        std::rethrow_exception(error);
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef RENDER_THREADS_H_
+#define RENDER_THREADS_H_
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+// A fixed set of worker threads that execute queued tasks
+class ThreadPool {
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> tasks_;
+
+    std::mutex mutex_;
+    std::condition_variable available_;
+    std::condition_variable finished_;
+
+    int active_;
+    bool stopping_;
+
+    // First exception thrown by a task since the last wait
+    std::exception_ptr error_;
+
+    // Worker loop that runs tasks until the pool is destroyed
+    void work();
+
+public:
+    ThreadPool(unsigned count);
+    ~ThreadPool();
+
+    // Get the number of worker threads
+    unsigned get_size();
+
+    // Queue a task to be run on a worker
+    void submit(std::function<void()> task);
+
+    // Block until all queued tasks have finished
+    // Rethrows the first exception thrown by a task, if any
+    void wait();
+};
+
+#endif
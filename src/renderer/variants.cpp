@@ -0,0 +1,152 @@
+#include "variants.h"
+
+PipelineVariants::PipelineVariants(vk::Device &logical,
+                                   PipelineCache &cache,
+                                   vk::DescriptorSetLayout &set_layout,
+                                   size_t push_constants_size,
+                                   unsigned threads) : cache_(cache) {
+    logical_ = logical;
+    set_layout_ = set_layout;
+    push_constants_size_ = push_constants_size;
+    samples_ = vk::SampleCountFlagBits::e1;
+    generation_ = 0;
+    workers_ = std::make_unique<ThreadPool>(std::max(1u, threads));
+}
+
+PipelineVariants::~PipelineVariants() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        generation_++;
+    }
+    workers_.reset();
+}
+
+void PipelineVariants::compile(PipelineVariant variant, uint64_t generation) {
+    PipelineSettings settings;
+    vk::RenderPass render_pass;
+    vk::SampleCountFlagBits samples;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Variant &data = *variants_[variant];
+        if(generation != generation_ || data.ready) {
+            return;
+        }
+        settings = data.settings;
+        render_pass = render_pass_;
+        samples = samples_;
+    }
+
+    // Compiling does not hold the lock, draws keep recording meanwhile
+    std::unique_ptr<Pipeline> pipeline = std::make_unique<Pipeline>(
+        logical_,
+        cache_,
+        set_layout_,
+        render_pass,
+        settings,
+        samples,
+        push_constants_size_
+    );
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Variant &data = *variants_[variant];
+    if(generation != generation_ || data.ready) {
+        return;
+    }
+    data.pipeline = std::move(pipeline);
+    data.ready = true;
+    finished_.push_back(variant);
+}
+
+void PipelineVariants::queue(PipelineVariant variant) {
+    uint64_t generation = generation_;
+    workers_->submit([this, variant, generation]() {
+        // A variant that fails to compile stays unready, its draws
+        // are skipped rather than taking down the worker
+        try {
+            compile(variant, generation);
+        }
+        catch(std::exception &err) {
+            std::cerr << "Pipeline variant " << variant << ": " << err.what() << "\n";
+        }
+    });
+}
+
+void PipelineVariants::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        generation_++;
+    }
+    workers_->wait();
+}
+
+void PipelineVariants::set_target(vk::RenderPass render_pass, vk::SampleCountFlagBits samples) {
+    // Compiles in flight may still use the old render pass
+    stop();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    render_pass_ = render_pass;
+    samples_ = samples;
+    finished_.clear();
+    for(PipelineVariant variant = 0; variant < variants_.size(); variant++) {
+        variants_[variant]->pipeline.reset();
+        variants_[variant]->ready = false;
+        queue(variant);
+    }
+}
+
+void PipelineVariants::set_render_pass(vk::RenderPass render_pass) {
+    stop();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    render_pass_ = render_pass;
+    for(PipelineVariant variant = 0; variant < variants_.size(); variant++) {
+        if(!variants_[variant]->ready) {
+            queue(variant);
+        }
+    }
+}
+
+PipelineVariant PipelineVariants::add(const PipelineSettings &settings) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = handles_.find(settings);
+    if(it != handles_.end()) {
+        return it->second;
+    }
+    PipelineVariant variant = variants_.size();
+    variants_.push_back(std::make_unique<Variant>());
+    variants_.back()->settings = settings;
+    handles_[settings] = variant;
+
+    // Without a target yet, set_target queues it
+    if(render_pass_) {
+        queue(variant);
+    }
+    return variant;
+}
+
+void PipelineVariants::build(PipelineVariant variant) {
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        generation = generation_;
+    }
+    compile(variant, generation);
+}
+
+Pipeline *PipelineVariants::get(PipelineVariant variant) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Variant &data = *variants_[variant];
+    return data.ready ? data.pipeline.get() : nullptr;
+}
+
+std::vector<PipelineVariant> PipelineVariants::take_finished() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<PipelineVariant> finished;
+    finished.swap(finished_);
+    return finished;
+}
+
+size_t PipelineVariants::get_size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return variants_.size();
+}
@@ -0,0 +1,104 @@
+#ifndef RENDER_VARIANTS_H_
+#define RENDER_VARIANTS_H_
+#define VULKAN_HPP_TYPESAFE_CONVERSION
+
+#include <vulkan/vulkan.hpp>
+
+#include <vector>
+#include <memory>
+#include <iostream>
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
+#include "pipeline.h"
+#include "pipecache.h"
+#include "threads.h"
+
+// Handle to a registered pipeline variant
+using PipelineVariant = uint32_t;
+
+// Registry of the graphics pipelines drawn with, one per distinct set
+// of settings
+// Variants are compiled on threads of their own, so registering a new
+// combination of state never stalls a frame, and the pool shared with
+// recording is never kept busy by a compile
+// Until a variant is ready, get returns null and its draws are skipped
+class PipelineVariants {
+    struct Variant {
+        PipelineSettings settings;
+        std::unique_ptr<Pipeline> pipeline;
+        bool ready = false;
+    };
+
+    vk::Device logical_;
+    PipelineCache &cache_;
+
+    // Everything a variant is built for besides its settings
+    vk::DescriptorSetLayout set_layout_;
+    size_t push_constants_size_;
+    vk::RenderPass render_pass_;
+    vk::SampleCountFlagBits samples_;
+
+    // Variants keep their address as more are registered, so workers
+    // can fill them in while the registry grows
+    std::vector<std::unique_ptr<Variant>> variants_;
+    std::unordered_map<PipelineSettings, PipelineVariant> handles_;
+    std::vector<PipelineVariant> finished_;
+
+    // Bumped when the target changes, dropping compiles queued before
+    uint64_t generation_;
+    std::mutex mutex_;
+
+    // Declared last, so the workers are joined before anything they use
+    // is destroyed
+    std::unique_ptr<ThreadPool> workers_;
+
+    // Compile a variant for the current target, unless it is already
+    // built or the target changed since the compile was queued
+    void compile(PipelineVariant variant, uint64_t generation);
+
+    // Queue compiling a variant on the workers
+    void queue(PipelineVariant variant);
+
+public:
+    PipelineVariants(vk::Device &logical,
+                     PipelineCache &cache,
+                     vk::DescriptorSetLayout &set_layout,
+                     size_t push_constants_size,
+                     unsigned threads);
+    ~PipelineVariants();
+
+    // Drop the queued compiles and wait for those in flight
+    // Must be called before destroying the render pass they use,
+    // set_target or set_render_pass queues them again
+    void stop();
+
+    // Set the render pass and sample count the variants are built for
+    // All built variants are dropped and compiled again, so no frame
+    // may still be using them
+    void set_target(vk::RenderPass render_pass, vk::SampleCountFlagBits samples);
+
+    // Build the variants still compiling for a render pass compatible
+    // with the current target, keeping those already built
+    void set_render_pass(vk::RenderPass render_pass);
+
+    // Get the variant of a set of settings, registering it and queuing
+    // its compile if it is new
+    PipelineVariant add(const PipelineSettings &settings);
+
+    // Compile a variant on the calling thread if it is not ready
+    void build(PipelineVariant variant);
+
+    // Get a variant's pipeline, or null while it is compiling
+    // Safe to call from the recording threads
+    Pipeline *get(PipelineVariant variant);
+
+    // Get the variants that became ready since the last call
+    std::vector<PipelineVariant> take_finished();
+
+    // Get the number of registered variants
+    size_t get_size();
+};
+
+#endif
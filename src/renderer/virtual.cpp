@@ -0,0 +1,303 @@
+#include "virtual.h"
+
+PageId make_page_id(uint32_t texture, uint32_t level, uint32_t x, uint32_t y) {
+    return x | (y << 10) | (level << 20) | (texture << 24);
+}
+
+void extract_page(const unsigned char *pixels,
+                  uint32_t width, uint32_t height,
+                  uint32_t x, uint32_t y,
+                  unsigned char *page) {
+    int size = VT_SLOT_SIZE;
+    int origin_x = static_cast<int>(x * VT_PAGE_SIZE) - static_cast<int>(VT_PAGE_BORDER);
+    int origin_y = static_cast<int>(y * VT_PAGE_SIZE) - static_cast<int>(VT_PAGE_BORDER);
+
+    // Columns that lie within the level are copied in one run
+    int start = std::max(0, -origin_x);
+    int end = std::min(size, static_cast<int>(width) - origin_x);
+    for(int row = 0; row < size; row++) {
+        int src_y = clamp<int>(origin_y + row, 0, height - 1);
+        const unsigned char *src = pixels + src_y * width * 4;
+        unsigned char *dst = page + row * size * 4;
+        if(start < end) {
+            std::memcpy(
+                dst + start * 4,
+                src + (origin_x + start) * 4,
+                (end - start) * 4
+            );
+        }
+        for(int col = 0; col < start; col++) {
+            std::memcpy(dst + col * 4, src, 4);
+        }
+        for(int col = std::max(end, 0); col < size; col++) {
+            std::memcpy(dst + col * 4, src + (width - 1) * 4, 4);
+        }
+    }
+}
+
+VirtualTextures::VirtualTextures(uint32_t slots) {
+    std::memset(&header_, 0, sizeof(header_));
+    header_.slots = slots;
+
+    slots_.resize(slots * slots);
+    for(uint32_t i = 0; i < slots_.size(); i++) {
+        free_.push_back(slots_.size() - 1 - i);
+    }
+    frame_ = 0;
+    version_ = 0;
+}
+
+uint32_t VirtualTextures::get_page_count(uint32_t size, uint32_t level) {
+    uint32_t texels = std::max(size >> level, 1u);
+    return (texels + VT_PAGE_SIZE - 1) / VT_PAGE_SIZE;
+}
+
+uint32_t VirtualTextures::get_resident_entry(uint32_t slot, uint32_t level) {
+    return VT_ENTRY_VALID |
+           (slot % header_.slots) |
+           ((slot / header_.slots) << 8) |
+           (level << 16);
+}
+
+uint32_t VirtualTextures::get_parent_offset(uint32_t texture, uint32_t level, uint32_t x, uint32_t y) {
+    VirtualTextureInfo &info = header_.textures[texture];
+    uint32_t parent_columns = get_page_count(info.width, level + 1);
+    uint32_t parent_rows = get_page_count(info.height, level + 1);
+    return level_offsets_[texture][level + 1] + 
+           std::min(y / 2, parent_rows - 1) * parent_columns + 
+           std::min(x / 2, parent_columns - 1);
+}
+
+void VirtualTextures::mark_changed(uint32_t offset, uint32_t count) {
+    if(!changes_.empty() && changes_.back().first + changes_.back().second == offset) {
+        changes_.back().second += count;
+    }
+    else {
+        changes_.push_back({offset, count});
+    }
+}
+
+void VirtualTextures::update_table(PageId page) {
+    uint32_t texture = page >> 24;
+    uint32_t level = (page >> 20) & 0xF;
+    uint32_t x = page & 0x3FF;
+    uint32_t y = (page >> 10) & 0x3FF;
+    VirtualTextureInfo &info = header_.textures[texture];
+    auto &offsets = level_offsets_[texture];
+
+    uint32_t columns = get_page_count(info.width, level);
+    uint32_t offset = offsets[level] + y * columns + x;
+    auto it = resident_.find(page);
+    if(it != resident_.end()) {
+        tables_[offset] = get_resident_entry(it->second, level);
+    }
+    else if(level + 1 < info.levels) {
+        tables_[offset] = tables_[get_parent_offset(texture, level, x, y)];
+    }
+    else {
+        tables_[offset] = 0;
+    }
+    mark_changed(offset, 1);
+
+    // Walk the covered rectangle of each finer level, the entries of
+    // resident pages hold their own level and are kept
+    uint32_t x0 = x, x1 = x + 1;
+    uint32_t y0 = y, y1 = y + 1;
+    for(int child = static_cast<int>(level) - 1; child >= 0; child--) {
+        uint32_t parent_columns = columns;
+        uint32_t parent_rows = get_page_count(info.height, child + 1);
+        columns = get_page_count(info.width, child);
+        uint32_t rows = get_page_count(info.height, child);
+
+        // The last parent also covers the pages past twice its index
+        x0 *= 2;
+        y0 *= 2;
+        x1 = x1 == parent_columns ? columns : std::min(x1 * 2, columns);
+        y1 = y1 == parent_rows ? rows : std::min(y1 * 2, rows);
+        for(uint32_t row = y0; row < y1; row++) {
+            uint32_t first = offsets[child] + row * columns;
+            for(uint32_t col = x0; col < x1; col++) {
+                uint32_t &entry = tables_[first + col];
+                if((entry & VT_ENTRY_VALID) && ((entry >> 16) & 0xFF) == static_cast<uint32_t>(child)) {
+                    continue;
+                }
+                entry = tables_[get_parent_offset(texture, child, col, row)];
+            }
+            mark_changed(first + x0, x1 - x0);
+        }
+    }
+    version_++;
+}
+
+uint32_t VirtualTextures::add(uint32_t width, uint32_t height, uint32_t levels) {
+    uint32_t texture = get_count();
+    if(texture >= VT_MAX_TEXTURES) {
+        throw std::runtime_error("Too many virtual textures.");
+    }
+    if(get_page_count(width, 0) > 1024 || get_page_count(height, 0) > 1024) {
+        throw std::runtime_error("Virtual texture is too large.");
+    }
+
+    // Only keep levels down to the first one that fits in a single page
+    uint32_t used = 1;
+    while(used < levels &&
+          (get_page_count(width, used - 1) > 1 || get_page_count(height, used - 1) > 1)) {
+        used++;
+    }
+    if(get_page_count(width, used - 1) > 1 || get_page_count(height, used - 1) > 1) {
+        throw std::runtime_error("Virtual texture needs a complete mip chain.");
+    }
+
+    VirtualTextureInfo &info = header_.textures[texture];
+    info.width = width;
+    info.height = height;
+    info.levels = used;
+    info.table = tables_.size();
+
+    std::vector<uint32_t> offsets;
+    for(uint32_t level = 0; level < used; level++) {
+        offsets.push_back(tables_.size());
+        tables_.resize(
+            tables_.size() + get_page_count(width, level) * get_page_count(height, level),
+            0
+        );
+    }
+    level_offsets_.push_back(offsets);
+    mark_changed(info.table, tables_.size() - info.table);
+    version_++;
+    return texture;
+}
+
+uint32_t VirtualTextures::get_count() {
+    return level_offsets_.size();
+}
+
+void VirtualTextures::set_cache(uint32_t texture) {
+    header_.cache = texture;
+    version_++;
+}
+
+PageId VirtualTextures::get_root(uint32_t texture) {
+    return make_page_id(texture, header_.textures[texture].levels - 1, 0, 0);
+}
+
+void VirtualTextures::begin_frame() {
+    frame_++;
+    missing_.clear();
+}
+
+void VirtualTextures::request(const uint32_t *feedback, size_t count) {
+    for(size_t i = 0; i < count; i++) {
+        PageId page = feedback[i];
+        if(page == VT_FEEDBACK_EMPTY) {
+            continue;
+        }
+        uint32_t texture = page >> 24;
+        uint32_t level = (page >> 20) & 0xF;
+        uint32_t x = page & 0x3FF;
+        uint32_t y = (page >> 10) & 0x3FF;
+        if(texture >= get_count() || level >= header_.textures[texture].levels) {
+            continue;
+        }
+
+        // Keep the page, or the ancestor standing in for it, from
+        // being evicted
+        bool found = false;
+        while(!found) {
+            auto it = resident_.find(make_page_id(texture, level, x, y));
+            if(it != resident_.end()) {
+                Slot &slot = slots_[it->second];
+                if(slot.used != frame_ && !slot.pinned) {
+                    lru_.splice(lru_.end(), lru_, slot.lru);
+                }
+                slot.used = frame_;
+                found = true;
+            }
+            else if(page == make_page_id(texture, level, x, y)) {
+                missing_.push_back(page);
+            }
+            if(++level >= header_.textures[texture].levels) {
+                break;
+            }
+            x /= 2;
+            y /= 2;
+        }
+    }
+    std::sort(missing_.begin(), missing_.end());
+    missing_.erase(std::unique(missing_.begin(), missing_.end()), missing_.end());
+}
+
+std::vector<PageId> VirtualTextures::get_missing(size_t limit) {
+    // Slots that can be filled without evicting pages in use
+    size_t available = free_.size();
+    for(uint32_t slot : lru_) {
+        if(available >= limit || slots_[slot].used == frame_) {
+            break;
+        }
+        available++;
+    }
+
+    std::vector<PageId> pages = missing_;
+    std::sort(pages.begin(), pages.end(), [](PageId a, PageId b) {
+        return ((a >> 20) & 0xF) > ((b >> 20) & 0xF);
+    });
+    pages.resize(std::min({pages.size(), limit, available}));
+    return pages;
+}
+
+int VirtualTextures::place(PageId page, bool pinned) {
+    auto it = resident_.find(page);
+    if(it != resident_.end()) {
+        return it->second;
+    }
+
+    uint32_t slot;
+    if(!free_.empty()) {
+        slot = free_.back();
+        free_.pop_back();
+    }
+    else {
+        if(lru_.empty() || slots_[lru_.front()].used == frame_) {
+            return -1;
+        }
+        slot = lru_.front();
+        lru_.pop_front();
+
+        // Evict the least recently used page
+        PageId evicted = slots_[slot].page;
+        resident_.erase(evicted);
+        update_table(evicted);
+    }
+
+    slots_[slot].page = page;
+    slots_[slot].used = frame_;
+    slots_[slot].pinned = pinned;
+    if(!pinned) {
+        slots_[slot].lru = lru_.insert(lru_.end(), slot);
+    }
+    resident_[page] = slot;
+    update_table(page);
+    return slot;
+}
+
+uint64_t VirtualTextures::get_version() {
+    return version_;
+}
+
+VirtualHeader &VirtualTextures::get_header() {
+    return header_;
+}
+
+std::vector<uint32_t> &VirtualTextures::get_tables() {
+    return tables_;
+}
+
+std::vector<std::pair<uint32_t, uint32_t>> VirtualTextures::take_changes() {
+    std::vector<std::pair<uint32_t, uint32_t>> changes;
+    changes.swap(changes_);
+    return changes;
+}
+
+size_t VirtualTextures::get_resident_count() {
+    return resident_.size();
+}
@@ -0,0 +1,167 @@
+#ifndef RENDER_VIRTUAL_H_
+#define RENDER_VIRTUAL_H_
+
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+
+#include "util.h"
+
+// Texels of a virtual texture held by each page
+constexpr uint32_t VT_PAGE_SIZE = 120;
+
+// Texels repeated from neighboring pages around each page, so that
+// bilinear filtering never reads from another page in the cache
+constexpr uint32_t VT_PAGE_BORDER = 4;
+
+// Side length of a page in the physical cache
+constexpr uint32_t VT_SLOT_SIZE = VT_PAGE_SIZE + 2 * VT_PAGE_BORDER;
+
+// Maximum number of virtual textures
+constexpr uint32_t VT_MAX_TEXTURES = 256;
+
+// Number of entries of the feedback buffer
+constexpr uint32_t VT_FEEDBACK_SIZE = 4096;
+
+// Unwritten feedback entries
+constexpr uint32_t VT_FEEDBACK_EMPTY = 0xFFFFFFFF;
+
+// Page table entries pointing at a resident page
+// Bits 0-7 are the slot column, 8-15 the slot row, 16-23 the mip level
+constexpr uint32_t VT_ENTRY_VALID = 0x80000000;
+
+// Packed identifier of a page
+// Bits 0-9 are the column, 10-19 the row, 20-23 the mip level and
+// 24-31 the virtual texture, the fragment shader packs them the same way
+using PageId = uint32_t;
+
+PageId make_page_id(uint32_t texture, uint32_t level, uint32_t x, uint32_t y);
+
+// Shader-visible description of a virtual texture
+struct VirtualTextureInfo {
+    uint32_t width;
+    uint32_t height;
+    uint32_t levels;
+    uint32_t table;  // Offset of the page table in entries
+};
+
+// Shader-visible header of the page table buffer
+// Page tables of all virtual textures follow it back to back
+struct VirtualHeader {
+    uint32_t cache;  // Texture handle of the physical page cache
+    uint32_t slots;  // Slots per side of the cache
+    uint32_t reserved[2];
+    VirtualTextureInfo textures[VT_MAX_TEXTURES];
+};
+
+// Copy a page and its border out of an RGBA mip level
+// Texels past the edge of the level are clamped
+void extract_page(const unsigned char *pixels,
+                  uint32_t width, uint32_t height,
+                  uint32_t x, uint32_t y,
+                  unsigned char *page);
+
+// Tracks which pages of the virtual textures are resident in the
+// physical page cache and maintains their page tables
+// Non-resident pages point at their closest resident ancestor, so
+// sampling always finds some texels while pages stream in
+class VirtualTextures {
+    struct Slot {
+        PageId page;
+        uint64_t used;   // Frame the page was last requested
+        bool pinned;     // Pinned pages are never evicted
+        std::list<uint32_t>::iterator lru;
+    };
+
+    VirtualHeader header_;
+    std::vector<uint32_t> tables_;
+    std::vector<std::vector<uint32_t>> level_offsets_;
+
+    // Physical cache slots, least recently used at the front
+    std::vector<Slot> slots_;
+    std::list<uint32_t> lru_;
+    std::vector<uint32_t> free_;
+    std::unordered_map<PageId, uint32_t> resident_;
+
+    // Pages requested but not resident
+    std::vector<PageId> missing_;
+
+    // Runs of page table entries changed since they were last taken,
+    // as offset and count
+    std::vector<std::pair<uint32_t, uint32_t>> changes_;
+
+    uint64_t frame_;
+    uint64_t version_;
+
+    // Get the number of pages along an axis of a mip level
+    uint32_t get_page_count(uint32_t size, uint32_t level);
+
+    // Get the entry of a page pointing at its own slot
+    uint32_t get_resident_entry(uint32_t slot, uint32_t level);
+
+    // Get the offset of the parent entry of a page's entry
+    uint32_t get_parent_offset(uint32_t texture, uint32_t level, uint32_t x, uint32_t y);
+
+    // Record a run of changed page table entries
+    void mark_changed(uint32_t offset, uint32_t count);
+
+    // Rewrite the page table entries under a page after it was placed 
+    // or evicted
+    // Its own entry is set from its slot or its parent's, then every
+    // non-resident descendant inherits from its parent in turn, so 
+    // only the entries the page covers are visited
+    void update_table(PageId page);
+
+public:
+    VirtualTextures(uint32_t slots);
+
+    // Add a virtual texture and return its index
+    uint32_t add(uint32_t width, uint32_t height, uint32_t levels);
+
+    // Get the number of virtual textures
+    uint32_t get_count();
+
+    // Set the texture handle of the physical page cache
+    void set_cache(uint32_t texture);
+
+    // Get the page of the coarsest level, which covers the whole texture
+    PageId get_root(uint32_t texture);
+
+    // Start a new frame of feedback
+    void begin_frame();
+
+    // Record the pages requested by a feedback buffer
+    void request(const uint32_t *feedback, size_t count);
+
+    // Get the missing pages to stream in, coarsest levels first
+    // At most limit pages are returned, and never more than can be
+    // placed without evicting pages requested this frame
+    std::vector<PageId> get_missing(size_t limit);
+
+    // Place a page in a slot of the cache, evicting the least recently
+    // used page if it is full
+    // Returns the slot, or -1 if every slot is in use this frame
+    int place(PageId page, bool pinned = false);
+
+    // Get the version of the page tables, incremented on every change
+    uint64_t get_version();
+
+    // Get the header of the page table buffer
+    VirtualHeader &get_header();
+
+    // Get the page tables of all virtual textures
+    std::vector<uint32_t> &get_tables();
+
+    // Get the runs of page table entries changed since the last call,
+    // as offset and count, and forget them
+    std::vector<std::pair<uint32_t, uint32_t>> take_changes();
+
+    // Get the number of pages resident in the cache
+    size_t get_resident_count();
+};
+
+#endif
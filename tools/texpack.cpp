@@ -0,0 +1,90 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+
+#include "loader.h"
+#include "pack.h"
+
+// Offline texture packer
+// Decodes images and bakes their full mip chains into a pack file
+// Usage: texpack <output.pak> <image>...
+int main(int argc, char **argv) {
+    if(argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <output.pak> <image>...\n";
+        return 1;
+    }
+    std::string output = argv[1];
+    std::vector<std::string> filenames(argv + 2, argv + argc);
+
+    // Decode every image in parallel
+    ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    TextureLoadStats stats;
+    std::vector<ImageData> images;
+    try {
+        images = decode_images(pool, filenames, stats);
+    }
+    catch(std::exception &err) {
+        std::cerr << err.what() << "\n";
+        return 1;
+    }
+
+    // Bake the mip chains
+    std::vector<std::vector<unsigned char>> chains(images.size());
+    for(size_t i = 0; i < images.size(); i++) {
+        pool.submit([&images, &chains, i]() {
+            ImageData &image = images[i];
+            std::vector<unsigned char> rgba(image.width * image.height * 4);
+            expand_to_rgba(
+                image.pixels.get(), 
+                &rgba[0], 
+                image.width * image.height, 
+                image.channels
+            );
+            chains[i] = generate_mip_chain(&rgba[0], image.width, image.height);
+        });
+    }
+    pool.wait();
+
+    // Build the index
+    PackHeader header;
+    std::memcpy(header.magic, PACK_MAGIC, 4);
+    header.version = PACK_VERSION;
+    header.entry_count = images.size();
+    header.reserved = 0;
+
+    std::vector<PackEntry> entries(images.size());
+    uint64_t offset = sizeof(header) + entries.size() * sizeof(PackEntry);
+    for(size_t i = 0; i < images.size(); i++) {
+        PackEntry &entry = entries[i];
+        if(filenames[i].size() >= sizeof(entry.name)) {
+            std::cerr << "Image path too long: " << filenames[i] << "\n";
+            return 1;
+        }
+        std::memset(entry.name, 0, sizeof(entry.name));
+        std::memcpy(entry.name, filenames[i].c_str(), filenames[i].size());
+        entry.width = images[i].width;
+        entry.height = images[i].height;
+        entry.mip_levels = get_mip_levels(entry.width, entry.height);
+        entry.reserved = 0;
+        entry.offset = offset;
+        entry.size = chains[i].size();
+        offset += entry.size;
+    }
+
+    // Write the pack
+    std::ofstream file(output, std::ios::binary);
+    if(!file.is_open()) {
+        std::cerr << "Could not open " << output << "\n";
+        return 1;
+    }
+    file.write(reinterpret_cast<char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<char *>(entries.data()), entries.size() * sizeof(PackEntry));
+    for(auto &chain : chains) {
+        file.write(reinterpret_cast<char *>(chain.data()), chain.size());
+    }
+
+    std::cout << "Packed " << images.size() << " textures into " 
+              << output << " (" << offset / (1024 * 1024) << " MiB)\n";
+    return 0;
+}